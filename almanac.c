@@ -184,11 +184,11 @@ error:
 }
 
 /**
- * Read almanac from online source.
+ * Read almanac from online source or mirror, any URL curl supports.
  * sem format expected.
- *  
+ * curl_global_init() must have been called.
  */
-CURLcode almanac_download(void) {
+CURLcode almanac_download(const char *url) {
     CURL *curl;
     CURLcode res = CURLE_GOT_NOTHING;
     struct sem_file sem = {
@@ -196,10 +196,9 @@ CURLcode almanac_download(void) {
         NULL
     };
 
-    curl_global_init(CURL_GLOBAL_DEFAULT);
     curl = curl_easy_init();
     if (curl) {
-        curl_easy_setopt(curl, CURLOPT_URL, ALMANAC_DOWNLOAD_SEM_URL);
+        curl_easy_setopt(curl, CURLOPT_URL, url);
         curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, fwrite_sem);
         curl_easy_setopt(curl, CURLOPT_WRITEDATA, &sem);
         curl_easy_setopt(curl, CURLOPT_VERBOSE, 0L);
@@ -210,8 +209,6 @@ CURLcode almanac_download(void) {
     if (sem.stream)
         fclose(sem.stream);
 
-    curl_global_cleanup();
-
     if (res != CURLE_OK) {
         return res;
     }
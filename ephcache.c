@@ -0,0 +1,161 @@
+/**
+ * multi-sdr-gps-sim generates a IQ data stream on-the-fly to simulate a
+ * GPS L1 baseband signal using a SDR platform like HackRF or ADLAM-Pluto.
+ *
+ * This file is part of the Github project at
+ * https://github.com/mictronics/multi-sdr-gps-sim.git
+ *
+ * Copyright © 2021 Mictronics
+ * Distributed under the MIT License.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <zlib.h>
+#include "ephcache.h"
+
+static char *cache_name(const char *src) {
+    size_t len = strlen(src);
+    char *name = malloc(len + sizeof (EPHCACHE_SUFFIX));
+    if (name != NULL) {
+        memcpy(name, src, len);
+        memcpy(name + len, EPHCACHE_SUFFIX, sizeof (EPHCACHE_SUFFIX));
+    }
+    return name;
+}
+
+static bool header_valid(const ephcache_header_t *h, const struct stat *src_st, size_t file_size) {
+    return memcmp(h->magic, EPHCACHE_MAGIC, sizeof (h->magic)) == 0
+            && h->version == EPHCACHE_VERSION
+            && h->record_size == sizeof (ephem_t)
+            && h->iono_size == sizeof (ionoutc_t)
+            && h->src_size == (uint64_t) src_st->st_size
+            && h->src_mtime_sec == (int64_t) src_st->st_mtim.tv_sec
+            && h->src_mtime_nsec == (int64_t) src_st->st_mtim.tv_nsec
+            && file_size == sizeof (*h) + sizeof (ionoutc_t) + (size_t) h->count * sizeof (ephem_t);
+}
+
+int ephcache_load(const char *src, ephstore_t *store, ionoutc_t *ionoutc, char date[21]) {
+    struct stat src_st, st;
+    int count = -1;
+
+    char *name = cache_name(src);
+    if (name == NULL || stat(src, &src_st) != 0) {
+        free(name);
+        return -1;
+    }
+    int fd = open(name, O_RDONLY);
+    free(name);
+    if (fd < 0) {
+        return -1;
+    }
+    if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof (ephcache_header_t)) {
+        close(fd);
+        return -1;
+    }
+
+    size_t size = (size_t) st.st_size;
+    const unsigned char *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return -1;
+    }
+
+    const ephcache_header_t *h = (const ephcache_header_t *) map;
+    const unsigned char *payload = map + sizeof (*h);
+    size_t payload_size = size - sizeof (*h);
+    if (header_valid(h, &src_st, size)
+            && (uint32_t) crc32(crc32(0L, Z_NULL, 0), payload, (uInt) payload_size) == h->crc) {
+        memcpy(ionoutc, payload, sizeof (ionoutc_t));
+        memcpy(date, h->date, 20);
+        date[20] = '\0';
+
+        const unsigned char *rec = payload + sizeof (ionoutc_t);
+        for (uint32_t i = 0; i < h->count; i++, rec += sizeof (ephem_t)) {
+            ephem_t eph;
+            memcpy(&eph, rec, sizeof (eph));
+            if (!ephstore_add(store, &eph)) {
+                break;
+            }
+        }
+        count = (int) ephstore_count(store);
+    }
+
+    munmap((void *) map, size);
+    return count;
+}
+
+bool ephcache_save(const char *src, const ephstore_t *store, const ionoutc_t *ionoutc, const char *date) {
+    ephcache_header_t h;
+    struct stat src_st;
+
+    if (stat(src, &src_st) != 0) {
+        return false;
+    }
+
+    memset(&h, 0, sizeof (h));
+    memcpy(h.magic, EPHCACHE_MAGIC, sizeof (h.magic));
+    h.version = EPHCACHE_VERSION;
+    h.record_size = sizeof (ephem_t);
+    h.iono_size = sizeof (ionoutc_t);
+    h.count = (uint32_t) ephstore_count(store);
+    h.src_size = (uint64_t) src_st.st_size;
+    h.src_mtime_sec = (int64_t) src_st.st_mtim.tv_sec;
+    h.src_mtime_nsec = (int64_t) src_st.st_mtim.tv_nsec;
+    strncpy(h.date, date, sizeof (h.date) - 1);
+
+    h.crc = (uint32_t) crc32(crc32(0L, Z_NULL, 0), (const Bytef *) ionoutc, sizeof (ionoutc_t));
+    for (int sv = 0; sv < MAX_SAT; sv++) {
+        const ephstore_sv_t *s = &store->sv[sv];
+        if (s->count > 0) {
+            h.crc = (uint32_t) crc32(h.crc, (const Bytef *) s->eph, (uInt) (s->count * sizeof (ephem_t)));
+        }
+    }
+
+    // Write to a temporary file and rename, readers never see a partial cache
+    char *name = cache_name(src);
+    if (name == NULL) {
+        return false;
+    }
+    size_t len = strlen(name);
+    char *tmp_name = malloc(len + 8);
+    if (tmp_name == NULL) {
+        free(name);
+        return false;
+    }
+    memcpy(tmp_name, name, len);
+    memcpy(tmp_name + len, ".XXXXXX", 8);
+
+    bool ok = false;
+    int fd = mkstemp(tmp_name);
+    if (fd >= 0) {
+        FILE *fp = fdopen(fd, "wb");
+        if (fp != NULL) {
+            ok = fwrite(&h, sizeof (h), 1, fp) == 1
+                    && fwrite(ionoutc, sizeof (ionoutc_t), 1, fp) == 1;
+            for (int sv = 0; ok && sv < MAX_SAT; sv++) {
+                const ephstore_sv_t *s = &store->sv[sv];
+                ok = fwrite(s->eph, sizeof (ephem_t), s->count, fp) == s->count;
+            }
+            ok = (fclose(fp) == 0) && ok;
+        } else {
+            close(fd);
+        }
+        if (ok) {
+            ok = (chmod(tmp_name, 0644) == 0) && (rename(tmp_name, name) == 0);
+        }
+        if (!ok) {
+            unlink(tmp_name);
+        }
+    }
+
+    free(tmp_name);
+    free(name);
+    return ok;
+}
@@ -0,0 +1,56 @@
+/**
+ * multi-sdr-gps-sim generates a IQ data stream on-the-fly to simulate a
+ * GPS L1 baseband signal using a SDR platform like HackRF or ADLAM-Pluto.
+ *
+ * This file is part of the Github project at
+ * https://github.com/mictronics/multi-sdr-gps-sim.git
+ *
+ * Copyright © 2021 Mictronics
+ * Distributed under the MIT License.
+ *
+ */
+
+#ifndef EPHCACHE_H
+#define EPHCACHE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "gps.h"
+#include "ephstore.h"
+
+/*
+ * Ephemeris cache file layout, native byte order:
+ *
+ *   header   ephcache_header_t
+ *   iono     ionoutc_t
+ *   records  ephem_t[count], sorted by satellite and TOE
+ *
+ * The cache is stored next to the RINEX file with EPHCACHE_SUFFIX appended
+ * and is valid as long as size and modification time of the RINEX file
+ * match the ones recorded in the header.
+ */
+#define EPHCACHE_MAGIC "GPSSIMEP"
+#define EPHCACHE_VERSION (2)
+#define EPHCACHE_SUFFIX ".ephc"
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size; /* sizeof(ephem_t), guards against layout changes */
+    uint32_t iono_size; /* sizeof(ionoutc_t) */
+    uint32_t count; /* Number of records */
+    uint64_t src_size; /* Size of the RINEX file */
+    int64_t src_mtime_sec; /* Modification time of the RINEX file */
+    int64_t src_mtime_nsec;
+    uint32_t crc; /* CRC-32 of iono and records */
+    uint32_t reserved;
+    char date[24]; /* RINEX file date */
+} ephcache_header_t;
+
+/* Load the cache of RINEX file src into store. Returns the number of
+ * ephemerides or -1 if there is no valid cache. */
+int ephcache_load(const char *src, ephstore_t *store, ionoutc_t *ionoutc, char date[21]);
+/* Write the cache of RINEX file src. */
+bool ephcache_save(const char *src, const ephstore_t *store, const ionoutc_t *ionoutc, const char *date);
+
+#endif /* EPHCACHE_H */
@@ -0,0 +1,142 @@
+/**
+ * multi-sdr-gps-sim generates a IQ data stream on-the-fly to simulate a
+ * GPS L1 baseband signal using a SDR platform like HackRF or ADLAM-Pluto.
+ *
+ * This file is part of the Github project at
+ * https://github.com/mictronics/multi-sdr-gps-sim.git
+ *
+ * Copyright © 2021 Mictronics
+ * Distributed under the MIT License.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "ephstore.h"
+
+static double gps_diff(gpstime_t g1, gpstime_t g0) {
+    return (g1.sec - g0.sec) + (double) (g1.week - g0.week) * SECONDS_IN_WEEK;
+}
+
+// Index of the first ephemeris with a TOE later than g
+static size_t upper_bound(const ephstore_sv_t *s, gpstime_t g) {
+    size_t lo = 0, hi = s->count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (gps_diff(s->eph[mid].toe, g) > 0.0) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    return lo;
+}
+
+void ephstore_init(ephstore_t *store) {
+    memset(store, 0, sizeof (*store));
+}
+
+void ephstore_free(ephstore_t *store) {
+    for (int sv = 0; sv < MAX_SAT; sv++) {
+        free(store->sv[sv].eph);
+    }
+    ephstore_init(store);
+}
+
+bool ephstore_add(ephstore_t *store, const ephem_t *eph) {
+    if (eph->prn < 1 || eph->prn > MAX_SAT) {
+        return true; // Not a GPS satellite we simulate
+    }
+    ephstore_sv_t *s = &store->sv[eph->prn - 1];
+
+    // Navigation files are in time order, mostly this appends
+    size_t i = upper_bound(s, eph->toe);
+    if (i > 0 && gps_diff(s->eph[i - 1].toe, eph->toe) == 0.0) {
+        // Same IODE is a duplicate, otherwise the newest upload wins and
+        // the higher IODE breaks a tie, whatever order the files came in
+        ephem_t *old = &s->eph[i - 1];
+        double newer = gps_diff(eph->tot, old->tot);
+        if (old->iode != eph->iode && (newer > 0.0 || (newer == 0.0 && eph->iode > old->iode))) {
+            *old = *eph;
+        }
+        return true;
+    }
+    if (s->count == s->capacity) {
+        size_t cap = (s->capacity > 0) ? s->capacity * 2 : 16;
+        ephem_t *tmp = realloc(s->eph, cap * sizeof (ephem_t));
+        if (tmp == NULL) {
+            return false;
+        }
+        s->eph = tmp;
+        s->capacity = cap;
+    }
+    memmove(&s->eph[i + 1], &s->eph[i], (s->count - i) * sizeof (ephem_t));
+    s->eph[i] = *eph;
+    s->count++;
+    return true;
+}
+
+const ephem_t *ephstore_find(const ephstore_t *store, int prn, gpstime_t g) {
+    if (prn < 1 || prn > MAX_SAT) {
+        return NULL;
+    }
+    const ephstore_sv_t *s = &store->sv[prn - 1];
+    if (s->count == 0) {
+        return NULL;
+    }
+
+    size_t i = upper_bound(s, g);
+    const ephem_t *eph;
+    if (i == 0) {
+        eph = &s->eph[0];
+    } else if (i == s->count) {
+        eph = &s->eph[i - 1];
+    } else {
+        // Nearest TOE, the later one at the midpoint
+        eph = (gps_diff(s->eph[i].toe, g) <= gps_diff(g, s->eph[i - 1].toe)) ? &s->eph[i] : &s->eph[i - 1];
+    }
+
+    double fit = (eph->fit > 0.0) ? eph->fit : EPHSTORE_DEFAULT_FIT;
+    double dt = gps_diff(g, eph->toe);
+    if (dt < -fit * SECONDS_IN_HOUR / 2.0 || dt > fit * SECONDS_IN_HOUR / 2.0) {
+        return NULL;
+    }
+    return eph;
+}
+
+const ephem_t *ephstore_find_toe(const ephstore_t *store, int prn, gpstime_t toe) {
+    if (prn < 1 || prn > MAX_SAT) {
+        return NULL;
+    }
+    const ephstore_sv_t *s = &store->sv[prn - 1];
+    size_t i = upper_bound(s, toe);
+    if (i > 0 && gps_diff(s->eph[i - 1].toe, toe) == 0.0) {
+        return &s->eph[i - 1];
+    }
+    return NULL;
+}
+
+size_t ephstore_count(const ephstore_t *store) {
+    size_t n = 0;
+    for (int sv = 0; sv < MAX_SAT; sv++) {
+        n += store->sv[sv].count;
+    }
+    return n;
+}
+
+bool ephstore_span(const ephstore_t *store, const ephem_t **first, const ephem_t **last) {
+    *first = *last = NULL;
+    for (int sv = 0; sv < MAX_SAT; sv++) {
+        const ephstore_sv_t *s = &store->sv[sv];
+        if (s->count == 0) {
+            continue;
+        }
+        if (*first == NULL || gps_diff(s->eph[0].toe, (*first)->toe) < 0.0) {
+            *first = &s->eph[0];
+        }
+        if (*last == NULL || gps_diff(s->eph[s->count - 1].toe, (*last)->toe) > 0.0) {
+            *last = &s->eph[s->count - 1];
+        }
+    }
+    return *first != NULL;
+}
@@ -0,0 +1,58 @@
+/**
+ * multi-sdr-gps-sim generates a IQ data stream on-the-fly to simulate a
+ * GPS L1 baseband signal using a SDR platform like HackRF or ADLAM-Pluto.
+ *
+ * This file is part of the Github project at
+ * https://github.com/mictronics/multi-sdr-gps-sim.git
+ *
+ * Copyright © 2021 Mictronics
+ * Distributed under the MIT License.
+ *
+ */
+
+#ifndef EPHSTORE_H
+#define EPHSTORE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "gps.h"
+
+/* Fit interval assumed when the navigation data gives none, in hours */
+#define EPHSTORE_DEFAULT_FIT 4.0
+
+/* Ephemerides of one satellite, sorted by TOE */
+typedef struct {
+    ephem_t *eph;
+    size_t count;
+    size_t capacity;
+} ephstore_sv_t;
+
+/* Time indexed ephemerides of all satellites */
+typedef struct {
+    ephstore_sv_t sv[MAX_SAT];
+} ephstore_t;
+
+void ephstore_init(ephstore_t *store);
+void ephstore_free(ephstore_t *store);
+
+/* Insert an ephemeris at its TOE. Of two with the same TOE for the
+ * satellite the one with the later transmission time is kept, the higher
+ * IODE on equal times. Same IODE counts as duplicate. Returns false if out
+ * of memory. */
+bool ephstore_add(ephstore_t *store, const ephem_t *eph);
+
+/* Ephemeris of satellite prn with the TOE nearest to g, the later one on a
+ * tie. NULL if there is none or g is outside its fit interval. */
+const ephem_t *ephstore_find(const ephstore_t *store, int prn, gpstime_t g);
+
+/* Ephemeris of satellite prn with exactly the given TOE, NULL if none. */
+const ephem_t *ephstore_find_toe(const ephstore_t *store, int prn, gpstime_t toe);
+
+/* Total number of ephemerides. */
+size_t ephstore_count(const ephstore_t *store);
+
+/* Ephemerides with the earliest and latest TOE over all satellites.
+ * Returns false if the store is empty. */
+bool ephstore_span(const ephstore_t *store, const ephem_t **first, const ephem_t **last);
+
+#endif /* EPHSTORE_H */
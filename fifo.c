@@ -16,79 +16,404 @@
 #include <string.h>
 #include <pthread.h>
 #include <assert.h>
+#include <math.h>
+#include <time.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <sys/mman.h>
 #include "fifo.h"
 
 static pthread_mutex_t fifo_mutex = PTHREAD_MUTEX_INITIALIZER; // mutex protecting the queues
-static pthread_cond_t fifo_notempty_cond = PTHREAD_COND_INITIALIZER; // condition used to signal FIFO-not-empty
 static pthread_cond_t fifo_empty_cond = PTHREAD_COND_INITIALIZER; // condition used to signal FIFO-empty
 static pthread_cond_t fifo_free_cond = PTHREAD_COND_INITIALIZER; // condition used to signal freelist-not-empty
 static pthread_cond_t fifo_full_cond = PTHREAD_COND_INITIALIZER; // condition used to signal FIFO-full
-static struct iq_buf *fifo_head; // head of queued buffers awaiting demodulation
-static struct iq_buf *fifo_tail; // tail of queued buffers awaiting demodulation
+
+// Queue of one consumer. Consumer 0 is the primary sink, further consumers
+// are taps receiving every enqueued buffer as well.
+struct fifo_queue {
+    struct iq_buf *ring[FIFO_MAX_DEPTH]; // queued buffers awaiting transmission
+    unsigned head; // ring index of the oldest queued buffer
+    unsigned count; // number of queued buffers
+    pthread_cond_t notempty_cond; // condition used to signal queue-not-empty
+};
+
+static struct fifo_queue fifo_queues[FIFO_MAX_CONSUMERS]; // per consumer queues
+static unsigned fifo_consumers = 1; // number of registered consumers
 static struct iq_buf *fifo_freelist; // freelist of preallocated buffers
 static bool fifo_halted; // true if queue has been halted
+static unsigned fifo_count; // number of preallocated buffers, upper bound of the depth
+static unsigned fifo_depth; // current limit of in-flight buffers
+static unsigned fifo_inflight; // buffers acquired, queued or being consumed
+
+static unsigned target_slack_ms; // target slack for adaptive depth, 0 keeps depth fixed
+static double interval_avg; // smoothed consumer dequeue interval [ns]
+static double interval_dev; // smoothed mean deviation of the dequeue interval (jitter) [ns]
+static double lead_avg; // smoothed producer lead time, enqueue to dequeue [ns]
+static uint64_t last_dequeue_ns; // time of previous dequeue
+static unsigned adapt_countdown; // dequeues left until the next depth adjustment
+static bool underrun_predicted; // slack dropped below the jitter margin
+static unsigned long underrun_predictions; // number of predicted underruns
+
+// Telemetry, written under the mutex or by the backends, read lock-free by
+// pollers. Relaxed ordering is sufficient, counters are independent.
+static atomic_ulong stat_enqueued; // buffers enqueued
+static atomic_ulong stat_dequeued; // buffers dequeued
+static atomic_ulong stat_underruns; // consumer found the FIFO empty
+static atomic_ulong stat_overruns; // producer found the FIFO full
+static atomic_uint stat_occupancy; // buffers currently queued
+static atomic_uint stat_min_occupancy; // lowest occupancy seen at dequeue
+static atomic_uint stat_max_occupancy; // highest occupancy seen at enqueue
+static atomic_uint stat_depth; // current in-flight limit
+static atomic_uint stat_slack_ms; // slack estimated at the last dequeue
+static atomic_uint stat_lead_ms; // smoothed producer lead time at the last dequeue
+static atomic_ulong stat_producer_wait[FIFO_WAIT_BINS]; // producer wait time histogram
+static atomic_ulong stat_consumer_wait[FIFO_WAIT_BINS]; // consumer wait time histogram
+static uint64_t stat_start_ns; // time of FIFO creation
+
+static void *pool_base; // one contiguous region holding buffer headers and IQ data
+static size_t pool_size; // mapped size of the pool region
+static bool pool_locked; // true if the pool is locked in RAM
+static unsigned pool_sample_size; // bytes per sample element
+static fifo_acquire_hook_t acquire_hook; // sink supplying buffer memory, NULL uses the pool
+static fifo_enqueue_hook_t enqueue_hook; // primary sink taking buffers at enqueue, NULL queues them
+static unsigned block_align = 1; // granularity in samples the sink accepts for partly filled buffers
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
 
-// Create the queue structures. Not threadsafe.
+// Log2 histogram bin of a wait time, bin 0 is below 1us.
+static unsigned wait_bin(uint64_t wait_ns) {
+    uint64_t us = wait_ns / 1000;
+    unsigned bin = 0;
+    while (us > 0 && bin < FIFO_WAIT_BINS - 1) {
+        us >>= 1;
+        bin++;
+    }
+    return bin;
+}
+
+static void stats_reset(void) {
+    atomic_store_explicit(&stat_enqueued, 0, memory_order_relaxed);
+    atomic_store_explicit(&stat_dequeued, 0, memory_order_relaxed);
+    atomic_store_explicit(&stat_underruns, 0, memory_order_relaxed);
+    atomic_store_explicit(&stat_overruns, 0, memory_order_relaxed);
+    atomic_store_explicit(&stat_occupancy, 0, memory_order_relaxed);
+    atomic_store_explicit(&stat_min_occupancy, UINT32_MAX, memory_order_relaxed);
+    atomic_store_explicit(&stat_max_occupancy, 0, memory_order_relaxed);
+    atomic_store_explicit(&stat_depth, fifo_depth, memory_order_relaxed);
+    atomic_store_explicit(&stat_slack_ms, 0, memory_order_relaxed);
+    atomic_store_explicit(&stat_lead_ms, 0, memory_order_relaxed);
+    for (unsigned i = 0; i < FIFO_WAIT_BINS; i++) {
+        atomic_store_explicit(&stat_producer_wait[i], 0, memory_order_relaxed);
+        atomic_store_explicit(&stat_consumer_wait[i], 0, memory_order_relaxed);
+    }
+    stat_start_ns = now_ns();
+}
+
+static size_t round_up(size_t size, size_t align) {
+    return (size + align - 1) / align * align;
+}
+
+// Map the buffer pool. Try explicit 2 MB hugepages first to keep the TLB
+// footprint small, fall back to regular pages with a transparent hugepage hint.
+static void *pool_map(size_t size, size_t *mapped) {
+    void *p;
+#ifdef MAP_HUGETLB
+    *mapped = round_up(size, FIFO_HUGEPAGE_SIZE);
+    p = mmap(NULL, *mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (p != MAP_FAILED) {
+        return p;
+    }
+#endif
+    *mapped = round_up(size, (size_t) sysconf(_SC_PAGESIZE));
+    p = mmap(NULL, *mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+        return NULL;
+    }
+#ifdef MADV_HUGEPAGE
+    madvise(p, *mapped, MADV_HUGEPAGE);
+#endif
+    return p;
+}
+
+void fifo_set_target_slack(unsigned slack_ms) {
+    target_slack_ms = slack_ms;
+}
 
+void *fifo_buffer_data(const struct iq_buf *buf) {
+    return (buf->data16 != NULL) ? (void *) buf->data16 : (void *) buf->data8;
+}
+
+static void set_buffer_data(struct iq_buf *buf, void *data) {
+    if (pool_sample_size == sizeof (signed short)) {
+        buf->data16 = (signed short *) data;
+        buf->data8 = NULL;
+    } else {
+        buf->data8 = (signed char *) data;
+        buf->data16 = NULL;
+    }
+}
+
+// Create the queue structures. Not threadsafe.
 bool fifo_create(unsigned buffer_count, unsigned buffer_size, unsigned sample_size) {
+    // Initial depth is the given buffer count, with adaptive depth we may grow
+    // up to FIFO_MAX_DEPTH later on.
+    fifo_depth = buffer_count;
+    if (buffer_count > FIFO_MAX_DEPTH) {
+        return false;
+    }
+    if (target_slack_ms > 0) {
+        buffer_count = FIFO_MAX_DEPTH;
+    }
+    fifo_count = buffer_count;
+    fifo_inflight = 0;
+    fifo_consumers = 1;
+    // Set up again after fifo_destroy()
+    fifo_halted = false;
+    pthread_mutex_init(&fifo_mutex, NULL);
+    pthread_cond_init(&fifo_empty_cond, NULL);
+    pthread_cond_init(&fifo_free_cond, NULL);
+    pthread_cond_init(&fifo_full_cond, NULL);
+    for (unsigned i = 0; i < FIFO_MAX_CONSUMERS; i++) {
+        fifo_queues[i].head = 0;
+        fifo_queues[i].count = 0;
+        pthread_cond_init(&fifo_queues[i].notempty_cond, NULL);
+    }
+    interval_avg = interval_dev = lead_avg = 0.0;
+    last_dequeue_ns = 0;
+    adapt_countdown = FIFO_ADAPT_INTERVAL;
+    underrun_predicted = false;
+    underrun_predictions = 0;
+    stats_reset();
+
+    pool_sample_size = sample_size;
+    block_align = 1;
+    size_t page_size = (size_t) sysconf(_SC_PAGESIZE);
+    size_t header_size = round_up(buffer_count * sizeof (struct iq_buf), FIFO_BUFFER_ALIGN);
+    size_t data_size = round_up((size_t) buffer_size * sample_size, FIFO_BUFFER_ALIGN);
+
+    pool_base = pool_map(header_size + buffer_count * data_size, &pool_size);
+    if (pool_base == NULL) {
+        return false;
+    }
+
+    // Pre-fault all pages now, the first real-time seconds must not take page faults.
+    for (size_t i = 0; i < pool_size; i += page_size) {
+        ((volatile char *) pool_base)[i] = 0;
+    }
+    // Not fatal, locking may fail due to RLIMIT_MEMLOCK.
+    pool_locked = (mlock(pool_base, pool_size) == 0);
+
+    struct iq_buf *headers = (struct iq_buf *) pool_base;
+    char *data = (char *) pool_base + header_size;
+
     for (unsigned i = 0; i < buffer_count; ++i) {
-        struct iq_buf *newbuf;
-        if (!(newbuf = calloc(1, sizeof (*newbuf)))) {
-            goto nomem;
-        }
+        struct iq_buf *newbuf = &headers[i];
 
-        if (sample_size == sizeof (signed short)) {
-            if (!(newbuf->data16 = calloc(buffer_size, sizeof (newbuf->data16[0])))) {
-                free(newbuf);
-                goto nomem;
-            }
-            newbuf->data8 = NULL;
-        } else {
-            if (!(newbuf->data8 = calloc(buffer_size, sizeof (newbuf->data8[0])))) {
-                free(newbuf);
-                goto nomem;
-            }
-            newbuf->data16 = NULL;
-        }
+        newbuf->pool_data = data + i * data_size;
+        set_buffer_data(newbuf, newbuf->pool_data);
 
         newbuf->totalLength = buffer_size;
         newbuf->validLength = 0;
+        newbuf->refcount = 0;
         newbuf->next = fifo_freelist;
         fifo_freelist = newbuf;
     }
 
     return true;
+}
+
+int fifo_add_consumer(void) {
+    pthread_mutex_lock(&fifo_mutex);
+    int consumer = -1;
+    if (fifo_consumers < FIFO_MAX_CONSUMERS) {
+        consumer = (int) fifo_consumers++;
+    }
+    pthread_mutex_unlock(&fifo_mutex);
+    return consumer;
+}
+
+void fifo_set_acquire_hook(fifo_acquire_hook_t hook) {
+    pthread_mutex_lock(&fifo_mutex);
+    acquire_hook = hook;
+    pthread_mutex_unlock(&fifo_mutex);
+}
 
-nomem:
-    fifo_destroy();
-    return false;
+void fifo_set_enqueue_hook(fifo_enqueue_hook_t hook) {
+    pthread_mutex_lock(&fifo_mutex);
+    enqueue_hook = hook;
+    pthread_mutex_unlock(&fifo_mutex);
+}
+
+void fifo_set_block_align(unsigned align) {
+    block_align = (align > 0) ? align : 1;
+}
+
+unsigned fifo_block_align(void) {
+    return block_align;
+}
+
+bool fifo_is_locked(void) {
+    return pool_locked;
 }
 
-static void free_buffer_list(struct iq_buf *head) {
-    while (head) {
-        struct iq_buf *next = head->next;
-        free(head->data8);
-        free(head->data16);
-        free(head);
-        head = next;
+unsigned fifo_get_depth(void) {
+    return atomic_load_explicit(&stat_depth, memory_order_relaxed);
+}
+
+unsigned fifo_get_slack_ms(void) {
+    return atomic_load_explicit(&stat_slack_ms, memory_order_relaxed);
+}
+
+bool fifo_underrun_predicted(unsigned long *count) {
+    pthread_mutex_lock(&fifo_mutex);
+    bool predicted = underrun_predicted;
+    if (count != NULL) {
+        *count = underrun_predictions;
+    }
+    pthread_mutex_unlock(&fifo_mutex);
+    return predicted;
+}
+
+void fifo_report_underrun(void) {
+    atomic_fetch_add_explicit(&stat_underruns, 1, memory_order_relaxed);
+}
+
+void fifo_get_stats(struct fifo_stats *stats) {
+    stats->enqueued = atomic_load_explicit(&stat_enqueued, memory_order_relaxed);
+    stats->dequeued = atomic_load_explicit(&stat_dequeued, memory_order_relaxed);
+    stats->underruns = atomic_load_explicit(&stat_underruns, memory_order_relaxed);
+    stats->overruns = atomic_load_explicit(&stat_overruns, memory_order_relaxed);
+    stats->occupancy = atomic_load_explicit(&stat_occupancy, memory_order_relaxed);
+    stats->min_occupancy = atomic_load_explicit(&stat_min_occupancy, memory_order_relaxed);
+    stats->max_occupancy = atomic_load_explicit(&stat_max_occupancy, memory_order_relaxed);
+    if (stats->min_occupancy > stats->max_occupancy) {
+        stats->min_occupancy = 0; // Nothing dequeued yet
+    }
+    for (unsigned i = 0; i < FIFO_WAIT_BINS; i++) {
+        stats->producer_wait[i] = atomic_load_explicit(&stat_producer_wait[i], memory_order_relaxed);
+        stats->consumer_wait[i] = atomic_load_explicit(&stat_consumer_wait[i], memory_order_relaxed);
+    }
+    stats->uptime = (stat_start_ns > 0) ? (double) (now_ns() - stat_start_ns) / 1e9 : 0.0;
+    stats->enqueue_rate = (stats->uptime > 0.0) ? stats->enqueued / stats->uptime : 0.0;
+    stats->dequeue_rate = (stats->uptime > 0.0) ? stats->dequeued / stats->uptime : 0.0;
+    stats->depth = fifo_get_depth();
+    stats->slack_ms = fifo_get_slack_ms();
+    stats->lead_ms = atomic_load_explicit(&stat_lead_ms, memory_order_relaxed);
+}
+
+unsigned fifo_wait_max_us(const unsigned long hist[FIFO_WAIT_BINS]) {
+    for (int i = FIFO_WAIT_BINS - 1; i > 0; i--) {
+        if (hist[i] > 0) {
+            return 1u << i;
+        }
+    }
+    return hist[0] > 0 ? 1 : 0;
+}
+
+// Track consumer interval, its jitter and the producer lead time, then
+// adapt the in-flight buffer limit towards the target slack. Called with the
+// mutex held after a buffer was taken off the FIFO.
+static void fifo_adapt(struct iq_buf *buf) {
+    uint64_t now = now_ns();
+
+    if (last_dequeue_ns != 0) {
+        double interval = (double) (now - last_dequeue_ns);
+        if (interval_avg == 0.0) {
+            interval_avg = interval;
+            interval_dev = interval / 2;
+        } else {
+            double err = interval - interval_avg;
+            interval_avg += err / 8;
+            interval_dev += (fabs(err) - interval_dev) / 4;
+        }
+    }
+    last_dequeue_ns = now;
+    lead_avg += ((double) (now - buf->enqueueTime) - lead_avg) / 8;
+    atomic_store_explicit(&stat_lead_ms, (unsigned) (lead_avg / 1e6), memory_order_relaxed);
+
+    if (interval_avg == 0.0) {
+        return;
+    }
+
+    // Remaining slack must cover one more interval plus the consumer jitter.
+    double slack = fifo_queues[0].count * interval_avg;
+    atomic_store_explicit(&stat_slack_ms, (unsigned) (slack / 1e6), memory_order_relaxed);
+    bool predicted = slack < interval_avg + 4 * interval_dev;
+    if (predicted && !underrun_predicted) {
+        underrun_predictions++;
+    }
+    underrun_predicted = predicted;
+
+    if (target_slack_ms == 0 || --adapt_countdown > 0) {
+        return;
+    }
+    adapt_countdown = FIFO_ADAPT_INTERVAL;
+
+    // Buffers needed to hold the target slack plus jitter margin, one more
+    // being filled by the producer and one held by the consumer.
+    double want = (target_slack_ms * 1e6 + 4 * interval_dev) / interval_avg;
+    unsigned depth = (unsigned) ceil(want) + 2;
+    if (depth < FIFO_MIN_DEPTH) depth = FIFO_MIN_DEPTH;
+    if (depth > fifo_count) depth = fifo_count;
+
+    // Step by one buffer per adjustment, with a one buffer hysteresis band
+    // on shrinking to avoid oscillation.
+    if (depth > fifo_depth) {
+        fifo_depth++;
+        pthread_cond_signal(&fifo_free_cond);
+    } else if (depth + 1 < fifo_depth) {
+        fifo_depth--;
+    }
+    atomic_store_explicit(&stat_depth, fifo_depth, memory_order_relaxed);
+}
+
+// Drop one reference, the last one returns the buffer to the freelist.
+// Called with the mutex held.
+static void buffer_unref(struct iq_buf *buf) {
+    if (--buf->refcount == 0) {
+        buf->next = fifo_freelist;
+        fifo_freelist = buf;
+        fifo_inflight--;
+        pthread_cond_signal(&fifo_free_cond);
     }
 }
 
 void fifo_destroy() {
-    free_buffer_list(fifo_head);
-    free_buffer_list(fifo_freelist);
     fifo_freelist = NULL;
-    fifo_head = fifo_tail = NULL;
-    pthread_cond_destroy(&fifo_notempty_cond);
+    if (pool_base != NULL) {
+        if (pool_locked) {
+            munlock(pool_base, pool_size);
+        }
+        munmap(pool_base, pool_size);
+        pool_base = NULL;
+        pool_locked = false;
+    }
+    for (unsigned i = 0; i < FIFO_MAX_CONSUMERS; i++) {
+        pthread_cond_destroy(&fifo_queues[i].notempty_cond);
+    }
     pthread_cond_destroy(&fifo_full_cond);
     pthread_cond_destroy(&fifo_free_cond);
     pthread_cond_destroy(&fifo_empty_cond);
     pthread_mutex_destroy(&fifo_mutex);
 }
 
+// True if no consumer has buffers pending. Called with the mutex held.
+static bool queues_empty(void) {
+    for (unsigned i = 0; i < fifo_consumers; i++) {
+        if (fifo_queues[i].count > 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
 void fifo_wait_next() {
     pthread_mutex_lock(&fifo_mutex);
-    while (fifo_head && !fifo_halted) {
+    while (!queues_empty() && !fifo_halted) {
         pthread_cond_wait(&fifo_empty_cond, &fifo_mutex);
     }
     pthread_mutex_unlock(&fifo_mutex);
@@ -96,7 +421,7 @@ void fifo_wait_next() {
 
 void fifo_wait_full() {
     pthread_mutex_lock(&fifo_mutex);
-    if (!fifo_halted) {
+    while (!fifo_halted && fifo_inflight < fifo_depth) {
         pthread_cond_wait(&fifo_full_cond, &fifo_mutex);
     }
     pthread_mutex_unlock(&fifo_mutex);
@@ -106,19 +431,20 @@ void fifo_halt() {
     pthread_mutex_lock(&fifo_mutex);
 
     // Drain all enqueued buffers to the freelist
-    while (fifo_head) {
-        struct iq_buf *freebuf = fifo_head;
-        fifo_head = freebuf->next;
-
-        freebuf->next = fifo_freelist;
-        fifo_freelist = freebuf;
+    for (unsigned i = 0; i < fifo_consumers; i++) {
+        struct fifo_queue *q = &fifo_queues[i];
+        while (q->count > 0) {
+            buffer_unref(q->ring[q->head]);
+            q->head = (q->head + 1) % FIFO_MAX_DEPTH;
+            q->count--;
+        }
+        pthread_cond_broadcast(&q->notempty_cond);
     }
 
-    fifo_tail = NULL;
+    atomic_store_explicit(&stat_occupancy, 0, memory_order_relaxed);
     fifo_halted = true;
 
     // wake all waiters
-    pthread_cond_broadcast(&fifo_notempty_cond);
     pthread_cond_broadcast(&fifo_empty_cond);
     pthread_cond_broadcast(&fifo_free_cond);
     pthread_cond_broadcast(&fifo_full_cond);
@@ -129,21 +455,35 @@ struct iq_buf *fifo_acquire(void) {
     pthread_mutex_lock(&fifo_mutex);
 
     struct iq_buf *result = NULL;
-    if (!fifo_halted && !fifo_freelist) {
-        pthread_cond_signal(&fifo_full_cond);
-        // No free buffers, wait for one
+    uint64_t wait_start = 0;
+    while (!fifo_halted && (!fifo_freelist || fifo_inflight >= fifo_depth)) {
+        if (wait_start == 0) {
+            wait_start = now_ns();
+            atomic_fetch_add_explicit(&stat_overruns, 1, memory_order_relaxed);
+        }
+        pthread_cond_broadcast(&fifo_full_cond);
+        // No free buffers or depth limit reached, wait for one
         pthread_cond_wait(&fifo_free_cond, &fifo_mutex);
     }
+    atomic_fetch_add_explicit(&stat_producer_wait[wait_start ? wait_bin(now_ns() - wait_start) : 0], 1, memory_order_relaxed);
 
     if (!fifo_halted) {
         result = fifo_freelist;
         fifo_freelist = result->next;
+        fifo_inflight++;
 
         result->validLength = 0;
+        result->refcount = 1;
         result->next = NULL;
     }
+    fifo_acquire_hook_t hook = acquire_hook;
 
     pthread_mutex_unlock(&fifo_mutex);
+
+    if (result != NULL && (hook != NULL || fifo_buffer_data(result) != result->pool_data)) {
+        void *data = (hook != NULL) ? hook((size_t) result->totalLength * pool_sample_size) : NULL;
+        set_buffer_data(result, (data != NULL) ? data : result->pool_data);
+    }
     return result;
 }
 
@@ -154,17 +494,31 @@ void fifo_enqueue(struct iq_buf *buf) {
 
     if (fifo_halted) {
         // Shutting down, just return the buffer to the freelist.
-        buf->next = fifo_freelist;
-        fifo_freelist = buf;
+        buffer_unref(buf);
         goto done;
     }
-    // enqueue and tell the main thread
-    buf->next = NULL;
-    if (!fifo_head) {
-        fifo_head = fifo_tail = buf;
-        pthread_cond_signal(&fifo_notempty_cond);
-    } else {
-        fifo_tail->next = buf;
+    // hand the buffer to every consumer and tell them, a primary sink with
+    // enqueue hook has taken it already
+    buf->enqueueTime = now_ns();
+    buf->refcount = fifo_consumers;
+    unsigned first = 0;
+    if (enqueue_hook != NULL) {
+        enqueue_hook(buf);
+        buffer_unref(buf);
+        first = 1;
+    }
+    for (unsigned i = first; i < fifo_consumers; i++) {
+        struct fifo_queue *q = &fifo_queues[i];
+        q->ring[(q->head + q->count) % FIFO_MAX_DEPTH] = buf;
+        q->count++;
+        pthread_cond_signal(&q->notempty_cond);
+    }
+
+    unsigned queued = fifo_queues[0].count;
+    atomic_fetch_add_explicit(&stat_enqueued, 1, memory_order_relaxed);
+    atomic_store_explicit(&stat_occupancy, queued, memory_order_relaxed);
+    if (queued > atomic_load_explicit(&stat_max_occupancy, memory_order_relaxed)) {
+        atomic_store_explicit(&stat_max_occupancy, queued, memory_order_relaxed);
     }
 
 done:
@@ -172,22 +526,47 @@ done:
 }
 
 struct iq_buf *fifo_dequeue(void) {
+    return fifo_dequeue_consumer(0);
+}
+
+struct iq_buf *fifo_dequeue_consumer(int consumer) {
+    struct fifo_queue *q = &fifo_queues[consumer];
+    bool primary = (consumer == 0);
+
     pthread_mutex_lock(&fifo_mutex);
 
     struct iq_buf *result = NULL;
-    if (!fifo_head && !fifo_halted) {
+    uint64_t wait_start = 0;
+    while (q->count == 0 && !fifo_halted) {
+        if (wait_start == 0 && primary) {
+            wait_start = now_ns();
+            // Empty FIFO once streaming has started is an underrun
+            if (atomic_load_explicit(&stat_dequeued, memory_order_relaxed) > 0) {
+                atomic_fetch_add_explicit(&stat_underruns, 1, memory_order_relaxed);
+            }
+        }
         // No data pending, wait for some
-        pthread_cond_wait(&fifo_notempty_cond, &fifo_mutex);
+        pthread_cond_wait(&q->notempty_cond, &fifo_mutex);
     }
 
     if (!fifo_halted) {
-        result = fifo_head;
-        fifo_head = result->next;
-        result->next = NULL;
-        if (!fifo_head) {
-            fifo_tail = NULL;
+        result = q->ring[q->head];
+        q->head = (q->head + 1) % FIFO_MAX_DEPTH;
+        q->count--;
+        if (queues_empty()) {
             pthread_cond_broadcast(&fifo_empty_cond);
         }
+
+        // Telemetry and depth adaption follow the primary sink only
+        if (primary) {
+            atomic_fetch_add_explicit(&stat_consumer_wait[wait_start ? wait_bin(now_ns() - wait_start) : 0], 1, memory_order_relaxed);
+            atomic_fetch_add_explicit(&stat_dequeued, 1, memory_order_relaxed);
+            atomic_store_explicit(&stat_occupancy, q->count, memory_order_relaxed);
+            if (q->count < atomic_load_explicit(&stat_min_occupancy, memory_order_relaxed)) {
+                atomic_store_explicit(&stat_min_occupancy, q->count, memory_order_relaxed);
+            }
+            fifo_adapt(result);
+        }
     }
 
     pthread_mutex_unlock(&fifo_mutex);
@@ -196,11 +575,6 @@ struct iq_buf *fifo_dequeue(void) {
 
 void fifo_release(struct iq_buf *buf) {
     pthread_mutex_lock(&fifo_mutex);
-    if (!fifo_freelist) {
-        pthread_cond_signal(&fifo_free_cond);
-    }
-    buf->next = fifo_freelist;
-    fifo_freelist = buf;
+    buffer_unref(buf);
     pthread_mutex_unlock(&fifo_mutex);
 }
-
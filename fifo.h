@@ -14,22 +14,126 @@
 #define FIFO_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
+// Alignment of each IQ buffer in the pool, suits SIMD stores
+#define FIFO_BUFFER_ALIGN 64
+// Preferred page size for the buffer pool
+#define FIFO_HUGEPAGE_SIZE (2 * 1024 * 1024)
+// Bounds of the in-flight buffer limit with adaptive FIFO depth
+#define FIFO_MIN_DEPTH 2
+#define FIFO_MAX_DEPTH 32
+// Maximum number of consumers, the primary sink plus taps
+#define FIFO_MAX_CONSUMERS 4
+// Number of dequeues between two depth adjustments
+#define FIFO_ADAPT_INTERVAL 10
+// Number of log2 microsecond bins in wait time histograms, bin 0 is <1us
+#define FIFO_WAIT_BINS 24
+
 struct iq_buf {
     signed char *data8; // 8 bit IQ data
     signed short *data16; // 16 bit IQ data
     unsigned int totalLength; // Maximum number of samples (allocated size of "data")
     unsigned int validLength; // Number of valid samples in "data"
-    struct iq_buf *next; // linked list forward link
+    uint64_t enqueueTime; // Monotonic time when enqueued [ns]
+    unsigned refcount; // Number of consumers still holding this buffer
+    void *pool_data; // Buffer memory in the pool, used without acquire hook
+    struct iq_buf *next; // freelist forward link
+};
+
+// FIFO telemetry snapshot, see fifo_get_stats().
+struct fifo_stats {
+    unsigned long enqueued; // Buffers enqueued since creation
+    unsigned long dequeued; // Buffers dequeued since creation
+    double enqueue_rate; // Average enqueue rate [buffers/s]
+    double dequeue_rate; // Average dequeue rate [buffers/s]
+    double uptime; // Time since creation [s]
+    unsigned occupancy; // Buffers currently queued
+    unsigned min_occupancy; // Lowest number of queued buffers after a dequeue
+    unsigned max_occupancy; // Highest number of queued buffers after an enqueue
+    unsigned depth; // Current limit of in-flight buffers
+    unsigned slack_ms; // Estimated time until the FIFO runs empty
+    unsigned lead_ms; // Smoothed time a buffer spends between enqueue and dequeue
+    unsigned long underruns; // Consumer found the FIFO empty, or reported by backend
+    unsigned long overruns; // Producer found the FIFO full and had to wait
+    unsigned long producer_wait[FIFO_WAIT_BINS]; // Bin i counts waits below 2^i us
+    unsigned long consumer_wait[FIFO_WAIT_BINS]; // Bin i counts waits below 2^i us
 };
 
+// Provides the data memory of an acquired buffer, see fifo_set_acquire_hook().
+typedef void *(*fifo_acquire_hook_t)(size_t bytes);
+// Takes a filled buffer for the primary sink, see fifo_set_enqueue_hook().
+typedef void (*fifo_enqueue_hook_t)(const struct iq_buf *buf);
+
+// Set the target slack in milliseconds for adaptive FIFO depth. Must be called
+// before fifo_create. With 0 (default) the depth stays fixed.
+void fifo_set_target_slack(unsigned slack_ms);
+
 // Create the queue structures. Not threadsafe. Returns true on success.
+// All buffers are carved out of one contiguous, pre-faulted pool backed by
+// hugepages where available. The pool is locked in RAM if permitted.
 //
-//   buffer_count - the number of buffers to preallocate
+//   buffer_count - the number of buffers to preallocate, initial FIFO depth
+//                  (FIFO_MAX_DEPTH buffers are preallocated with adaptive depth)
 //   buffer_size  - the size of each IQ buffer, in samples
+//   sample_size  - the size of one sample element in bytes
 bool fifo_create(unsigned buffer_count, unsigned buffer_size, unsigned sample_size);
 
+// Register an additional consumer (tap). Every buffer enqueued from now on is
+// handed to the primary consumer and all taps, and goes back to the freelist
+// once all of them released it. Returns the consumer id for
+// fifo_dequeue_consumer(), or -1 if no more consumers can be added.
+int fifo_add_consumer(void);
+
+// Let a sink place the IQ data of each acquired buffer in its own memory,
+// e.g. a mapped output file, so the producer writes there directly.
+// The hook is called from fifo_acquire() with the buffer size in bytes; on
+// NULL the buffer falls back to its pool memory. Set it before the producer
+// starts and reset it with NULL once the producer stopped.
+void fifo_set_acquire_hook(fifo_acquire_hook_t hook);
+
+// Hand each enqueued buffer to the primary sink right away instead of
+// queueing it, for sinks fed from a callback that must not block. The hook
+// is called from fifo_enqueue() in the producer thread, the buffer then goes
+// on to the taps only. The sink owns the buffer memory through the acquire
+// hook and must keep it intact while taps may still hold the buffer. The
+// hook runs with the FIFO locked and must not block. Set it
+// before the producer starts and reset it with NULL once the producer stopped.
+void fifo_set_enqueue_hook(fifo_enqueue_hook_t hook);
+
+// Granularity in samples a sink needs for the valid length of a buffer, the
+// buffer size itself if it only takes full buffers. Set after fifo_create(),
+// which resets it to 1.
+void fifo_set_block_align(unsigned align);
+unsigned fifo_block_align(void);
+
+// Start of the IQ data of a buffer, regardless of sample size.
+void *fifo_buffer_data(const struct iq_buf *buf);
+
+// Returns true if the buffer pool could be locked in RAM.
+bool fifo_is_locked(void);
+
+// Current limit of in-flight buffers.
+unsigned fifo_get_depth(void);
+
+// Estimated time until the FIFO runs empty if the producer stalled now.
+unsigned fifo_get_slack_ms(void);
+
+// Take a telemetry snapshot. Lock-free, may be polled from any thread.
+void fifo_get_stats(struct fifo_stats *stats);
+
+// Upper bound in microseconds of the longest wait recorded in a histogram.
+unsigned fifo_wait_max_us(const unsigned long hist[FIFO_WAIT_BINS]);
+
+// Count an underrun detected by a backend, e.g. no data for a transfer.
+void fifo_report_underrun(void);
+
+// Returns true while the remaining slack is below the consumer jitter margin,
+// i.e. an underrun is to be expected. Optionally returns the number of
+// predictions so far in count.
+bool fifo_underrun_predicted(unsigned long *count);
+
 // Destroy the fifo structures allocated in fifo_create. Not threadsafe; ensure all FIFO users
 // are done before calling.
 void fifo_destroy();
@@ -37,7 +141,7 @@ void fifo_destroy();
 // Block until the FIFO is empty.
 void fifo_wait_next();
 
-// Block until the FIFO is full.
+// Block until the FIFO is full, that is the producer reached the depth limit.
 void fifo_wait_full();
 
 // Mark the FIFO as halted. Move any buffers in FIFO to the freelist immediately.
@@ -54,12 +158,17 @@ struct iq_buf *fifo_acquire(void);
 //   buf->data[0 .. buf->validLength-1]
 void fifo_enqueue(struct iq_buf *buf);
 
-// Get a buffer from the tail of the FIFO.
+// Get a buffer from the tail of the FIFO for the primary consumer.
 // If the FIFO is halted (or becomes halted), return NULL immediately.
 // return NULL if no data arrives
 struct iq_buf *fifo_dequeue(void);
 
-// Release a buffer previously returned by fifo_acquire() back to the freelist.
+// Same as fifo_dequeue() for the given consumer id.
+// The buffer may be shared with other consumers and must not be modified.
+struct iq_buf *fifo_dequeue_consumer(int consumer);
+
+// Release a buffer previously returned by fifo_dequeue(). The buffer returns
+// to the freelist when the last consumer released it.
 void fifo_release(struct iq_buf *buf);
 
 #endif
\ No newline at end of file
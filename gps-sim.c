@@ -19,9 +19,16 @@
 #include <sys/stat.h> 
 #include <sys/types.h> 
 #include <sys/time.h>
+#include <limits.h>
 #include "help.h"
 #include "gui.h"
 #include "sdr.h"
+#include "fifo.h"
+#include "pipeline.h"
+#include "replay.h"
+#include "sdr_net.h"
+#include "prefetch.h"
+#include "livepos.h"
 #include "gps-sim.h"
 
 simulator_t simulator;
@@ -40,7 +47,12 @@ static error_t parse_opt(int key, char *arg, struct argp_state *state) {
             if (arg == NULL) {
                 return ARGP_ERR_UNKNOWN;
             }
-            simulator.nav_file_name = strdup(arg);
+            char **files = realloc(simulator.nav_files, (simulator.nav_file_count + 1) * sizeof (char *));
+            if (files == NULL) {
+                return ARGP_ERR_UNKNOWN;
+            }
+            simulator.nav_files = files;
+            simulator.nav_files[simulator.nav_file_count++] = strdup(arg);
             break;
         case 'r':
             if (arg == NULL) {
@@ -67,6 +79,19 @@ static error_t parse_opt(int key, char *arg, struct argp_state *state) {
             simulator.motion_file_name = strdup(arg);
             simulator.interactive_mode = false;
             break;
+        case 719: // --live
+            if (arg == NULL) {
+                return ARGP_ERR_UNKNOWN;
+            }
+            simulator.live_url = strdup(arg);
+            simulator.interactive_mode = false;
+            break;
+        case 720: // --cores
+            if (arg == NULL || !set_core_roles(arg)) {
+                fprintf(stderr, "Error: Cores must be given as main,observation,synthesis,sink.\n");
+                return ARGP_ERR_UNKNOWN;
+            }
+            break;
         case 701: // --station
             if (arg == NULL) {
                 return ARGP_ERR_UNKNOWN;
@@ -133,7 +158,7 @@ static error_t parse_opt(int key, char *arg, struct argp_state *state) {
                 return ARGP_ERR_UNKNOWN;
             }
             d = atof(arg);
-            if (d < 0.0 || d > ((double) USER_MOTION_SIZE) / 10.0) {
+            if (d < 0.0 || d > ((double) INT_MAX) / 10.0) {
                 gui_status_wprintw(RED, "Error: Invalid duration.\n");
                 return -1;
             }
@@ -161,10 +186,105 @@ static error_t parse_opt(int key, char *arg, struct argp_state *state) {
             break;
         case 700: // --iq16
             simulator.sample_size = SC16;
+            simulator.iq_format = IQ_FORMAT_CS16;
             break;
         case 702: // --disable-almanac
             simulator.almanac_enable = false;
             break;
+        case 716: // --no-nav-cache
+            simulator.nav_cache = false;
+            break;
+        case 718: // --nav-watch
+            simulator.nav_watch = true;
+            break;
+        case 717: // --mirror
+            if (arg == NULL) {
+                return ARGP_ERR_UNKNOWN;
+            }
+            simulator.mirror_url = strdup(arg);
+            break;
+        case 703: // --fifo-slack
+            if (arg == NULL) {
+                return ARGP_ERR_UNKNOWN;
+            }
+            simulator.fifo_slack_ms = (unsigned) strtoul(arg, NULL, 10);
+            break;
+        case 704: // --iq-mmap
+            simulator.iq_mmap = true;
+            break;
+        case 705: // --iq-format
+            if (arg == NULL || iq_format_by_name(arg) < 0) {
+                fprintf(stderr, "Error: Unknown IQ format.\n");
+                return ARGP_ERR_UNKNOWN;
+            }
+            simulator.iq_format = (iq_format_t) iq_format_by_name(arg);
+            simulator.sample_size = (int) iq_format_desc(simulator.iq_format)->unit_size;
+            break;
+        case 706: // --iq-file
+            if (arg == NULL) {
+                return ARGP_ERR_UNKNOWN;
+            }
+            simulator.iq_file_name = strdup(arg);
+            break;
+        case 707: // --iq-archive
+            simulator.iq_archive_level = (arg != NULL) ? atoi(arg) : 1;
+            if (simulator.iq_archive_level < 0 || simulator.iq_archive_level > 9) {
+                fprintf(stderr, "Error: Archive compression level must be 0-9.\n");
+                return ARGP_ERR_UNKNOWN;
+            }
+            break;
+        case 708: // --replay
+            if (arg == NULL) {
+                return ARGP_ERR_UNKNOWN;
+            }
+            simulator.replay_file_name = strdup(arg);
+            break;
+        case 709: // --replay-loop
+            simulator.replay_loop = true;
+            break;
+        case 710: // --replay-offset
+            if (arg == NULL || atof(arg) < 0.0) {
+                fprintf(stderr, "Error: Invalid replay offset.\n");
+                return ARGP_ERR_UNKNOWN;
+            }
+            simulator.replay_offset = atof(arg);
+            break;
+        case 711: // --net
+            if (arg == NULL) {
+                return ARGP_ERR_UNKNOWN;
+            }
+            simulator.net_url = strdup(arg);
+            break;
+        case 712: // --net-listen
+            if (arg == NULL) {
+                return ARGP_ERR_UNKNOWN;
+            }
+            simulator.net_listen_url = strdup(arg);
+            break;
+        case 713: // --pluto-buffers
+            if (arg == NULL || atoi(arg) < 1) {
+                fprintf(stderr, "Error: Pluto needs at least one kernel buffer.\n");
+                return ARGP_ERR_UNKNOWN;
+            }
+            simulator.pluto_kernel_buffers = (unsigned) atoi(arg);
+            break;
+        case 714: // --pluto-buffer-size
+            if (arg == NULL || atoi(arg) < 1024) {
+                fprintf(stderr, "Error: Pluto buffer size must be at least 1024 samples.\n");
+                return ARGP_ERR_UNKNOWN;
+            }
+            simulator.pluto_buffer_size = (unsigned) atoi(arg);
+            break;
+        case 715: // --underrun
+            if (arg != NULL && strcmp(arg, "repeat") == 0) {
+                simulator.underrun_repeat = true;
+            } else if (arg != NULL && strcmp(arg, "silence") == 0) {
+                simulator.underrun_repeat = false;
+            } else {
+                fprintf(stderr, "Error: Underrun fill must be silence or repeat.\n");
+                return ARGP_ERR_UNKNOWN;
+            }
+            break;
         case ARGP_KEY_END:
             if (state->arg_num > 0)
                 /* We use only options but no arguments */
@@ -187,7 +307,14 @@ static void simulator_init(void) {
     simulator.use_rinex3 = false;
     simulator.time_overwrite = false;
     simulator.almanac_enable = true;
-    simulator.duration = USER_MOTION_SIZE;
+    simulator.nav_cache = true;
+    simulator.nav_watch = false;
+    simulator.iq_mmap = false;
+    simulator.iq_archive_level = -1;
+    simulator.replay_loop = false;
+    simulator.underrun_repeat = false;
+    simulator.replay_offset = 0.0;
+    simulator.duration = DEFAULT_DURATION;
     simulator.tx_gain = 0;
     simulator.ppb = 0;
     simulator.location.lat = 0;
@@ -199,14 +326,27 @@ static void simulator_init(void) {
     simulator.target.lon = 0;
     simulator.target.height = 0;
     simulator.target.valid = false;
-    simulator.nav_file_name = NULL;
+    simulator.nav_files = NULL;
+    simulator.nav_file_count = 0;
     simulator.sdr_name = NULL;
     simulator.pluto_hostname = NULL;
     simulator.motion_file_name = NULL;
+    simulator.live_url = NULL;
+    simulator.iq_file_name = NULL;
+    simulator.replay_file_name = NULL;
+    simulator.net_url = NULL;
+    simulator.net_listen_url = NULL;
     simulator.pluto_uri = NULL;
     simulator.station_id = NULL;
+    simulator.mirror_url = NULL;
     simulator.sdr_type = SDR_NONE;
     simulator.sample_size = SC08;
+    simulator.iq_format = IQ_FORMAT_CS8;
+    simulator.start_gps.week = -1;
+    simulator.start_gps.sec = 0.0;
+    simulator.fifo_slack_ms = 0;
+    simulator.pluto_kernel_buffers = 8;
+    simulator.pluto_buffer_size = NUM_IQ_SAMPLES;
     pthread_cond_init(&simulator.gps_init_done, NULL);
     pthread_mutex_init(&simulator.gps_lock, NULL);
 }
@@ -220,23 +360,37 @@ static void signal_handler(int sig) {
 static void cleanup_and_exit(int code) {
     simulator.gps_thread_exit = true;
     pthread_join(simulator.gps_thread, NULL); /* Wait on GPS read thread exit */
+    prefetch_close();
 
     pthread_cond_destroy(&simulator.gps_init_done);
     pthread_mutex_destroy(&simulator.gps_lock);
 
+    // Sinks may still refer to the run options, e.g. for file metadata
+    sdr_close();
+
     /* Free when pointing to string in heap (strdup allocated when given as run option) */
-    free(simulator.nav_file_name);
+    for (size_t i = 0; i < simulator.nav_file_count; i++) {
+        free(simulator.nav_files[i]);
+    }
+    free(simulator.nav_files);
     free(simulator.sdr_name);
     free(simulator.pluto_hostname);
     free(simulator.pluto_uri);
     free(simulator.motion_file_name);
+    free(simulator.live_url);
+    free(simulator.iq_file_name);
+    free(simulator.replay_file_name);
+    free(simulator.net_url);
+    free(simulator.net_listen_url);
     free(simulator.station_id);
-    sdr_close();
+    free(simulator.mirror_url);
     gui_destroy();
     fflush(stdout);
     exit(code);
 }
 
+static int core_roles[CORE_ROLES] = DEFAULT_CORES; // Core of each pipeline stage
+
 /* Set trhead name if supported. */
 void set_thread_name(const char *name) {
 #if (__GLIBC__ > 2) || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 12)
@@ -261,11 +415,70 @@ int thread_to_core(int core_id) {
     return pthread_setaffinity_np(current_thread, sizeof (cpu_set_t), &cpuset);
 }
 
+int thread_to_role(core_role_t role) {
+    return thread_to_core(core_roles[role]);
+}
+
+bool set_core_roles(const char *list) {
+    int cores[CORE_ROLES];
+    int n = 0;
+    char *end;
+
+    for (const char *p = list; n < CORE_ROLES; p = end + 1) {
+        long core = strtol(p, &end, 10);
+        if (end == p || core < -1 || core >= CPU_SETSIZE) {
+            return false;
+        }
+        cores[n++] = (int) core;
+        if (*end != ',') {
+            break;
+        }
+    }
+    if (n != CORE_ROLES || *end != '\0') {
+        return false;
+    }
+    memcpy(core_roles, cores, sizeof (core_roles));
+    return true;
+}
+
+static void show_fifo_stats(void) {
+    struct fifo_stats stats;
+    fifo_get_stats(&stats);
+    if (stats.uptime <= 0.0) {
+        return; // No FIFO created
+    }
+
+    gui_mvwprintw(LS_FIX, 13, 40, "FIFO:            %2u/%-2u min %2u max %2u slack %4ums lead %4ums U %lu O %lu  ",
+            stats.occupancy, stats.depth, stats.min_occupancy, stats.max_occupancy,
+            stats.slack_ms, stats.lead_ms, stats.underruns, stats.overruns);
+    if (simulator.show_verbose) {
+        gui_mvwprintw(LS_FIX, 18, 40, "FIFO rate:       in %5.1f/s out %5.1f/s wait P <%uus C <%uus radio %4ums  ",
+                stats.enqueue_rate, stats.dequeue_rate,
+                fifo_wait_max_us(stats.producer_wait), fifo_wait_max_us(stats.consumer_wait),
+                sdr_get_delay_ms());
+
+        pipeline_stats_t pstats;
+        pipeline_get_stats(&pstats);
+        gui_mvwprintw(LS_FIX, 19, 40, "Pipeline:        obs %5.1fms (%5.1f) synth %5.1fms (%5.1f) queued %u  ",
+                pstats.obs_avg_us / 1000.0, pstats.obs_max_us / 1000.0,
+                pstats.synth_avg_us / 1000.0, pstats.synth_max_us / 1000.0, pstats.queued);
+    }
+    if (simulator.live_url != NULL) {
+        livepos_stats_t lstats;
+        livepos_get_stats(&lstats);
+        gui_mvwprintw(LS_FIX, 21, 40, "Live input:      pkts %lu lost %lu drop %lu reorder %lu restart %lu latency %5.1fms (%5.1f)  ",
+                lstats.packets, lstats.lost, lstats.dropped, lstats.reordered, lstats.restarts,
+                lstats.latency_avg_us / 1000.0, lstats.latency_max_us / 1000.0);
+    }
+}
+
 /*
  * 
  */
 int main(int argc, char** argv) {
     int ch = 0;
+    unsigned loop_count = 0;
+    bool underrun_warned = false;
     bool is_info_shown = false;
     bool is_help_shown = false;
 
@@ -276,21 +489,26 @@ int main(int argc, char** argv) {
 
     // Initialize all simulator variables
     simulator_init();
-    /* On a multi-core CPU we run the main thread and reader thread on different cores.
-     * Try sticking the main thread to core 1
-     */
-    thread_to_core(1);
-    set_thread_name("simulator-thread");
-
     // Parse the command line options
     if (argp_parse(&argp, argc, argv, 0, 0, 0)) {
         return (EXIT_FAILURE);
     }
 
-    if (simulator.nav_file_name == NULL && simulator.use_ftp == false) {
+    /* On a multi-core CPU we run the main thread and reader thread on different cores.
+     * Try sticking the main thread to its own core
+     */
+    thread_to_role(CORE_MAIN);
+    set_thread_name("simulator-thread");
+
+    if (simulator.nav_file_count == 0 && simulator.use_ftp == false
+            && simulator.replay_file_name == NULL && simulator.net_listen_url == NULL) {
         fprintf(stderr, "Error: GPS ephemeris file is not specified\n");
         return (EXIT_FAILURE);
     }
+    if (simulator.live_url != NULL && simulator.motion_file_name != NULL) {
+        fprintf(stderr, "Error: Live position input and user motion file can't be combined\n");
+        return (EXIT_FAILURE);
+    }
     gui_init();
     // No access to GUI until this point
 
@@ -299,6 +517,11 @@ int main(int argc, char** argv) {
         simulator.target.valid = false;
         gui_status_wprintw(YELLOW, "User motion file supplied. Interactive mode disabled!\n");
     }
+    if (simulator.interactive_mode && simulator.live_url != NULL) {
+        simulator.interactive_mode = false;
+        simulator.target.valid = false;
+        gui_status_wprintw(YELLOW, "Live position input supplied. Interactive mode disabled!\n");
+    }
 
     // Wait maximum 30 seconds for GPS thread to become ready
     struct timespec timeout;
@@ -307,11 +530,24 @@ int main(int argc, char** argv) {
     timeout.tv_sec = now.tv_sec + 30;
     timeout.tv_nsec = 0;
 
+    // Generate the GPS baseband signal, or stream a pre-rendered file or a
+    // remote generator
+    void *(*source)(void *) = gps_thread_ep;
+    if (simulator.replay_file_name != NULL) {
+        source = replay_thread_ep;
+    } else if (simulator.net_listen_url != NULL) {
+        source = net_source_thread_ep;
+    }
+    // Load ephemeris and almanac while the SDR initializes
+    if (source == gps_thread_ep) {
+        prefetch_start(&simulator);
+    }
+
     // Init prior GPS thread, creates FIFO.
+    fifo_set_target_slack(simulator.fifo_slack_ms);
     if (sdr_init(&simulator) == 0) {
-        // Start GPS baseband signal generation
         gui_top_panel(LS_FIX);
-        pthread_create(&simulator.gps_thread, NULL, gps_thread_ep, &simulator);
+        pthread_create(&simulator.gps_thread, NULL, source, &simulator);
 
         pthread_mutex_lock(&(simulator.gps_lock));
         int ret = pthread_cond_timedwait(&(simulator.gps_init_done), &(simulator.gps_lock), &timeout);
@@ -330,6 +566,28 @@ int main(int argc, char** argv) {
     }
     // Run this until we get a termination signal.
     while (!simulator.main_exit) {
+        // Warn once each time the FIFO slack falls below the jitter margin
+        bool underrun_predicted = fifo_underrun_predicted(NULL);
+        if (underrun_predicted && !underrun_warned) {
+            gui_status_wprintw(YELLOW, "FIFO slack low (%ums), underrun predicted.\n", fifo_get_slack_ms());
+        }
+        underrun_warned = underrun_predicted;
+
+        // Poll FIFO telemetry once per second
+        if (++loop_count % 10 == 0) {
+            show_fifo_stats();
+        }
+
+        // Without terminal there is no exit key, stop once the signal source
+        // has finished and the sinks took all buffers.
+        if (gui_is_headless() && simulator.gps_thread_exit) {
+            struct fifo_stats stats;
+            fifo_get_stats(&stats);
+            if (stats.occupancy == 0) {
+                simulator.main_exit = true;
+            }
+        }
+
         ch = gui_getch();
         if (ch != -1) {
             switch (ch) {
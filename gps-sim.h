@@ -20,6 +20,7 @@
 #include <pthread.h>
 #include <stdatomic.h>
 #include "gps.h"
+#include "iqformat.h"
 
 #define NOTUSED(V) ((void) V)
 
@@ -29,7 +30,7 @@
 
 /* SDR device types */
 typedef enum {
-    SDR_NONE = 0, SDR_IQFILE, SDR_HACKRF, SDR_PLUTOSDR
+    SDR_NONE = 0, SDR_IQFILE, SDR_HACKRF, SDR_PLUTOSDR, SDR_NET, SDR_STDOUT
 } sdr_type_t;
 
 /* Target information. */
@@ -65,27 +66,62 @@ typedef struct {
     bool use_rinex3;
     bool time_overwrite;
     bool almanac_enable;
+    bool iq_mmap;
+    bool replay_loop;
+    bool nav_cache; // Load and save the binary ephemeris cache next to the nav file
+    bool nav_watch; // Reload the nav inputs when they change
+    bool underrun_repeat; // Repeat the last block on TX underrun instead of silence
     int duration;
     int tx_gain;
     int ppb;
     int sample_size;
+    int iq_archive_level; // zlib level of chunked IQ archive, -1 for plain file
+    iq_format_t iq_format;
+    unsigned fifo_slack_ms;
+    unsigned pluto_kernel_buffers; // libiio kernel buffer count
+    unsigned pluto_buffer_size; // IQ samples per libiio buffer
+    double replay_offset; // Replay start offset in seconds
     sdr_type_t sdr_type;
-    char *nav_file_name;
+    char **nav_files; // RINEX files, directories or glob patterns
+    size_t nav_file_count;
     char *motion_file_name;
+    char *live_url; // Socket receiving live positions
+    char *iq_file_name;
+    char *replay_file_name;
+    char *net_url;
+    char *net_listen_url;
     char *sdr_name;
     char *pluto_uri;
     char *pluto_hostname;
     char *station_id;
+    char *mirror_url; // Replaces the online RINEX and almanac source
     pthread_mutex_t gps_lock;
     pthread_t gps_thread;
     pthread_cond_t gps_init_done; // Condition signals GPS thread is running
     location_t location; // Simulator geo location
     target_t target; // Target information
     datetime_t start; // Simulation start time
+    gpstime_t start_gps; // Scenario start in GPS time, set by GPS thread
 } simulator_t;
 
+/* Pipeline stages, each runs on its own core to keep the real-time sink
+ * clear of the signal generation. */
+typedef enum {
+    CORE_MAIN = 0, // Simulator and GUI thread
+    CORE_OBSERVATION, // Observation stage of the GPS thread
+    CORE_SYNTHESIS, // IQ synthesis, or the replay or network source
+    CORE_SINK, // Consumer threads of the radios and file sinks
+    CORE_ROLES
+} core_role_t;
+
+#define DEFAULT_CORES {1, 2, 3, 4}
+
 void set_thread_name(const char *name);
 int thread_to_core(int core_id);
+/* Pin the calling thread to the core assigned to role, -1 leaves it unpinned. */
+int thread_to_role(core_role_t role);
+/* Assign cores from "main,observation,synthesis,sink", false if malformed. */
+bool set_core_roles(const char *list);
 
 #endif /* GPS_SIM_H */
 
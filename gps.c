@@ -24,6 +24,13 @@
 #include "fifo.h"
 #include "almanac.h"
 #include "gps-sim.h"
+#include "pipeline.h"
+#include "reframer.h"
+#include "ephstore.h"
+#include "prefetch.h"
+#include "navwatch.h"
+#include "motion.h"
+#include "livepos.h"
 
 /**
  * Note:
@@ -137,11 +144,6 @@ const stations_t stations_v2[] = {
 
 static char rinex_date[21];
 
-struct ftp_file {
-    const char *filename;
-    FILE *stream;
-};
-
 const int sinTable512[] = {
     2, 5, 8, 11, 14, 17, 20, 23, 26, 29, 32, 35, 38, 41, 44, 47,
     50, 53, 56, 59, 62, 65, 68, 71, 74, 77, 80, 83, 86, 89, 91, 94,
@@ -312,7 +314,7 @@ static void codegen(int *ca, int prn) {
  * t input date in UTC form
  * g output date in GPS form
  */
-static void date2gps(const datetime_t *t, gpstime_t *g) {
+void date2gps(const datetime_t *t, gpstime_t *g) {
     int doy[12] = {0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334};
     int ye;
     int de;
@@ -336,7 +338,7 @@ static void date2gps(const datetime_t *t, gpstime_t *g) {
     return;
 }
 
-static void gps2date(const gpstime_t *g, datetime_t *t) {
+void gps2date(const gpstime_t *g, datetime_t *t) {
     // Convert Julian day number to calendar date
     int c = (int) (7 * g->week + floor(g->sec / 86400.0) + 2444245.0) + 1537;
     int d = (int) ((c - 122.1) / 365.25);
@@ -409,7 +411,7 @@ static void xyz2llh(const double *xyz, double *llh) {
  * llh Input Array of Latitude, Longitude and Height
  * xyz Output Array of X, Y and Z ECEF coordinates
  */
-static void llh2xyz(const double *llh, double *xyz) {
+void llh2xyz(const double *llh, double *xyz) {
     double n;
     double a;
     double e;
@@ -446,7 +448,7 @@ static void llh2xyz(const double *llh, double *xyz) {
  * llh Input position in Latitude-Longitude-Height format
  * t Three-by-Three output matrix
  */
-static void ltcmat(const double *llh, double t[3][3]) {
+void ltcmat(const double *llh, double t[3][3]) {
     double slat, clat;
     double slon, clon;
 
@@ -1071,28 +1073,6 @@ static unsigned long computeChecksum(unsigned long source, int nib) {
     return (D);
 }
 
-/* Replace all 'E' exponential designators to 'D'
- * str String in which all occurrences of 'E' are replaced with *  'D'
- * len Length of input string in bytes
- * Number of characters replaced
- */
-static int replaceExpDesignator(char *str, int len) {
-    int i, n = 0;
-
-    for (i = 0; i < len; i++) {
-        if (str[i] == 0) {
-            break;
-        }
-
-        if (str[i] == 'D' || str[i] == 'd') {
-            n++;
-            str[i] = 'E';
-        }
-    }
-
-    return (n);
-}
-
 static double subGpsTime(gpstime_t g1, gpstime_t g0) {
     double dt;
 
@@ -1123,771 +1103,42 @@ static gpstime_t incGpsTime(gpstime_t g0, double dt) {
     return (g1);
 }
 
-/* Read Ephemeris data from the RINEX v2 Navigation file
- * eph Array of Output SV ephemeris data
- * fname File name of the RINEX file
- * Number of sets of ephemerides in the file
+/* Move TOC and TOE of all ephemerides by dsec seconds
+ * The uniform shift keeps the store sorted
  */
-static int readRinex2(ephem_t eph[][MAX_SAT], ionoutc_t *ionoutc, const char *fname) {
-    struct gzFile_s *fp;
-    int ieph;
-
-    int sv;
-    char str[MAX_CHAR];
-    char tmp[20];
-    double ver = 0.0;
-
-    datetime_t t;
-    gpstime_t g;
-    gpstime_t g0;
-    double dt;
-
-    int flags = 0x0;
-
-    if (NULL == (fp = gzopen(fname, "rt")))
-        return (-1);
-
-    // Clear valid flag
-    for (ieph = 0; ieph < EPHEM_ARRAY_SIZE; ieph++)
-        for (sv = 0; sv < MAX_SAT; sv++)
-            eph[ieph][sv].vflg = false;
-
-    // Read header lines
-    while (1) {
-        if (NULL == gzgets(fp, str, MAX_CHAR))
-            break;
-
-        if (strncmp(str + 60, "COMMENT", 7) == 0) {
-            continue;
-        } else if (strncmp(str + 60, "END OF HEADER", 13) == 0) {
-            break;
-        } else if (strncmp(str + 60, "RINEX VERSION / TYPE", 20) == 0) {
-            strncpy(tmp, str, 9);
-            tmp[9] = 0;
-            replaceExpDesignator(tmp, 9);
-            ver = atof(tmp);
-            if (ver > 3.0) {
-                gzclose(fp);
-                return -2;
-            }
-
-            if (str[20] != 'N') {
-                gzclose(fp);
-                return -3;
-            }
-        } else if (strncmp(str + 60, "PGM / RUN BY / DATE", 19) == 0) {
-            strncpy(rinex_date, str + 40, 20);
-            rinex_date[20] = 0;
-        } else if (strncmp(str + 60, "ION ALPHA", 9) == 0) {
-            strncpy(tmp, str + 2, 12);
-            tmp[12] = 0;
-            replaceExpDesignator(tmp, 12);
-            ionoutc->alpha0 = atof(tmp);
-
-            strncpy(tmp, str + 14, 12);
-            tmp[12] = 0;
-            replaceExpDesignator(tmp, 12);
-            ionoutc->alpha1 = atof(tmp);
-
-            strncpy(tmp, str + 26, 12);
-            tmp[12] = 0;
-            replaceExpDesignator(tmp, 12);
-            ionoutc->alpha2 = atof(tmp);
-
-            strncpy(tmp, str + 38, 12);
-            tmp[12] = 0;
-            replaceExpDesignator(tmp, 12);
-            ionoutc->alpha3 = atof(tmp);
-
-            flags |= 0x1;
-        } else if (strncmp(str + 60, "ION BETA", 8) == 0) {
-            strncpy(tmp, str + 2, 12);
-            tmp[12] = 0;
-            replaceExpDesignator(tmp, 12);
-            ionoutc->beta0 = atof(tmp);
-
-            strncpy(tmp, str + 14, 12);
-            tmp[12] = 0;
-            replaceExpDesignator(tmp, 12);
-            ionoutc->beta1 = atof(tmp);
-
-            strncpy(tmp, str + 26, 12);
-            tmp[12] = 0;
-            replaceExpDesignator(tmp, 12);
-            ionoutc->beta2 = atof(tmp);
-
-            strncpy(tmp, str + 38, 12);
-            tmp[12] = 0;
-            replaceExpDesignator(tmp, 12);
-            ionoutc->beta3 = atof(tmp);
-
-            flags |= 0x1 << 1;
-        } else if (strncmp(str + 60, "DELTA-UTC", 9) == 0) {
-            strncpy(tmp, str + 3, 19);
-            tmp[19] = 0;
-            replaceExpDesignator(tmp, 19);
-            ionoutc->A0 = atof(tmp);
-
-            strncpy(tmp, str + 22, 19);
-            tmp[19] = 0;
-            replaceExpDesignator(tmp, 19);
-            ionoutc->A1 = atof(tmp);
-
-            strncpy(tmp, str + 41, 9);
-            tmp[9] = 0;
-            ionoutc->tot = atoi(tmp);
-
-            strncpy(tmp, str + 50, 9);
-            tmp[9] = 0;
-            ionoutc->wnt = atoi(tmp);
-
-            if (ionoutc->tot % 4096 == 0)
-                flags |= 0x1 << 2;
-        } else if (strncmp(str + 60, "LEAP SECONDS", 12) == 0) {
-            strncpy(tmp, str, 6);
-            tmp[6] = 0;
-            ionoutc->dtls = atoi(tmp);
-
-            flags |= 0x1 << 3;
-        }
-    }
-
-    ionoutc->vflg = false;
-    if (flags == 0xF) // Read all Iono/UTC lines
-        ionoutc->vflg = true;
-
-    // Read ephemeris blocks
-    g0.week = -1;
-    ieph = 0;
-
-    while (1) {
-        if (NULL == gzgets(fp, str, MAX_CHAR))
-            break;
-
-        // PRN
-        strncpy(tmp, str, 2);
-        tmp[2] = 0;
-        sv = atoi(tmp) - 1;
-
-        // EPOCH
-        strncpy(tmp, str + 3, 2);
-        tmp[2] = 0;
-        t.y = atoi(tmp) + 2000;
-
-        strncpy(tmp, str + 6, 2);
-        tmp[2] = 0;
-        t.m = atoi(tmp);
-
-        strncpy(tmp, str + 9, 2);
-        tmp[2] = 0;
-        t.d = atoi(tmp);
-
-        strncpy(tmp, str + 12, 2);
-        tmp[2] = 0;
-        t.hh = atoi(tmp);
-
-        strncpy(tmp, str + 15, 2);
-        tmp[2] = 0;
-        t.mm = atoi(tmp);
-
-        strncpy(tmp, str + 18, 4);
-        tmp[2] = 0;
-        t.sec = atof(tmp);
-
-        date2gps(&t, &g);
-
-        if (g0.week == -1)
-            g0 = g;
-
-        // Check current time of clock
-        dt = subGpsTime(g, g0);
-
-        if (dt > SECONDS_IN_HOUR) {
-            g0 = g;
-            ieph++; // a new set of ephemerides
+static void shiftEphemeris(ephstore_t *store, double dsec) {
+    gpstime_t gtmp;
 
-            if (ieph >= EPHEM_ARRAY_SIZE)
-                break;
+    for (int sv = 0; sv < MAX_SAT; sv++) {
+        for (size_t k = 0; k < store->sv[sv].count; k++) {
+            ephem_t *e = &store->sv[sv].eph[k];
+            gtmp = incGpsTime(e->toc, dsec);
+            gps2date(&gtmp, &e->t);
+            e->toc = gtmp;
+            e->toe = incGpsTime(e->toe, dsec);
         }
-
-        // Date and time
-        eph[ieph][sv].t = t;
-
-        // SV CLK
-        eph[ieph][sv].toc = g;
-
-        strncpy(tmp, str + 22, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19); // tmp[15]='E';
-        eph[ieph][sv].af0 = atof(tmp);
-
-        strncpy(tmp, str + 41, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].af1 = atof(tmp);
-
-        strncpy(tmp, str + 60, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].af2 = atof(tmp);
-
-        // BROADCAST ORBIT - 1
-        if (NULL == gzgets(fp, str, MAX_CHAR))
-            break;
-
-        strncpy(tmp, str + 3, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].iode = (int) atof(tmp);
-
-        strncpy(tmp, str + 22, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].crs = atof(tmp);
-
-        strncpy(tmp, str + 41, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].deltan = atof(tmp);
-
-        strncpy(tmp, str + 60, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].m0 = atof(tmp);
-
-        // BROADCAST ORBIT - 2
-        if (NULL == gzgets(fp, str, MAX_CHAR))
-            break;
-
-        strncpy(tmp, str + 3, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].cuc = atof(tmp);
-
-        strncpy(tmp, str + 22, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].ecc = atof(tmp);
-
-        strncpy(tmp, str + 41, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].cus = atof(tmp);
-
-        strncpy(tmp, str + 60, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].sqrta = atof(tmp);
-
-        // BROADCAST ORBIT - 3
-        if (NULL == gzgets(fp, str, MAX_CHAR))
-            break;
-
-        strncpy(tmp, str + 3, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].toe.sec = atof(tmp);
-
-        strncpy(tmp, str + 22, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].cic = atof(tmp);
-
-        strncpy(tmp, str + 41, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].omg0 = atof(tmp);
-
-        strncpy(tmp, str + 60, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].cis = atof(tmp);
-
-        // BROADCAST ORBIT - 4
-        if (NULL == gzgets(fp, str, MAX_CHAR))
-            break;
-
-        strncpy(tmp, str + 3, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].inc0 = atof(tmp);
-
-        strncpy(tmp, str + 22, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].crc = atof(tmp);
-
-        strncpy(tmp, str + 41, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].aop = atof(tmp);
-
-        strncpy(tmp, str + 60, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].omgdot = atof(tmp);
-
-        // BROADCAST ORBIT - 5
-        if (NULL == gzgets(fp, str, MAX_CHAR))
-            break;
-
-        strncpy(tmp, str + 3, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].idot = atof(tmp);
-
-        strncpy(tmp, str + 22, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].code = (int) atof(tmp);
-
-        strncpy(tmp, str + 41, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].toe.week = (int) atof(tmp);
-
-        strncpy(tmp, str + 60, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].flag = (int) atof(tmp);
-
-        // BROADCAST ORBIT - 6
-        if (NULL == gzgets(fp, str, MAX_CHAR))
-            break;
-
-        strncpy(tmp, str + 3, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].sva = (int) atof(tmp);
-
-        strncpy(tmp, str + 22, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].svh = (int) atof(tmp);
-        if ((eph[ieph][sv].svh > 0) && (eph[ieph][sv].svh < 32))
-            eph[ieph][sv].svh += 32; // Set MSB to 1
-
-        strncpy(tmp, str + 41, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].tgd = atof(tmp);
-
-        strncpy(tmp, str + 60, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].iodc = (int) atof(tmp);
-
-        // BROADCAST ORBIT - 7
-        if (NULL == gzgets(fp, str, MAX_CHAR))
-            break;
-
-        strncpy(tmp, str + 22, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].fit = atof(tmp);
-
-        // Set valid flag
-        eph[ieph][sv].vflg = true;
-
-        // Update the working variables
-        eph[ieph][sv].A = eph[ieph][sv].sqrta * eph[ieph][sv].sqrta;
-        eph[ieph][sv].n = sqrt(GM_EARTH / (eph[ieph][sv].A * eph[ieph][sv].A * eph[ieph][sv].A)) + eph[ieph][sv].deltan;
-        eph[ieph][sv].sq1e2 = sqrt(1.0 - eph[ieph][sv].ecc * eph[ieph][sv].ecc);
-        eph[ieph][sv].omgkdot = eph[ieph][sv].omgdot - OMEGA_EARTH;
     }
+}
 
-    gzclose(fp);
-
-    if (g0.week >= 0)
-        ieph += 1; // Number of sets of ephemerides
-
-    return (ieph);
+/* True if both are the same broadcast record, compared on content since
+ * a reload moves records to a new store. */
+static bool sameEphemeris(const ephem_t *a, const ephem_t *b) {
+    return a != NULL && b != NULL && a->iode == b->iode && subGpsTime(a->toe, b->toe) == 0.0;
 }
 
-/* Read Ephemeris data from the RINEX v3 Navigation file
- * eph Array of Output SV ephemeris data
- * fname File name of the RINEX file
- * Number of sets of ephemerides in the file
+/* Pick the ephemeris of each SV for time g
+ * Number of SVs with a valid ephemeris
  */
-static int readRinex3(ephem_t eph[][MAX_SAT], ionoutc_t *ionoutc, const char *fname) {
-    struct gzFile_s *fp;
-    int ieph;
-
-    int sv;
-    char str[MAX_CHAR];
-    char tmp[20];
-    double ver = 0.0;
-
-    datetime_t t;
-    gpstime_t g;
-    gpstime_t g0;
-    double dt;
-
-    int flags = 0x0;
-
-    if (NULL == (fp = gzopen(fname, "rt")))
-        return (-1);
-
-    // Clear valid flag
-    for (ieph = 0; ieph < EPHEM_ARRAY_SIZE; ieph++)
-        for (sv = 0; sv < MAX_SAT; sv++)
-            eph[ieph][sv].vflg = false;
-
-    // Read header lines
-    while (1) {
-        if (NULL == gzgets(fp, str, MAX_CHAR))
-            break;
-
-        if (strncmp(str + 60, "COMMENT", 7) == 0) {
-            continue;
-        } else if (strncmp(str + 60, "END OF HEADER", 13) == 0) {
-            break;
-        } else if (strncmp(str + 60, "RINEX VERSION / TYPE", 20) == 0) {
-            strncpy(tmp, str, 9);
-            tmp[9] = 0;
-            replaceExpDesignator(tmp, 9);
-            ver = atof(tmp);
-            if (ver < 3.0) {
-                gzclose(fp);
-                return -2;
-            }
-
-            if (str[20] != 'N' && str[40] != 'G') {
-                gzclose(fp);
-                return -3;
-            }
-        } else if (strncmp(str + 60, "PGM / RUN BY / DATE", 19) == 0) {
-            strncpy(rinex_date, str + 40, 20);
-            rinex_date[20] = 0;
-        } else if (strncmp(str + 60, "IONOSPHERIC CORR", 16) == 0) {
-            if (strncmp(str, "GPSA", 4) == 0) {
-                strncpy(tmp, str + 5, 12);
-                tmp[12] = 0;
-                replaceExpDesignator(tmp, 12);
-                ionoutc->alpha0 = atof(tmp);
-
-                strncpy(tmp, str + 17, 12);
-                tmp[12] = 0;
-                replaceExpDesignator(tmp, 12);
-                ionoutc->alpha1 = atof(tmp);
-
-                strncpy(tmp, str + 29, 12);
-                tmp[12] = 0;
-                replaceExpDesignator(tmp, 12);
-                ionoutc->alpha2 = atof(tmp);
-
-                strncpy(tmp, str + 41, 12);
-                tmp[12] = 0;
-                replaceExpDesignator(tmp, 12);
-                ionoutc->alpha3 = atof(tmp);
-
-                flags |= 0x1;
-            } else if (strncmp(str, "GPSB", 4) == 0) {
-                strncpy(tmp, str + 5, 12);
-                tmp[12] = 0;
-                replaceExpDesignator(tmp, 12);
-                ionoutc->beta0 = atof(tmp);
-
-                strncpy(tmp, str + 17, 12);
-                tmp[12] = 0;
-                replaceExpDesignator(tmp, 12);
-                ionoutc->beta1 = atof(tmp);
-
-                strncpy(tmp, str + 29, 12);
-                tmp[12] = 0;
-                replaceExpDesignator(tmp, 12);
-                ionoutc->beta2 = atof(tmp);
-
-                strncpy(tmp, str + 41, 12);
-                tmp[12] = 0;
-                replaceExpDesignator(tmp, 12);
-                ionoutc->beta3 = atof(tmp);
-
-                flags |= 0x1 << 1;
-            }
-        } else if (strncmp(str + 60, "TIME SYSTEM CORR", 16) == 0 && strncmp(str, "GPUT", 4) == 0) {
-            strncpy(tmp, str + 5, 17);
-            tmp[17] = 0;
-            replaceExpDesignator(tmp, 17);
-            ionoutc->A0 = atof(tmp);
-
-            strncpy(tmp, str + 22, 16);
-            tmp[16] = 0;
-            replaceExpDesignator(tmp, 16);
-            ionoutc->A1 = atof(tmp);
-
-            strncpy(tmp, str + 38, 7);
-            tmp[7] = 0;
-            replaceExpDesignator(tmp, 7);
-            ionoutc->tot = atoi(tmp);
-
-            strncpy(tmp, str + 45, 6);
-            tmp[6] = 0;
-            ionoutc->wnt = atoi(tmp);
-
-            if (ionoutc->tot % 4096 == 0)
-                flags |= 0x1 << 2;
-        } else if (strncmp(str + 60, "LEAP SECONDS", 12) == 0) {
-            strncpy(tmp, str, 6);
-            tmp[6] = 0;
-            ionoutc->dtls = atoi(tmp);
-
-            flags |= 0x1 << 3;
-        }
-    }
-
-    ionoutc->vflg = false;
-    if (flags == 0xF) // Read all Iono/UTC lines
-        ionoutc->vflg = true;
-
-    // Read ephemeris blocks
-    g0.week = -1;
-    ieph = 0;
-
-    while (1) {
-        if (NULL == gzgets(fp, str, MAX_CHAR))
-            break;
-
-        // Check for GPS data record
-        if (str[0] != 'G') {
-            continue;
-        }
-
-        // PRN
-        strncpy(tmp, str + 1, 2);
-        tmp[2] = 0;
-        sv = atoi(tmp) - 1;
-
-        // EPOCH
-        strncpy(tmp, str + 4, 4);
-        tmp[4] = 0;
-        t.y = atoi(tmp);
-
-        strncpy(tmp, str + 9, 2);
-        tmp[2] = 0;
-        t.m = atoi(tmp);
-
-        strncpy(tmp, str + 12, 2);
-        tmp[2] = 0;
-        t.d = atoi(tmp);
-
-        strncpy(tmp, str + 15, 2);
-        tmp[2] = 0;
-        t.hh = atoi(tmp);
-
-        strncpy(tmp, str + 18, 2);
-        tmp[2] = 0;
-        t.mm = atoi(tmp);
-
-        strncpy(tmp, str + 21, 2);
-        tmp[2] = 0;
-        t.sec = (double) atoi(tmp);
-
-        date2gps(&t, &g);
-
-        if (g0.week == -1)
-            g0 = g;
-
-        // Check current time of clock
-        dt = subGpsTime(g, g0);
-
-        if (dt > SECONDS_IN_HOUR) {
-            g0 = g;
-            ieph++; // a new set of ephemerides
-
-            if (ieph >= EPHEM_ARRAY_SIZE)
-                break;
-        }
-
-        // Date and time
-        eph[ieph][sv].t = t;
-
-        // SV CLK
-        eph[ieph][sv].toc = g;
-
-        strncpy(tmp, str + 23, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].af0 = atof(tmp);
-
-        strncpy(tmp, str + 42, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].af1 = atof(tmp);
-
-        strncpy(tmp, str + 61, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].af2 = atof(tmp);
-
-        // BROADCAST ORBIT - 1
-        if (NULL == gzgets(fp, str, MAX_CHAR))
-            break;
-
-        strncpy(tmp, str + 4, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].iode = (int) atof(tmp);
-
-        strncpy(tmp, str + 23, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].crs = atof(tmp);
-
-        strncpy(tmp, str + 42, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].deltan = atof(tmp);
-
-        strncpy(tmp, str + 61, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].m0 = atof(tmp);
-
-        // BROADCAST ORBIT - 2
-        if (NULL == gzgets(fp, str, MAX_CHAR))
-            break;
-
-        strncpy(tmp, str + 4, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].cuc = atof(tmp);
-
-        strncpy(tmp, str + 23, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].ecc = atof(tmp);
-
-        strncpy(tmp, str + 42, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].cus = atof(tmp);
-
-        strncpy(tmp, str + 61, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].sqrta = atof(tmp);
-
-        // BROADCAST ORBIT - 3
-        if (NULL == gzgets(fp, str, MAX_CHAR))
-            break;
-
-        strncpy(tmp, str + 4, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].toe.sec = atof(tmp);
-
-        strncpy(tmp, str + 23, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].cic = atof(tmp);
-
-        strncpy(tmp, str + 42, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].omg0 = atof(tmp);
-
-        strncpy(tmp, str + 61, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].cis = atof(tmp);
-
-        // BROADCAST ORBIT - 4
-        if (NULL == gzgets(fp, str, MAX_CHAR))
-            break;
-
-        strncpy(tmp, str + 4, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].inc0 = atof(tmp);
+static int selectEphemeris(const ephstore_t *store, gpstime_t g, const ephem_t *eph[MAX_SAT]) {
+    int n = 0;
 
-        strncpy(tmp, str + 23, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].crc = atof(tmp);
-
-        strncpy(tmp, str + 42, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].aop = atof(tmp);
-
-        strncpy(tmp, str + 61, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].omgdot = atof(tmp);
-
-        // BROADCAST ORBIT - 5
-        if (NULL == gzgets(fp, str, MAX_CHAR))
-            break;
-
-        strncpy(tmp, str + 4, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].idot = atof(tmp);
-
-        strncpy(tmp, str + 23, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].code = (int) atof(tmp);
-
-        strncpy(tmp, str + 42, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].toe.week = (int) atof(tmp);
-
-        strncpy(tmp, str + 61, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].flag = (int) atof(tmp);
-
-        // BROADCAST ORBIT - 6
-        if (NULL == gzgets(fp, str, MAX_CHAR))
-            break;
-
-        // SV accuracy not read
-
-        strncpy(tmp, str + 23, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].svh = (int) atof(tmp);
-        if ((eph[ieph][sv].svh > 0) && (eph[ieph][sv].svh < 32))
-            eph[ieph][sv].svh += 32; // Set MSB to 1
-
-        strncpy(tmp, str + 42, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].tgd = atof(tmp);
-
-        strncpy(tmp, str + 61, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].iodc = (int) atof(tmp);
-
-        // BROADCAST ORBIT - 7
-        if (NULL == gzgets(fp, str, MAX_CHAR))
-            break;
-
-        strncpy(tmp, str + 23, 19);
-        tmp[19] = 0;
-        replaceExpDesignator(tmp, 19);
-        eph[ieph][sv].fit = atof(tmp);
-
-        // Set valid flag
-        eph[ieph][sv].vflg = true;
-
-        // Update the working variables
-        eph[ieph][sv].A = eph[ieph][sv].sqrta * eph[ieph][sv].sqrta;
-        eph[ieph][sv].n = sqrt(GM_EARTH / (eph[ieph][sv].A * eph[ieph][sv].A * eph[ieph][sv].A)) + eph[ieph][sv].deltan;
-        eph[ieph][sv].sq1e2 = sqrt(1.0 - eph[ieph][sv].ecc * eph[ieph][sv].ecc);
-        eph[ieph][sv].omgkdot = eph[ieph][sv].omgdot - OMEGA_EARTH;
+    for (int sv = 0; sv < MAX_SAT; sv++) {
+        eph[sv] = ephstore_find(store, sv + 1, g);
+        if (eph[sv] != NULL)
+            n++;
     }
 
-    gzclose(fp);
-
-    if (g0.week >= 0)
-        ieph += 1; // Number of sets of ephemerides
-
-    return (ieph);
+    return (n);
 }
 
 static double ionosphericDelay(const ionoutc_t *ionoutc, gpstime_t g, double *llh, double *azel) {
@@ -2139,18 +1390,18 @@ void generateNavMsg(gpstime_t g, channel_t *chan, int init) {
         chan->ipage = 0;
 }
 
-static int checkSatVisibility(ephem_t eph, gpstime_t g, double *xyz, double elvMask, double *azel) {
+static int checkSatVisibility(const ephem_t *eph, gpstime_t g, double *xyz, double elvMask, double *azel) {
     double llh[3], neu[3];
     double pos[3], vel[3], clk[3], los[3];
     double tmat[3][3];
 
-    if (eph.vflg == false)
+    if (eph == NULL || eph->vflg == false)
         return (-1); // Invalid
 
     xyz2llh(xyz, llh);
     ltcmat(llh, tmat);
 
-    satpos(eph, g, pos, vel, clk);
+    satpos(*eph, g, pos, vel, clk);
     subVect(los, pos, xyz);
     ecef2neu(los, tmat, neu);
     neu2azel(azel, neu);
@@ -2161,7 +1412,7 @@ static int checkSatVisibility(ephem_t eph, gpstime_t g, double *xyz, double elvM
     return (0); // Invisible
 }
 
-static int allocateChannel(channel_t *chan, almanac_gps_t *alm, ephem_t *eph, ionoutc_t ionoutc, gpstime_t grx, double *xyz, double elvMask) {
+static int allocateChannel(channel_t *chan, almanac_gps_t *alm, const ephem_t *eph[MAX_SAT], ionoutc_t ionoutc, gpstime_t grx, double *xyz, double elvMask) {
     NOTUSED(elvMask);
     int nsat = 0;
     int i, sv;
@@ -2190,19 +1441,19 @@ static int allocateChannel(channel_t *chan, almanac_gps_t *alm, ephem_t *eph, io
                         codegen(chan[i].ca, chan[i].prn);
 
                         // Generate subframe
-                        eph2sbf(eph[sv], ionoutc, alm, chan[i].sbf);
+                        eph2sbf(*eph[sv], ionoutc, alm, chan[i].sbf);
 
                         // Generate navigation message
                         generateNavMsg(grx, &chan[i], 1);
 
                         // Initialize pseudorange
-                        computeRange(&rho, eph[sv], &ionoutc, grx, xyz);
+                        computeRange(&rho, *eph[sv], &ionoutc, grx, xyz);
                         chan[i].rho0 = rho;
 
                         // Initialize carrier phase
                         r_xyz = rho.range;
 
-                        computeRange(&rho, eph[sv], &ionoutc, grx, ref);
+                        computeRange(&rho, *eph[sv], &ionoutc, grx, ref);
                         r_ref = rho.range;
 
                         phase_ini = (2.0 * r_ref - r_xyz) / LAMBDA_L1;
@@ -2234,55 +1485,182 @@ static int allocateChannel(channel_t *chan, almanac_gps_t *alm, ephem_t *eph, io
     return (nsat);
 }
 
-static size_t fwrite_rinex(void *buffer, size_t size, size_t nmemb, void *stream) {
-    struct ftp_file *out = (struct ftp_file *) stream;
-    if (out && !out->stream) {
-        /* open file for writing */
-        out->stream = fopen(out->filename, "wb");
-        if (!out->stream)
-            return -1; /* failure, can't open file to write */
-    }
-    return fwrite(buffer, size, nmemb, out->stream);
+/*
+ * 
+ */
+static long elapsed_us(const struct timespec *t0) {
+    struct timespec t1;
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    return (t1.tv_sec - t0->tv_sec) * 1000000L + (t1.tv_nsec - t0->tv_nsec) / 1000L;
 }
 
-/* Read the list of user motions from the input file
- * xyz Output array of ECEF vectors for user motion
- * filename File name of the text input file
- * Returns number of user data motion records read, -1 on error
+/**
+ * Synthesis stage of the generator. Takes channel snapshots from the epoch
+ * queue, renders the baseband samples and fills the transfer fifo.
+ * The carrier phase is owned by this stage and only initialized from the
+ * snapshot when a channel got newly allocated.
  */
-static int readUserMotion(double xyz[USER_MOTION_SIZE][3], const char *filename) {
-    FILE *fp;
-    int numd;
-    char str[MAX_CHAR];
-    double t, x, y, z;
+static void *synth_thread_ep(void *arg) {
+    simulator_t *simulator = (simulator_t *) (arg);
+    static int ca[MAX_SAT][CA_SEQ_LEN];
+    const double delt = 1.0 / (double) TX_SAMPLERATE;
+#ifdef FLOAT_CARR_PHASE
+    double carr_phase[MAX_CHAN] = {0.0};
+#else
+    unsigned int carr_phase[MAX_CHAN] = {0};
+#endif
+    struct timespec t_start;
+    int i;
+    int ip, qp;
+    int iTable;
+    int isamp;
+    reframer_t rf;
+    const iq_format_desc_t *fmt = iq_format_desc(simulator->iq_format);
 
-    if (NULL == (fp = fopen(filename, "rt")))
-        return (-1);
+    // Keep synthesis apart from the observation stage and the sinks
+    thread_to_role(CORE_SYNTHESIS);
+    set_thread_name("synth-thread");
 
-    for (numd = 0; numd < USER_MOTION_SIZE; numd++) {
-        if (fgets(str, MAX_CHAR, fp) == NULL)
-            break;
+    // C/A codes of all satellites
+    for (i = 0; i < MAX_SAT; i++) {
+        codegen(ca[i], i + 1);
+    }
 
-        if (EOF == sscanf(str, "%lf,%lf,%lf,%lf", &t, &x, &y, &z)) // Read CSV line
+    // Create IQ buffer.
+    short *iq_buff = calloc(IQ_BUFFER_SIZE, 2);
+    if (iq_buff == NULL) {
+        gui_status_wprintw(RED, "Failed to allocate IQ buffer.\n");
+        goto end_synth_thread;
+    }
+
+    // Aquire first fifo block for transfer buffer
+    bool fifo_open = reframer_init(&rf, fmt);
+
+    for (;;) {
+        // Stop rendering on exit, queued epochs are dropped
+        if (simulator->gps_thread_exit) {
             break;
+        }
+        epoch_t *ep = epochq_read_acquire();
+        if (ep == NULL || !fifo_open) {
+            break;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &t_start);
+
+        for (i = 0; i < MAX_CHAN; i++) {
+            if (ep->chan[i].prn > 0 && ep->chan[i].fresh) {
+                carr_phase[i] = ep->chan[i].carr_phase;
+            }
+        }
 
-        xyz[numd][0] = x;
-        xyz[numd][1] = y;
-        xyz[numd][2] = z;
+        for (isamp = 0; isamp < NUM_IQ_SAMPLES; isamp++) {
+            int i_acc = 0.0f;
+            int q_acc = 0.0f;
+
+            for (i = 0; i < MAX_CHAN; i++) {
+                chan_epoch_t *ce = &ep->chan[i];
+                if (ce->prn > 0) {
+#ifdef FLOAT_CARR_PHASE
+                    // carr_phase 0.0 - 1.0          
+                    iTable = (int) floor(carr_phase[i] * 512.0);
+#else
+                    iTable = (carr_phase[i] >> 16) & 511; // 9-bit index
+#endif
+                    // dataBit -1 or 1
+                    // codeCA  -1 or 1
+                    ip = ce->dataBit * ce->codeCA * cosTable512[iTable] * ce->gain;
+                    qp = ce->dataBit * ce->codeCA * sinTable512[iTable] * ce->gain;
+
+                    // Accumulate for all visible satellites
+                    i_acc += ip;
+                    q_acc += qp;
+
+                    // Update code phase
+                    ce->code_phase += ce->f_code * delt;
+
+                    if (ce->code_phase >= CA_SEQ_LEN) {
+                        ce->code_phase -= CA_SEQ_LEN;
+
+                        ce->icode++;
+
+                        if (ce->icode >= 20) // 20 C/A codes = 1 navigation data bit
+                        {
+                            ce->icode = 0;
+                            ce->ibit++;
+
+                            if (ce->ibit >= 30) // 30 navigation data bits = 1 word
+                            {
+                                ce->ibit = 0;
+                                ce->iword++;
+                            }
+
+                            // Set new navigation data bit
+                            ce->dataBit = (int) ((ce->dwrd[ce->iword]>>(29 - ce->ibit)) & 0x1UL)*2 - 1;
+                        }
+                    }
+
+                    // Set current code chip
+                    ce->codeCA = ca[ce->prn - 1][(int) ce->code_phase]*2 - 1;
+
+                    // Update carrier phase
+#ifdef FLOAT_CARR_PHASE
+                    carr_phase[i] += ce->f_carr * delt;
+
+                    if (carr_phase[i] >= 1.0)
+                        carr_phase[i] -= 1.0;
+                    else if (carr_phase[i] < 0.0)
+                        carr_phase[i] += 1.0;
+#else
+                    carr_phase[i] += ce->carr_phasestep;
+#endif
+                }
+            }
+
+            // Store I/Q samples into buffer
+            iq_buff[isamp * 2] = (short) i_acc;
+            iq_buff[isamp * 2 + 1] = (short) q_acc;
+        }
+
+        // Snapshot is consumed, observation stage may reuse the slot
+        epochq_read_release();
+
+        // Convert straight into transfer fifo blocks in the output sample
+        // format. Blocks have the size the sink asked for, a partly filled
+        // block is kept for the next round.
+        size_t done = 0;
+        while (done < IQ_BUFFER_SIZE && fifo_open) {
+            size_t units;
+            void *dst = reframer_view(&rf, &units);
+            size_t n = iq_format_elements(fmt, units);
+            if (n > IQ_BUFFER_SIZE - done) {
+                n = IQ_BUFFER_SIZE - done;
+            }
+            fmt->convert(dst, iq_buff + done, n);
+            done += n;
+            fifo_open = reframer_commit(&rf, iq_format_units(fmt, n));
+        }
+
+        pipeline_synth_time(elapsed_us(&t_start));
     }
 
-    fclose(fp);
+    // Remaining samples of the last epoch
+    if (fifo_open && !simulator->gps_thread_exit) {
+        reframer_flush(&rf);
+    }
 
-    return (numd);
+end_synth_thread:
+    // Unblock the observation stage in case we stopped early
+    epochq_close(true);
+    free(iq_buff);
+    pthread_exit(NULL);
 }
 
-/*
- * 
- */
 void *gps_thread_ep(void *arg) {
     simulator_t *simulator = (simulator_t *) (arg);
 
-    ephem_t eph[EPHEM_ARRAY_SIZE][MAX_SAT];
+    ephstore_t store;
+    const ephem_t *eph[MAX_SAT]; // Ephemeris in use per SV
+    const ephem_t *efirst, *elast;
     channel_t chan[MAX_CHAN];
 
     datetime_t ttmp;
@@ -2295,13 +1673,15 @@ void *gps_thread_ep(void *arg) {
     date2gps(&simulator->start, &g0);
 
     double elvmask = 0.0; // in degree
+#ifndef FLOAT_CARR_PHASE
     const double delt = 1.0 / (double) TX_SAMPLERATE;
+#endif
     double llh[3];
-    double gain[MAX_CHAN];
     double path_loss;
     double ant_gain;
     double ant_pat[37];
     double dt;
+    double eph_shift = 0.0; // TOC/TOE shift of the time overwrite
 
     ionoutc_t ionoutc;
     ionoutc.enable = simulator->ionosphere_enable;
@@ -2312,22 +1692,19 @@ void *gps_thread_ep(void *arg) {
     int ibs; // boresight angle index    
     int igrx;
     int sv;
-    int neph, ieph;
+    int neph;
     int i;
-    int ip, qp;
-    int iTable;
-    int isamp;
-    short *iq_buff = NULL;
+    int prev_prn[MAX_CHAN];
+    bool chan_fresh[MAX_CHAN];
+    pthread_t synth_thread;
+    bool synth_started = false;
+    struct timespec t_start;
 
-    // Allocate user motion array
-    double (*xyz)[3] = malloc(sizeof (double[USER_MOTION_SIZE][3]));
-    if (xyz == NULL) {
-        gui_status_wprintw(RED, "Failed to allocate user motion memory.\n");
-        goto end_gps_thread;
-    }
+    ephstore_init(&store);
 
-    // Initialize user motion array
-    // with current location/position
+    // User position, moved by the motion file or interactively
+    double xyz[3];
+    motion_t *motion = NULL;
     int iumd = 0;
     int numd = simulator->duration;
     double tmat[3][3];
@@ -2337,7 +1714,7 @@ void *gps_thread_ep(void *arg) {
     llh[0] = simulator->location.lat / R2D;
     llh[1] = simulator->location.lon / R2D;
     llh[2] = simulator->location.height;
-    llh2xyz(llh, xyz[0]);
+    llh2xyz(llh, xyz);
     ltcmat(llh, tmat);
 
     if (!simulator->target.valid) {
@@ -2351,127 +1728,36 @@ void *gps_thread_ep(void *arg) {
         neu[0] = simulator->target.distance * cos((simulator->target.bearing / 1000) / R2D);
         neu[1] = simulator->target.distance * sin((simulator->target.bearing / 1000) / R2D);
         neu[2] = simulator->target.height;
-        xyz[0][0] += tmat[0][0] * neu[0] + tmat[1][0] * neu[1] + tmat[2][0] * neu[2];
-        xyz[0][1] += tmat[0][1] * neu[0] + tmat[1][1] * neu[1] + tmat[2][1] * neu[2];
-        xyz[0][2] += tmat[0][2] * neu[0] + tmat[1][2] * neu[1] + tmat[2][2] * neu[2];
-    }
-
-    for (iumd = 1; iumd < numd; iumd++) {
-        xyz[iumd][0] = xyz[0][0];
-        xyz[iumd][1] = xyz[0][1];
-        xyz[iumd][2] = xyz[0][2];
+        xyz[0] += tmat[0][0] * neu[0] + tmat[1][0] * neu[1] + tmat[2][0] * neu[2];
+        xyz[1] += tmat[0][1] * neu[0] + tmat[1][1] * neu[1] + tmat[2][1] * neu[2];
+        xyz[2] += tmat[0][2] * neu[0] + tmat[1][2] * neu[1] + tmat[2][2] * neu[2];
     }
 
     gui_show_location(&simulator->location);
 
-    CURL *curl;
-    CURLcode curl_code = CURLE_GOT_NOTHING;
-    struct ftp_file ftp = {
-        RINEX2_FILE_NAME,
-        NULL
-    };
+    prefetch_t pf;
 
     /* On a multi-core CPU we run the main thread and reader thread on different cores.
-     * Try sticking the main thread to core 2
+     * Try sticking the observation stage to its own core
      */
-    thread_to_core(2);
+    thread_to_role(CORE_OBSERVATION);
     set_thread_name("gps-thread");
 
-    if ((simulator->nav_file_name == NULL) && (simulator->use_ftp == false)) {
+    if ((simulator->nav_file_count == 0) && (simulator->use_ftp == false)) {
         gui_status_wprintw(RED, "GPS ephemeris file is not specified.\n");
         goto end_gps_thread;
     }
 
     ////////////////////////////////////////////////////////////
-    // Read ephemeris
+    // Read ephemeris and almanac
     ////////////////////////////////////////////////////////////
-    if (simulator->use_ftp) {
-        time_t t = time(NULL);
-        struct tm *tm = gmtime(&t);
-        char* url = malloc(NAME_MAX);
-        int station_index = 0;
-        // Use RINEX v2 by default or v3 on request
-        const stations_t *pstation = stations_v2;
-        if (simulator->use_rinex3) {
-            pstation = stations_v3;
-        }
-
-        // Get number of stations available, find index for given one
-        for (int s = 0; pstation[s].id_v2 != NULL; s++) {
-            // Station id given, get index
-            if (simulator->station_id != NULL) {
-                if (strncmp(pstation[s].id_v2, simulator->station_id, 4) == 0 || strncmp(pstation[s].id_v3, simulator->station_id, 9) == 0) {
-                    break;
-                }
-            }
-            station_index += 1;
-        }
-
-        // Pick a random station if none given
-        if (simulator->station_id == NULL) {
-            srand((unsigned int) g0.sec);
-            station_index = rand() % station_index;
-        }
-        // Check that we have a picked a valid station
-        // Take the first one when invalid
-        if (pstation[station_index].id_v2 == NULL) {
-            station_index = 0;
-        }
-
-        gui_status_wprintw(GREEN, "Pulling RINEX v%u from station: %s\n", (simulator->use_rinex3) ? 3 : 2, pstation[station_index].name);
-
-        // We fetch data from previous hour because the actual hour is still in progress
-        tm->tm_hour -= 1;
-        if (tm->tm_hour < 0) {
-            tm->tm_hour = 23;
-        }
-
-        // Compose FTP URL
-        snprintf(url, NAME_MAX, RINEX_FTP_URL RINEX_FTP_FILE, (simulator->use_rinex3) ? RINEX3_SUBFOLDER : RINEX2_SUBFOLDER,
-                tm->tm_yday + 1, tm->tm_hour, pstation[station_index].id_v2, tm->tm_yday + 1, 'a' + tm->tm_hour, tm->tm_year - 100);
-
-        curl_global_init(CURL_GLOBAL_DEFAULT);
-        curl = curl_easy_init();
-        if (curl) {
-            curl_easy_setopt(curl, CURLOPT_URL, url);
-            curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, fwrite_rinex);
-            curl_easy_setopt(curl, CURLOPT_WRITEDATA, &ftp);
-            curl_easy_setopt(curl, CURLOPT_USE_SSL, CURLUSESSL_NONE);
-            if (0 /*simulator->show_verbose*/) {
-                curl_easy_setopt(curl, CURLOPT_VERBOSE, 1L);
-            } else {
-                curl_easy_setopt(curl, CURLOPT_VERBOSE, 0L);
-            }
-            curl_easy_setopt(curl, CURLOPT_USERPWD, "anonymous:anonymous");
-            curl_code = curl_easy_perform(curl);
-            curl_easy_cleanup(curl);
-        }
-
-        if (ftp.stream)
-            fclose(ftp.stream);
-
-        free(url);
-        curl_global_cleanup();
-
-        if (curl_code != CURLE_OK) {
-            switch (curl_code) {
-                case CURLE_REMOTE_FILE_NOT_FOUND:
-                    gui_status_wprintw(RED, "Curl error: Ephemeris file not found!\n");
-                    break;
-                default:
-                    gui_status_wprintw(RED, "Curl error: %d\n", curl_code);
-                    break;
-            }
-            goto end_gps_thread;
-        }
-    }
-
-    if (simulator->use_rinex3) {
-        neph = readRinex3(eph, &ionoutc, simulator->nav_file_name);
-    } else {
-        neph = readRinex2(eph, &ionoutc, simulator->nav_file_name);
-    }
 
+    // Loads were started while the SDR initialized
+    prefetch_join(simulator, &pf);
+    store = pf.store;
+    ionoutc = pf.ionoutc;
+    strcpy(rinex_date, pf.date);
+    neph = pf.neph;
     if (neph == 0) {
         gui_status_wprintw(RED, "No ephemeris available.\n");
         goto end_gps_thread;
@@ -2491,52 +1777,33 @@ void *gps_thread_ep(void *arg) {
         }
     }
 
-    // Read user motion file if any
+    // Stream user motion file if any, the first point is the start position
     if (simulator->motion_file_name != NULL) {
-        numd = readUserMotion(xyz, simulator->motion_file_name);
-        if (numd <= 0) {
+        motion = motion_open(simulator->motion_file_name);
+        if (motion == NULL || !motion_position(motion, 0.0, xyz)) {
             gui_status_wprintw(RED, "Failed to read user motion file.\n");
             goto end_gps_thread;
         }
-        gui_status_wprintw(GREEN, "%u user motion points applied.\n", numd);
-        if (numd > simulator->duration) {
-            numd = simulator->duration;
-        }
     }
 
-    for (sv = 0; sv < MAX_SAT; sv++) {
-        if (eph[0][sv].vflg == true) {
-            gmin = eph[0][sv].toc;
-            tmin = eph[0][sv].t;
-            break;
-        }
+    // Steer by positions pushed from an external simulator
+    if (simulator->live_url != NULL && !livepos_start(simulator->live_url)) {
+        goto end_gps_thread;
     }
 
-    gmax.sec = 0;
-    gmax.week = 0;
-    tmax.sec = 0;
-    tmax.mm = 0;
-    tmax.hh = 0;
-    tmax.d = 0;
-    tmax.m = 0;
-    tmax.y = 0;
-    for (sv = 0; sv < MAX_SAT; sv++) {
-        if (eph[neph - 1][sv].vflg == true) {
-            gmax = eph[neph - 1][sv].toc;
-            tmax = eph[neph - 1][sv].t;
-            break;
-        }
-    }
+    ephstore_span(&store, &efirst, &elast);
+    gmin = efirst->toc;
+    tmin = efirst->t;
+    gmax = elast->toc;
+    tmax = elast->t;
 
     if (g0.week >= 0) // Scenario start time has been set.
     {
         if (simulator->time_overwrite == true) {
-            double dsec;
-
             gtmp.week = g0.week;
             gtmp.sec = (double) (((int) (g0.sec)) / 7200)*7200.0;
 
-            dsec = subGpsTime(gtmp, gmin);
+            eph_shift = subGpsTime(gtmp, gmin);
 
             // Overwrite the UTC reference week number
             ionoutc.wnt = gtmp.week;
@@ -2546,19 +1813,7 @@ void *gps_thread_ep(void *arg) {
             //ionoutc.vflg = FALSE;
 
             // Overwrite the TOC and TOE to the scenario start time
-            for (sv = 0; sv < MAX_SAT; sv++) {
-                for (i = 0; i < neph; i++) {
-                    if (eph[i][sv].vflg == true) {
-                        gtmp = incGpsTime(eph[i][sv].toc, dsec);
-                        gps2date(&gtmp, &ttmp);
-                        eph[i][sv].toc = gtmp;
-                        eph[i][sv].t = ttmp;
-
-                        gtmp = incGpsTime(eph[i][sv].toe, dsec);
-                        eph[i][sv].toe = gtmp;
-                    }
-                }
-            }
+            shiftEphemeris(&store, eph_shift);
         } else {
             if (subGpsTime(g0, gmin) < 0.0 || subGpsTime(gmax, g0) < 0.0) {
                 gui_status_wprintw(RED, "Invalid start time.\n");
@@ -2576,6 +1831,8 @@ void *gps_thread_ep(void *arg) {
         simulator->start = tmin;
     }
 
+    simulator->start_gps = g0;
+
     gui_mvwprintw(LS_FIX, 8, 40, "RINEX date:      %s", rinex_date);
     gui_mvwprintw(LS_FIX, 10, 40, "Start time:      %4d/%02d/%02d,%02d:%02d:%02.0f (%d:%.0f)",
             simulator->start.y, simulator->start.m, simulator->start.d, simulator->start.hh, simulator->start.mm, simulator->start.sec, g0.week, g0.sec);
@@ -2584,25 +1841,8 @@ void *gps_thread_ep(void *arg) {
     }
     gui_mvwprintw(LS_FIX, 7, 40, "Duration:        %.1fs", ((double) numd) / 10.0);
 
-    // Select the current set of ephemerides
-    ieph = -1;
-
-    for (i = 0; i < neph; i++) {
-        for (sv = 0; sv < MAX_SAT; sv++) {
-            if (eph[i][sv].vflg == true) {
-                dt = subGpsTime(g0, eph[i][sv].toc);
-                if (dt >= -SECONDS_IN_HOUR && dt < SECONDS_IN_HOUR) {
-                    ieph = i;
-                    break;
-                }
-            }
-        }
-
-        if (ieph >= 0) // ieph has been set
-            break;
-    }
-
-    if (ieph == -1) {
+    // Select the current ephemerides
+    if (selectEphemeris(&store, g0, eph) == 0) {
         gui_status_wprintw(RED, "No current set of ephemerides has been found.\n");
         goto end_gps_thread;
     }
@@ -2611,16 +1851,10 @@ void *gps_thread_ep(void *arg) {
     // Read almanac
     ////////////////////////////////////////////////////////////
 
-    almanac_gps_t *alm = almanac_init();
+    almanac_gps_t *alm = pf.alm;
     if (simulator->almanac_enable) {
-        if (simulator->use_ftp) {
-            curl_code = almanac_download();
-        } else {
-            curl_code = almanac_read_file();
-        }
-
-        if (curl_code != CURLE_OK) {
-            switch (curl_code) {
+        if (pf.alm_code != CURLE_OK) {
+            switch (pf.alm_code) {
                 case CURLE_REMOTE_FILE_NOT_FOUND:
                     gui_status_wprintw(RED, "Almanac file not found!\n");
                     break;
@@ -2628,7 +1862,7 @@ void *gps_thread_ep(void *arg) {
                     gui_status_wprintw(RED, "Error reading almanac file!\n");
                     break;
                 default:
-                    gui_status_wprintw(RED, "Almanac error, code: %d\n", curl_code);
+                    gui_status_wprintw(RED, "Almanac error, code: %d\n", pf.alm_code);
                     break;
             }
         }
@@ -2660,19 +1894,24 @@ void *gps_thread_ep(void *arg) {
     // Initialize channels
     ////////////////////////////////////////////////////////////
 
-    // Clear all channels
-    for (i = 0; i < MAX_CHAN; i++)
-        chan[i].prn = 0;
+    // Clear all channels, the almanac page index carries over between
+    // satellites of a channel and must start at zero
+    memset(chan, 0, sizeof (chan));
 
     // Clear satellite allocation flag
     for (sv = 0; sv < MAX_SAT; sv++)
         allocatedSat[sv] = -1;
 
+    // Reload navigation data when the inputs change during the run
+    if (simulator->nav_watch && !simulator->use_ftp && navwatch_start(simulator)) {
+        gui_status_wprintw(GREEN, "Watching nav inputs for updates.\n");
+    }
+
     // Initial reception time
     grx = incGpsTime(g0, 0.0);
 
     // Allocate visible satellites
-    allocateChannel(chan, alm, eph[ieph], ionoutc, grx, xyz[0], elvmask);
+    allocateChannel(chan, alm, eph, ionoutc, grx, xyz, elvmask);
 
     for (i = 0; i < MAX_CHAN; i++) {
         if (chan[i].prn > 0) {
@@ -2691,11 +1930,18 @@ void *gps_thread_ep(void *arg) {
     // Update receiver time
     grx = incGpsTime(grx, 0.1);
 
-    // Create IQ buffer.
-    iq_buff = calloc(IQ_BUFFER_SIZE, 2);
+    // Channels allocated so far get their carrier phase handed over to synthesis
+    for (i = 0; i < MAX_CHAN; i++) {
+        chan_fresh[i] = (chan[i].prn > 0);
+    }
 
-    // Aquire first fifo block for transfer buffer
-    struct iq_buf *iq = fifo_acquire();
+    // Start synthesis stage
+    epochq_init();
+    if (pthread_create(&synth_thread, NULL, synth_thread_ep, simulator) != 0) {
+        gui_status_wprintw(RED, "Failed to start synthesis thread.\n");
+        goto end_gps_thread;
+    }
+    synth_started = true;
 
     ////////////////////////////////////////////////////////////
     // Generate baseband signals
@@ -2705,46 +1951,62 @@ void *gps_thread_ep(void *arg) {
             break;
         }
 
+        // User motion resampled to the epoch, the run ends with the file
+        if (motion != NULL && !motion_position(motion, iumd / 10.0, xyz)) {
+            break;
+        }
+
         // Signal GPS init done and running
         if (simulator->gps_thread_running == false) {
             simulator->gps_thread_running = true;
             pthread_cond_signal(&(simulator->gps_init_done));
         }
 
-        if (simulator->interactive_mode) {
-            // Stay at the current location
-            xyz[iumd][0] = xyz[iumd - 1][0];
-            xyz[iumd][1] = xyz[iumd - 1][1];
-            xyz[iumd][2] = xyz[iumd - 1][2];
+        // Wait for a free epoch slot, synthesis stage may be behind
+        epoch_t *ep = epochq_write_acquire();
+        if (ep == NULL) {
+            break;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &t_start);
 
+        if (simulator->interactive_mode) {
             // Update the target location
             double dir = (simulator->target.bearing / 1000) / R2D;
             neu[0] = (simulator->target.velocity * cos(dir)) * 0.1;
             neu[1] = (simulator->target.velocity * sin(dir)) * 0.1;
             neu[2] = simulator->target.vertical_speed * 0.1;
 
-            xyz[iumd][0] += tmat[0][0] * neu[0] + tmat[1][0] * neu[1] + tmat[2][0] * neu[2];
-            xyz[iumd][1] += tmat[0][1] * neu[0] + tmat[1][1] * neu[1] + tmat[2][1] * neu[2];
-            xyz[iumd][2] += tmat[0][2] * neu[0] + tmat[1][2] * neu[1] + tmat[2][2] * neu[2];
+            xyz[0] += tmat[0][0] * neu[0] + tmat[1][0] * neu[1] + tmat[2][0] * neu[2];
+            xyz[1] += tmat[0][1] * neu[0] + tmat[1][1] * neu[1] + tmat[2][1] * neu[2];
+            xyz[2] += tmat[0][2] * neu[0] + tmat[1][2] * neu[1] + tmat[2][2] * neu[2];
         }
 
+        if (simulator->live_url != NULL) {
+            // Extrapolate to when the epoch goes on air, after the queued
+            // epochs, the FIFO and what the radio buffers
+            pipeline_stats_t pstats;
+            pipeline_get_stats(&pstats);
+            livepos_position(pstats.queued * 0.1 + (fifo_get_slack_ms() + sdr_get_delay_ms()) / 1000.0, xyz);
+        }
+
+        ep->grx = grx;
         for (i = 0; i < MAX_CHAN; i++) {
+            chan_epoch_t *ce = &ep->chan[i];
+            ce->prn = chan[i].prn;
             if (chan[i].prn > 0) {
                 // Refresh code phase and data bit counters
                 range_t rho;
                 sv = chan[i].prn - 1;
 
                 // Current pseudorange
-                computeRange(&rho, eph[ieph][sv], &ionoutc, grx, xyz[iumd]);
+                computeRange(&rho, *eph[sv], &ionoutc, grx, xyz);
 
                 chan[i].azel[0] = rho.azel[0];
                 chan[i].azel[1] = rho.azel[1];
 
                 // Update code phase and data bit counters
                 computeCodePhase(&chan[i], rho, 0.1);
-#ifndef FLOAT_CARR_PHASE
-                chan[i].carr_phasestep = (int) round(512.0 * 65536.0 * chan[i].f_carr * delt);
-#endif
+
                 // Path loss
                 path_loss = 20200000.0 / rho.d;
 
@@ -2753,123 +2015,42 @@ void *gps_thread_ep(void *arg) {
                 ant_gain = ant_pat[ibs];
 
                 // Signal gain
-                gain[i] = (double) (path_loss * ant_gain);
+                ce->gain = (double) (path_loss * ant_gain);
                 // Pluto SDR needs more signal strength due to 12 bit DAC range.
                 // Otherwise signal dynamic range is very low.
                 if (simulator->sdr_type == SDR_PLUTOSDR) {
                     // Will result in larger IQ values, hence higher signal amplitude.
                     // Best value to be defined.
-                    gain[i] *= 2;
+                    ce->gain *= 2;
                 }
-            }
-        }
-
-        for (isamp = 0; isamp < NUM_IQ_SAMPLES; isamp++) {
-            int i_acc = 0.0f;
-            int q_acc = 0.0f;
-
-            for (i = 0; i < MAX_CHAN; i++) {
-                if (chan[i].prn > 0) {
-#ifdef FLOAT_CARR_PHASE
-                    // carr_phase 0.0 - 1.0          
-                    iTable = (int) floor(chan[i].carr_phase * 512.0);
-#else
-                    iTable = (chan[i].carr_phase >> 16) & 511; // 9-bit index
-#endif
-                    // dataBit -1 or 1
-                    // codeCA  -1 or 1
-                    ip = chan[i].dataBit * chan[i].codeCA * cosTable512[iTable] * gain[i];
-                    qp = chan[i].dataBit * chan[i].codeCA * sinTable512[iTable] * gain[i];
-
-                    // Accumulate for all visible satellites
-                    i_acc += ip;
-                    q_acc += qp;
-
-                    // Update code phase
-                    chan[i].code_phase += chan[i].f_code * delt;
-
-                    if (chan[i].code_phase >= CA_SEQ_LEN) {
-                        chan[i].code_phase -= CA_SEQ_LEN;
-
-                        chan[i].icode++;
-
-                        if (chan[i].icode >= 20) // 20 C/A codes = 1 navigation data bit
-                        {
-                            chan[i].icode = 0;
-                            chan[i].ibit++;
-
-                            if (chan[i].ibit >= 30) // 30 navigation data bits = 1 word
-                            {
-                                chan[i].ibit = 0;
-                                chan[i].iword++;
-                                /*
-                                if (chan[i].iword>=N_DWRD)
-                                        fprintf(stderr, "\nWARNING: Subframe word buffer overflow.\n");
-                                 */
-                            }
-
-                            // Set new navigation data bit
-                            chan[i].dataBit = (int) ((chan[i].dwrd[chan[i].iword]>>(29 - chan[i].ibit)) & 0x1UL)*2 - 1;
-                        }
-                    }
 
-                    // Set current code chip
-                    chan[i].codeCA = chan[i].ca[(int) chan[i].code_phase]*2 - 1;
-
-                    // Update carrier phase
-#ifdef FLOAT_CARR_PHASE
-                    chan[i].carr_phase += chan[i].f_carr * delt;
-
-                    if (chan[i].carr_phase >= 1.0)
-                        chan[i].carr_phase -= 1.0;
-                    else if (chan[i].carr_phase < 0.0)
-                        chan[i].carr_phase += 1.0;
-#else
-                    chan[i].carr_phase += chan[i].carr_phasestep;
+                // Snapshot channel state for the synthesis stage
+                ce->fresh = chan_fresh[i];
+                chan_fresh[i] = false;
+                ce->f_carr = chan[i].f_carr;
+                ce->f_code = chan[i].f_code;
+                ce->carr_phase = chan[i].carr_phase;
+#ifndef FLOAT_CARR_PHASE
+                ce->carr_phasestep = (int) round(512.0 * 65536.0 * chan[i].f_carr * delt);
 #endif
-                }
+                ce->code_phase = chan[i].code_phase;
+                ce->iword = chan[i].iword;
+                ce->ibit = chan[i].ibit;
+                ce->icode = chan[i].icode;
+                ce->dataBit = chan[i].dataBit;
+                ce->codeCA = chan[i].codeCA;
+                memcpy(ce->dwrd, chan[i].dwrd, sizeof (ce->dwrd));
             }
-
-            // Store I/Q samples into buffer
-            iq_buff[isamp * 2] = (short) i_acc;
-            iq_buff[isamp * 2 + 1] = (short) q_acc;
         }
 
-        // Fill transfer fifo
-        for (isamp = 0; isamp < IQ_BUFFER_SIZE; isamp++) {
-            // validLength starts with 0 on aquire
-            if (simulator->sample_size == SC16) {
-                iq->data16[iq->validLength] = iq_buff[isamp];
-            } else {
-                iq->data8[iq->validLength] = iq_buff[isamp] >> 4;
-            }
-            iq->validLength += 1;
-            if (simulator->sdr_type == SDR_HACKRF) {
-                // Fill one fifo block until full
-                if (iq->validLength == HACKRF_TRANSFER_BUFFER_SIZE) {
-                    // Enqueue full fifo block
-                    fifo_enqueue(iq);
-                    // Get a new one and fill as long as we don't reach IQ_BUFFER_SIZE
-                    iq = fifo_acquire();
-                }
-                // We don't enque a partly filled fifo block but keep it for the next round
-            }
-        }
-
-        // File writer and Pluto SDR taking the entire IQ buffer at once.
-        if (simulator->sdr_type == SDR_IQFILE || simulator->sdr_type == SDR_PLUTOSDR) {
-            // Enqueue full fifo block
-            fifo_enqueue(iq);
-            // Get a new one
-            iq = fifo_acquire();
-        }
+        epochq_write_commit();
 
         //
         // Update navigation message and channel allocation every 30 seconds
         //
         igrx = (int) (grx.sec * 10.0 + 0.5);
 
-        xyz2llh(xyz[iumd], llh);
+        xyz2llh(xyz, llh);
         simulator->target.lat = llh[0] * R2D;
         simulator->target.lon = llh[1] * R2D;
         simulator->target.height = llh[2];
@@ -2884,35 +2065,63 @@ void *gps_thread_ep(void *arg) {
                 }
             }
 
-            // Refresh ephemeris and subframes
-            // Quick and dirty fix. Need more elegant way.
-            for (sv = 0; sv < MAX_SAT; sv++) {
-                if (eph[ieph + 1][sv].vflg == true) {
-                    dt = subGpsTime(eph[ieph + 1][sv].toc, grx);
-                    if (dt < SECONDS_IN_HOUR) {
-                        ieph++;
-                        if (ieph >= EPHEM_ARRAY_SIZE) {
-                            ieph = 0;
-                        }
+            // Swap in reloaded navigation data. The old store is only
+            // referenced by prev_eph and released once all SVs moved over.
+            ephstore_t *fresh = navwatch_take();
+            ephstore_t stale;
+            if (fresh != NULL) {
+                if (eph_shift != 0.0)
+                    shiftEphemeris(fresh, eph_shift);
+                stale = store;
+                store = *fresh;
+                free(fresh);
+            }
 
-                        for (i = 0; i < MAX_CHAN; i++) {
-                            // Generate new subframes if allocated
-                            if (chan[i].prn != 0)
-                                eph2sbf(eph[ieph][chan[i].prn - 1], ionoutc, alm, chan[i].sbf);
-                        }
-                    }
-                    break;
+            // Refresh ephemeris and subframes, each SV switches to the
+            // ephemeris with the nearest TOE on its own
+            const ephem_t *prev_eph[MAX_SAT];
+            memcpy(prev_eph, eph, sizeof (prev_eph));
+            selectEphemeris(&store, grx, eph);
+            for (sv = 0; sv < MAX_SAT; sv++) {
+                // Stay with the current ephemeris unless the new one is nearer
+                if (prev_eph[sv] == NULL || eph[sv] == NULL
+                        || fabs(subGpsTime(eph[sv]->toe, grx)) < fabs(subGpsTime(prev_eph[sv]->toe, grx)))
+                    continue;
+                if (fresh == NULL) {
+                    eph[sv] = prev_eph[sv];
+                } else {
+                    // The old store goes away, continue with the reloaded
+                    // record of the same TOE if there still is one
+                    const ephem_t *same = ephstore_find_toe(&store, sv + 1, prev_eph[sv]->toe);
+                    if (same != NULL)
+                        eph[sv] = same;
                 }
             }
+            for (i = 0; i < MAX_CHAN; i++) {
+                // Generate new subframes if allocated and the record changed
+                sv = chan[i].prn - 1;
+                if (chan[i].prn != 0 && eph[sv] != NULL && !sameEphemeris(eph[sv], prev_eph[sv]))
+                    eph2sbf(*eph[sv], ionoutc, alm, chan[i].sbf);
+            }
+            if (fresh != NULL)
+                ephstore_free(&stale);
 
             // Update channel allocation
-            allocateChannel(chan, alm, eph[ieph], ionoutc, grx, xyz[0], elvmask);
+            for (i = 0; i < MAX_CHAN; i++) {
+                prev_prn[i] = chan[i].prn;
+            }
+            allocateChannel(chan, alm, eph, ionoutc, grx, xyz, elvmask);
+            for (i = 0; i < MAX_CHAN; i++) {
+                if (chan[i].prn > 0 && chan[i].prn != prev_prn[i]) {
+                    chan_fresh[i] = true;
+                }
+            }
 
             if (simulator->show_verbose) {
                 gps2date(&grx, &simulator->start);
                 gui_mvwprintw(LS_FIX, 11, 57, "%4d/%02d/%02d,%02d:%02d:%02.0f (%d:%.0f)",
                         simulator->start.y, simulator->start.m, simulator->start.d, simulator->start.hh, simulator->start.mm, simulator->start.sec, grx.week, grx.sec);
-                gui_mvwprintw(LS_FIX, 5, 40, "xyz = %11.1f, %11.1f, %11.1f", xyz[iumd][0], xyz[iumd][1], xyz[iumd][2]);
+                gui_mvwprintw(LS_FIX, 5, 40, "xyz = %11.1f, %11.1f, %11.1f", xyz[0], xyz[1], xyz[2]);
                 gui_mvwprintw(LS_FIX, 6, 40, "llh = %11.6f, %11.6f, %11.1f", llh[0] * R2D, llh[1] * R2D, llh[2]);
                 start_y = 4;
                 for (i = 0; i < 33; i++) sat_simulated[i] = false;
@@ -2933,14 +2142,35 @@ void *gps_thread_ep(void *arg) {
 
         // Update time counter
         gui_mvwprintw(LS_FIX, 12, 40, "Elapsed:         %5.1fs", subGpsTime(grx, g0));
+
+        pipeline_obs_time(elapsed_us(&t_start));
     }
 
+    // Let synthesis drain the queued epochs unless we are told to stop
+    epochq_close(simulator->gps_thread_exit);
+    pthread_join(synth_thread, NULL);
+    synth_started = false;
+
+    if (motion != NULL) {
+        gui_status_wprintw(GREEN, "%zu user motion points read.\n", motion_count(motion));
+    }
+    if (simulator->live_url != NULL) {
+        livepos_stats_t lstats;
+        livepos_get_stats(&lstats);
+        gui_status_wprintw(GREEN, "%lu live positions, latency avg %.1fms max %.1fms.\n",
+                lstats.packets, lstats.latency_avg_us / 1000.0, lstats.latency_max_us / 1000.0);
+    }
     gui_status_wprintw(GREEN, "Simulation complete\n");
 
 end_gps_thread:
-    free(iq_buff);
-    if (xyz)
-        free(xyz);
+    if (synth_started) {
+        epochq_close(true);
+        pthread_join(synth_thread, NULL);
+    }
+    motion_close(motion);
+    livepos_stop();
+    navwatch_stop();
+    ephstore_free(&store);
     gui_status_wprintw(RED, "Exit GPS thread\n");
     simulator->gps_thread_exit = true;
     pthread_cond_signal(&(simulator->gps_init_done));
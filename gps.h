@@ -26,7 +26,7 @@
 #define RINEX3_SUBFOLDER "nrt_v3"
 #define RINEX_FTP_FILE "%s/%03i/%02i/%4s%03i%c.%02in.gz"
 
-/* Maximum length of a line in a text file (RINEX, motion) */
+/* Maximum length of a line in a RINEX text file */
 #define MAX_CHAR (100)
 
 /* Maximum number of satellites in RINEX file */
@@ -35,11 +35,11 @@
 /* Maximum number of channels we simulate */
 #define MAX_CHAN (12)
 
-/* Maximum number of user motion points */
+/* Number of 100ms epochs simulated when no duration is given */
 #ifndef REAL_TIME_GPS
-#define USER_MOTION_SIZE (3000) // max duration at 10Hz
+#define DEFAULT_DURATION (3000) // 5 minutes at 10Hz
 #else
-#define USER_MOTION_SIZE (864000) // for 24 hours at 10Hz
+#define DEFAULT_DURATION (864000) // 24 hours at 10Hz
 #endif
 
 /* Number of subframes */
@@ -105,8 +105,6 @@
 #define CODE_FREQ (1.023e6)
 #define CARR_TO_CODE (1.0/1540.0)
 
-#define EPHEM_ARRAY_SIZE (13) // for daily GPS broadcast ephemers file (brdc)
-
 /* GPS parity bit-vectors
  * The last 6 bits of a 30bit GPS word are parity check bits.
  * Each parity bit is computed from the XOR of a selection of bits from the
@@ -152,6 +150,7 @@ typedef struct {
 /* Structure representing ephemeris of a single satellite */
 typedef struct {
     int vflg; /* Valid Flag */
+    int prn; /* PRN number */
     int sva; /* SV accuracy (URA index) */
     int svh; /* SV health */
     int code; /* 0 or 1 code L2 (Codes on L2 channel) */
@@ -162,6 +161,7 @@ typedef struct {
     datetime_t t;
     gpstime_t toc; /* Time of Clock */
     gpstime_t toe; /* Time of Ephemeris */
+    gpstime_t tot; /* Transmission time of message */
     int iodc; /* Issue of Data, Clock */
     int iode; /* Isuse of Data, Ephemeris */
     double deltan; /* Delta-N (radians/sec) */
@@ -242,6 +242,13 @@ typedef struct {
     const char *name;
 } stations_t;
 
+extern const stations_t stations_v2[];
+extern const stations_t stations_v3[];
+
+void date2gps(const datetime_t *t, gpstime_t *g);
+void gps2date(const gpstime_t *g, datetime_t *t);
+void llh2xyz(const double *llh, double *xyz);
+void ltcmat(const double *llh, double t[3][3]);
 void *gps_thread_ep(void *arg);
 
 #endif /* GPS_H */
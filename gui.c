@@ -33,6 +33,7 @@ static WINDOW *window[13] = {NULL};
 static PANEL *panel[13] = {NULL};
 
 static pthread_mutex_t gui_lock; // Mutex to lock access during GUI updates
+static bool headless = false; // stdout is no terminal, status goes to stderr
 
 static void gui_update() {
     update_panels();
@@ -301,6 +302,11 @@ static void init_windows(void) {
 void gui_init(void) {
     char ch;
     pthread_mutex_init(&gui_lock, NULL);
+    // stdout may carry IQ data into a pipe, no curses then
+    if (!isatty(STDOUT_FILENO)) {
+        headless = true;
+        return;
+    }
     pthread_mutex_lock(&gui_lock);
     /* Initialize curses */
     initscr();
@@ -340,9 +346,16 @@ void gui_init(void) {
     pthread_mutex_unlock(&gui_lock);
 }
 
+bool gui_is_headless(void) {
+    return headless;
+}
+
 void gui_destroy(void) {
     pthread_mutex_unlock(&gui_lock); // Just in case
     pthread_mutex_destroy(&gui_lock);
+    if (headless) {
+        return;
+    }
     delwin(window[TRACK]);
     delwin(window[LS_FIX]);
     delwin(window[KF_FIX]);
@@ -359,9 +372,13 @@ void gui_destroy(void) {
 }
 
 void gui_mvwprintw(window_panel_t w, int y, int x, const char * fmt, ...) {
+    if (headless) {
+        return;
+    }
     pthread_mutex_lock(&gui_lock);
     va_list args;
     if (wmove(window[w], y, x) == ERR) {
+        pthread_mutex_unlock(&gui_lock);
         return;
     }
     va_start(args, fmt);
@@ -377,6 +394,12 @@ void gui_status_wprintw(status_color_t clr, const char * fmt, ...) {
     pthread_mutex_lock(&gui_lock);
     va_list args;
     va_start(args, fmt);
+    if (headless) {
+        vfprintf(stderr, fmt, args);
+        va_end(args);
+        pthread_mutex_unlock(&gui_lock);
+        return;
+    }
     if (clr > 0) {
         wattron(window[STATUS], COLOR_PAIR(clr));
     }
@@ -390,6 +413,9 @@ void gui_status_wprintw(status_color_t clr, const char * fmt, ...) {
 }
 
 void gui_colorpair(window_panel_t w, unsigned clr, attr_status_t onoff) {
+    if (headless) {
+        return;
+    }
     pthread_mutex_lock(&gui_lock);
     if (onoff == ON) {
         wattron(window[w], COLOR_PAIR(clr));
@@ -400,6 +426,11 @@ void gui_colorpair(window_panel_t w, unsigned clr, attr_status_t onoff) {
 }
 
 int gui_getch(void) {
+    if (headless) {
+        // Keep the pace of the curses input timeout
+        usleep(100000);
+        return -1;
+    }
     int ch = getch();
     /*
     if (ch != -1) {
@@ -410,6 +441,9 @@ int gui_getch(void) {
 }
 
 void gui_top_panel(window_panel_t p) {
+    if (headless) {
+        return;
+    }
     pthread_mutex_lock(&gui_lock);
     top_panel(panel[p]);
     panel[TOP] = panel[p];
@@ -421,6 +455,9 @@ void gui_top_panel(window_panel_t p) {
 }
 
 void gui_toggle_current_panel(void) {
+    if (headless) {
+        return;
+    }
     pthread_mutex_lock(&gui_lock);
     panel[TOP] = (PANEL *) panel_userptr(panel[TOP]);
     top_panel(panel[TOP]);
@@ -432,6 +469,9 @@ void gui_toggle_current_panel(void) {
 }
 
 void gui_show_panel(window_panel_t p, attr_status_t onoff) {
+    if (headless) {
+        return;
+    }
     pthread_mutex_lock(&gui_lock);
     if (onoff == ON) {
         show_panel(panel[p]);
@@ -443,30 +483,45 @@ void gui_show_panel(window_panel_t p, attr_status_t onoff) {
 }
 
 void gui_show_speed(float speed) {
+    if (headless) {
+        return;
+    }
     pthread_mutex_lock(&gui_lock);
     show_speed(speed);
     pthread_mutex_unlock(&gui_lock);
 }
 
 void gui_show_heading(float hdg) {
+    if (headless) {
+        return;
+    }
     pthread_mutex_lock(&gui_lock);
     show_heading(hdg);
     pthread_mutex_unlock(&gui_lock);
 }
 
 void gui_show_vertical_speed(float vs) {
+    if (headless) {
+        return;
+    }
     pthread_mutex_lock(&gui_lock);
     show_vertical_speed(vs);
     pthread_mutex_unlock(&gui_lock);
 }
 
 void gui_show_location(void *l) {
+    if (headless) {
+        return;
+    }
     pthread_mutex_lock(&gui_lock);
     show_local((location_t *) (l));
     pthread_mutex_unlock(&gui_lock);
 }
 
 void gui_show_target(void *t) {
+    if (headless) {
+        return;
+    }
     pthread_mutex_lock(&gui_lock);
     show_target((target_t *) (t));
     pthread_mutex_unlock(&gui_lock);
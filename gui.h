@@ -13,6 +13,8 @@
 #ifndef GUI_H
 #define GUI_H
 
+#include <stdbool.h>
+
 #define ROW_THRD 26
 #define COL_THRD 120
 #define HEAD_HEIGHT 13
@@ -62,6 +64,8 @@ typedef enum {
 } status_color_t;
 
 void gui_init(void);
+/* True if stdout is no terminal and the curses GUI is disabled. */
+bool gui_is_headless(void);
 int gui_getch(void);
 void gui_destroy(void);
 void gui_mvwprintw(window_panel_t w, int y, int x, const char * fmt, ...);
@@ -19,7 +19,7 @@ static error_t parse_opt(int key, char *arg, struct argp_state *state);
 
 static struct argp_option options[] = {
     {0, 0, 0, 0, "Options:", 1},
-    {"nav-file", 'e', "filename", 0, "RINEX navigation file for GPS ephemeris (required)", 1},
+    {"nav-file", 'e', "filename", 0, "RINEX navigation file, directory or glob pattern for GPS ephemeris, repeat to merge several (required)", 1},
     {"use-ftp", 'f', 0, 0, "Pull actual RINEX navigation file and almanac from online source", 1},
     {"geo-loc", 'l', "location", 0, "Latitude, Longitude, Height (static mode) e.g. 35.681298,139.766247,10.0", 1},
     {"start", 's', "date,time", 0, "Scenario start time YYYY/MM/DD,hh:mm:ss (use 'now' for actual time)", 1},
@@ -31,18 +31,38 @@ static struct argp_option options[] = {
     {"duration", 'd', "seconds", 0, "Duration in seconds", 1},
     {"target", 't', "distance,bearing,height", 0, "Target distance [m], bearing [°] and height [m]", 1},
     {"ppb", 'p', "ppb", 0, "Set oscillator error in ppb (default 0)", 1},
-    {"rinex3", '3', 0, 0, "Use RINEX v3 navigation data format", 1},
-    {"radio", 'r', "name", 0, "Set the SDR device type name (default none)", 1},
+    {"rinex3", '3', 0, 0, "Download RINEX v3 navigation data (nav file version is read from its header)", 1},
+    {"radio", 'r', "name[,name]", 0, "Set the SDR device type name (default none), further names record the same IQ stream e.g. hackrf,iqfile", 1},
     {"iq16", 700, 0, 0, "Set IQ sample size to 16 bit (default 8 bit)", 1},
     {"uri", 'U', "uri", 0, "ADLAM-Pluto URI", 1},
     {"network", 'N', "network", 0, "ADLAM-Pluto network IP or hostname (default pluto.local)", 1},
-    {"motion", 'm', "name", 0, "User motion file (dynamic mode)", 1},
+    {"pluto-buffers", 713, "count", 0, "ADLAM-Pluto number of kernel TX buffers (default 8)", 1},
+    {"pluto-buffer-size", 714, "samples", 0, "ADLAM-Pluto IQ samples per TX buffer (default 300000, 100ms)", 1},
+    {"underrun", 715, "fill", 0, "HackRF TX underrun fill, silence or repeat of the last block (default silence)", 1},
+    {"motion", 'm', "name", 0, "User motion file, text, gzip compressed text or binary trajectory (dynamic mode)", 1},
+    {"live", 719, "url", 0, "Receive live positions from a flight simulator, udp://host:port (default port 4951) or unix:///path", 1},
     {"disable-almanac", 702, 0, 0, "Disable transmission of almanac information", 1},
+    {"mirror", 717, "url", 0, "Base URL replacing the online RINEX and almanac source of --use-ftp, e.g. file:///srv/gnss", 1},
+    {"nav-watch", 718, 0, 0, "Reload nav files when they change, new data is used from the next 30s frame", 1},
+    {"no-nav-cache", 716, 0, 0, "Do not read or write the binary ephemeris cache <nav-file>.ephc", 1},
+    {"iq-format", 705, "format", 0, "IQ file sample format cs8, cs16, cf32 or cs4 (default cs8)", 1},
+    {"iq-file", 706, "name", 0, "IQ file name, a SigMF .sigmf-meta is written next to it (default iqdata.bin)", 1},
+    {"iq-archive", 707, "level", OPTION_ARG_OPTIONAL, "Write IQ file as seekable archive of zlib compressed 100ms chunks, level 0-9 (default 1)", 1},
+    {"iq-mmap", 704, 0, 0, "Render IQ file output directly into the memory mapped file (iqfile radio only)", 1},
+    {"replay", 708, "name", 0, "Transmit pre-rendered IQ file or IQ archive instead of generating the signal", 1},
+    {"replay-loop", 709, 0, 0, "Restart replay at the offset when the end of file is reached", 1},
+    {"replay-offset", 710, "seconds", 0, "Start replay at given offset into the file (default 0)", 1},
+    {"net", 711, "url", 0, "Destination of net radio, udp://host:port or tcp://host:port (default port 4950)", 1},
+    {"net-listen", 712, "url", 0, "Receive IQ stream from a remote net radio and transmit it, e.g. udp://0.0.0.0:4950", 1},
+    {"cores", 720, "list", 0, "Cores of main, observation, synthesis and sink threads, -1 for unpinned (default 1,2,3,4)", 1},
+    {"fifo-slack", 703, "ms", 0, "Adapt FIFO depth to keep given slack in milliseconds (default 0, fixed depth)", 1},
     {"station", 701, "id", 0, "Use station with given ID for RINEX FTP download (4 or 9 character ID)", 2},
     {0, 0, 0, OPTION_DOC, "Station is a GPS ground station around the world which provides RINEX hourly updated data. See gps.c for station details. A random station is picked if no ID is given", 2},
     {0, 0, 0, 0, "SDR device types (use with --radio or -r option):", 3},
     {0, 0, 0, OPTION_DOC, "   none", 3},
     {0, 0, 0, OPTION_DOC, "   iqfile", 3},
+    {0, 0, 0, OPTION_DOC, "   net", 3},
+    {0, 0, 0, OPTION_DOC, "   stdout", 3},
 #ifdef ENABLE_HACKRFSDR    
     {0, 0, 0, OPTION_DOC, "   hackrf", 3},
 #endif
@@ -0,0 +1,339 @@
+/**
+ * multi-sdr-gps-sim generates a IQ data stream on-the-fly to simulate a
+ * GPS L1 baseband signal using a SDR platform like HackRF or ADLAM-Pluto.
+ *
+ * This file is part of the Github project at
+ * https://github.com/mictronics/multi-sdr-gps-sim.git
+ *
+ * Copyright © 2021 Mictronics
+ * Distributed under the MIT License.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include "iowriter.h"
+
+/* Minimal io_uring, driven by raw system calls. */
+struct uring {
+    int fd;
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void *sq_ptr;
+    void *cq_ptr;
+    size_t sq_len;
+    size_t cq_len;
+    size_t sqes_len;
+};
+
+struct iowriter {
+    int fd; // Data file, opened with O_DIRECT if supported
+    int tail_fd; // Buffered descriptor for writes that can't be aligned
+    bool direct;
+    bool use_uring;
+    bool error;
+    struct uring ring;
+    unsigned char *buf[IOWRITER_DEPTH]; // Staging buffers
+    struct iovec iov[IOWRITER_DEPTH]; // Pending write of each buffer
+    uint64_t off[IOWRITER_DEPTH]; // File offset of each buffer
+    bool busy[IOWRITER_DEPTH]; // Write in flight
+    unsigned cur; // Buffer being filled
+    size_t fill; // Bytes in current buffer
+    uint64_t offset; // File offset of current buffer
+};
+
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params *p) {
+    return (int) syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return (int) syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static void uring_exit(struct uring *r) {
+    if (r->sqes != NULL && r->sqes != MAP_FAILED) munmap(r->sqes, r->sqes_len);
+    if (r->cq_ptr != NULL && r->cq_ptr != MAP_FAILED && r->cq_ptr != r->sq_ptr) munmap(r->cq_ptr, r->cq_len);
+    if (r->sq_ptr != NULL && r->sq_ptr != MAP_FAILED) munmap(r->sq_ptr, r->sq_len);
+    if (r->fd >= 0) close(r->fd);
+    memset(r, 0, sizeof (*r));
+    r->fd = -1;
+}
+
+static bool uring_init(struct uring *r, unsigned entries) {
+    struct io_uring_params p;
+
+    memset(r, 0, sizeof (*r));
+    memset(&p, 0, sizeof (p));
+    r->fd = sys_io_uring_setup(entries, &p);
+    if (r->fd < 0) {
+        // Not supported by kernel or blocked by seccomp
+        return false;
+    }
+
+    r->sq_len = p.sq_off.array + p.sq_entries * sizeof (unsigned);
+    r->cq_len = p.cq_off.cqes + p.cq_entries * sizeof (struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (r->cq_len > r->sq_len) r->sq_len = r->cq_len;
+        r->cq_len = r->sq_len;
+    }
+    r->sq_ptr = mmap(NULL, r->sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQ_RING);
+    if (r->sq_ptr == MAP_FAILED) {
+        uring_exit(r);
+        return false;
+    }
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        r->cq_ptr = r->sq_ptr;
+    } else {
+        r->cq_ptr = mmap(NULL, r->cq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_CQ_RING);
+        if (r->cq_ptr == MAP_FAILED) {
+            uring_exit(r);
+            return false;
+        }
+    }
+    r->sqes_len = p.sq_entries * sizeof (struct io_uring_sqe);
+    r->sqes = mmap(NULL, r->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES);
+    if (r->sqes == MAP_FAILED) {
+        uring_exit(r);
+        return false;
+    }
+
+    r->sq_head = (unsigned *) ((char *) r->sq_ptr + p.sq_off.head);
+    r->sq_tail = (unsigned *) ((char *) r->sq_ptr + p.sq_off.tail);
+    r->sq_mask = (unsigned *) ((char *) r->sq_ptr + p.sq_off.ring_mask);
+    r->sq_array = (unsigned *) ((char *) r->sq_ptr + p.sq_off.array);
+    r->cq_head = (unsigned *) ((char *) r->cq_ptr + p.cq_off.head);
+    r->cq_tail = (unsigned *) ((char *) r->cq_ptr + p.cq_off.tail);
+    r->cq_mask = (unsigned *) ((char *) r->cq_ptr + p.cq_off.ring_mask);
+    r->cqes = (struct io_uring_cqe *) ((char *) r->cq_ptr + p.cq_off.cqes);
+    return true;
+}
+
+// Finish a write the kernel did only partly, using the buffered descriptor.
+static bool write_rest(int fd, const unsigned char *data, size_t len, uint64_t off) {
+    while (len > 0) {
+        ssize_t n = pwrite(fd, data, len, (off_t) off);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += n;
+        len -= (size_t) n;
+        off += (uint64_t) n;
+    }
+    return true;
+}
+
+static void complete(struct iowriter *w, unsigned i, ssize_t res) {
+    if (res < 0) {
+        w->error = true;
+    } else if ((size_t) res < w->iov[i].iov_len) {
+        if (!write_rest(w->tail_fd, w->buf[i] + res, w->iov[i].iov_len - (size_t) res, w->off[i] + (uint64_t) res)) {
+            w->error = true;
+        }
+    }
+    w->busy[i] = false;
+}
+
+// Collect finished writes, block for at least one if wait is set. False
+// if the kernel can't be waited on, writes in flight then stay unknown.
+static bool reap(struct iowriter *w, bool wait) {
+    struct uring *r = &w->ring;
+    unsigned head = *r->cq_head;
+    bool ok = true;
+
+    if (wait && head == __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE)) {
+        if (sys_io_uring_enter(r->fd, 0, 1, IORING_ENTER_GETEVENTS) < 0
+                && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            w->error = true;
+            ok = false;
+        }
+    }
+    while (head != __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE)) {
+        struct io_uring_cqe *cqe = &r->cqes[head & *r->cq_mask];
+        complete(w, (unsigned) cqe->user_data, cqe->res);
+        head++;
+    }
+    __atomic_store_n(r->cq_head, head, __ATOMIC_RELEASE);
+    return ok;
+}
+
+static void submit(struct iowriter *w, unsigned i, size_t len) {
+    w->iov[i].iov_base = w->buf[i];
+    w->iov[i].iov_len = len;
+    w->off[i] = w->offset;
+    w->busy[i] = true;
+
+    if (!w->use_uring) {
+        ssize_t n;
+        do {
+            n = pwritev(w->fd, &w->iov[i], 1, (off_t) w->off[i]);
+        } while (n < 0 && errno == EINTR);
+        complete(w, i, n);
+        return;
+    }
+
+    struct uring *r = &w->ring;
+    unsigned tail = *r->sq_tail;
+    unsigned idx = tail & *r->sq_mask;
+    struct io_uring_sqe *sqe = &r->sqes[idx];
+
+    memset(sqe, 0, sizeof (*sqe));
+    sqe->opcode = IORING_OP_WRITEV;
+    sqe->fd = w->fd;
+    sqe->addr = (uint64_t) (uintptr_t) &w->iov[i];
+    sqe->len = 1;
+    sqe->off = w->off[i];
+    sqe->user_data = i;
+    r->sq_array[idx] = idx;
+    __atomic_store_n(r->sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+    int ret;
+    do {
+        ret = sys_io_uring_enter(r->fd, 1, 0, 0);
+    } while (ret < 0 && errno == EINTR);
+    if (ret < 0) {
+        complete(w, i, -errno);
+    }
+}
+
+struct iowriter *iowriter_open(const char *name, uint64_t prealloc) {
+    struct iowriter *w = calloc(1, sizeof (*w));
+    if (w == NULL) {
+        return NULL;
+    }
+    w->ring.fd = -1;
+    w->tail_fd = -1;
+
+    w->fd = open(name, O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+    if (w->fd >= 0) {
+        w->direct = true;
+        w->tail_fd = open(name, O_WRONLY);
+    } else if (errno == EINVAL) {
+        // File system without direct I/O support
+        w->fd = open(name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        w->tail_fd = w->fd;
+    }
+    if (w->fd < 0 || w->tail_fd < 0) {
+        goto error;
+    }
+
+    for (unsigned i = 0; i < IOWRITER_DEPTH; i++) {
+        w->buf[i] = aligned_alloc(IOWRITER_ALIGN, IOWRITER_CHUNK);
+        if (w->buf[i] == NULL) {
+            goto error;
+        }
+    }
+
+    // Reserve disk space up front, file is truncated to its real size on close.
+    if (prealloc > 0) {
+        (void) fallocate(w->fd, 0, 0, (off_t) prealloc);
+    }
+
+    w->use_uring = uring_init(&w->ring, IOWRITER_DEPTH);
+    return w;
+
+error:
+    iowriter_close(w);
+    return NULL;
+}
+
+bool iowriter_write(struct iowriter *w, const void *data, size_t len) {
+    const unsigned char *p = data;
+
+    while (len > 0) {
+        if (w->busy[w->cur]) {
+            return false; // Waiting for it failed, still owned by the kernel
+        }
+        size_t n = IOWRITER_CHUNK - w->fill;
+        if (n > len) n = len;
+        memcpy(w->buf[w->cur] + w->fill, p, n);
+        w->fill += n;
+        p += n;
+        len -= n;
+
+        if (w->fill == IOWRITER_CHUNK) {
+            submit(w, w->cur, IOWRITER_CHUNK);
+            w->offset += IOWRITER_CHUNK;
+            w->fill = 0;
+            w->cur = (w->cur + 1) % IOWRITER_DEPTH;
+            // Buffers are reused in order, wait until the next one is written,
+            // also after an error as callers keep writing
+            if (w->use_uring) {
+                reap(w, false);
+                while (w->busy[w->cur]) {
+                    if (!reap(w, true)) {
+                        return false;
+                    }
+                }
+            }
+        }
+    }
+    return !w->error;
+}
+
+bool iowriter_close(struct iowriter *w) {
+    bool ok;
+
+    if (w == NULL) {
+        return false;
+    }
+    // Every write in flight has to complete before its buffer is freed,
+    // a failed one doesn't stop the others
+    if (w->use_uring) {
+        for (unsigned i = 0; i < IOWRITER_DEPTH; i++) {
+            while (w->busy[i]) {
+                if (!reap(w, true)) {
+                    break;
+                }
+            }
+        }
+        uring_exit(&w->ring);
+    }
+    // Unaligned tail goes through the page cache
+    if (w->fill > 0 && w->tail_fd >= 0 && !w->busy[w->cur]) {
+        if (!write_rest(w->tail_fd, w->buf[w->cur], w->fill, w->offset)) {
+            w->error = true;
+        }
+        w->offset += w->fill;
+    }
+    if (w->fd >= 0 && ftruncate(w->fd, (off_t) w->offset) < 0) {
+        w->error = true;
+    }
+    ok = !w->error && w->fd >= 0;
+
+    if (w->tail_fd >= 0 && w->tail_fd != w->fd) close(w->tail_fd);
+    if (w->fd >= 0) close(w->fd);
+    for (unsigned i = 0; i < IOWRITER_DEPTH; i++) {
+        // Leaked if the kernel may still read it
+        if (!w->busy[i]) {
+            free(w->buf[i]);
+        }
+    }
+    free(w);
+    return ok;
+}
+
+uint64_t iowriter_size(const struct iowriter *w) {
+    return w->offset + w->fill;
+}
+
+const char *iowriter_mode(const struct iowriter *w) {
+    if (w->use_uring) {
+        return w->direct ? "io_uring, direct I/O" : "io_uring";
+    }
+    return w->direct ? "pwritev, direct I/O" : "pwritev";
+}
@@ -0,0 +1,37 @@
+/**
+ * multi-sdr-gps-sim generates a IQ data stream on-the-fly to simulate a
+ * GPS L1 baseband signal using a SDR platform like HackRF or ADLAM-Pluto.
+ *
+ * This file is part of the Github project at
+ * https://github.com/mictronics/multi-sdr-gps-sim.git
+ *
+ * Copyright © 2021 Mictronics
+ * Distributed under the MIT License.
+ *
+ */
+
+#ifndef IOWRITER_H
+#define IOWRITER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define IOWRITER_ALIGN (4096) // Direct I/O alignment of buffers, sizes and offsets
+#define IOWRITER_CHUNK (1024 * 1024) // Size of one staging buffer
+#define IOWRITER_DEPTH (4) // Staging buffers, at most DEPTH-1 writes in flight
+
+struct iowriter;
+
+/* Open file for sequential writing, preallocate given size if not 0. */
+struct iowriter *iowriter_open(const char *name, uint64_t prealloc);
+/* Copy data into staging buffers, full buffers are written asynchronously. */
+bool iowriter_write(struct iowriter *w, const void *data, size_t len);
+/* Write remaining data, wait for completion and truncate file to size. */
+bool iowriter_close(struct iowriter *w);
+/* Bytes handed to iowriter_write() so far. */
+uint64_t iowriter_size(const struct iowriter *w);
+/* Description of the I/O path in use. */
+const char *iowriter_mode(const struct iowriter *w);
+
+#endif /* IOWRITER_H */
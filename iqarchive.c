@@ -0,0 +1,372 @@
+/**
+ * multi-sdr-gps-sim generates a IQ data stream on-the-fly to simulate a
+ * GPS L1 baseband signal using a SDR platform like HackRF or ADLAM-Pluto.
+ *
+ * This file is part of the Github project at
+ * https://github.com/mictronics/multi-sdr-gps-sim.git
+ *
+ * Copyright © 2021 Mictronics
+ * Distributed under the MIT License.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <zlib.h>
+#include "gps-sim.h"
+#include "sdr.h"
+#include "iowriter.h"
+#include "iqarchive.h"
+
+enum slot_state {
+    SLOT_FREE = 0, SLOT_READY, SLOT_BUSY, SLOT_DONE
+};
+
+// One chunk on its way from the producer through compression to the file.
+struct slot {
+    unsigned char *raw; // Uncompressed data
+    size_t raw_len;
+    unsigned char *comp; // Compressed data
+    size_t comp_len;
+    uint32_t crc;
+    uint64_t seq; // Chunk number
+    enum slot_state state;
+    bool error; // Compression failed
+};
+
+static pthread_mutex_t archive_mutex = PTHREAD_MUTEX_INITIALIZER; // mutex protecting the slots
+static pthread_cond_t archive_work_cond = PTHREAD_COND_INITIALIZER; // condition used to signal chunk-ready
+static pthread_cond_t archive_done_cond = PTHREAD_COND_INITIALIZER; // condition used to signal chunk-compressed
+static struct slot slots[IQARCHIVE_SLOTS];
+static pthread_t workers[IQARCHIVE_MAX_WORKERS];
+static unsigned worker_count;
+static bool workers_stop;
+static int comp_level;
+static size_t chunk_bytes; // Uncompressed size of a full chunk
+static size_t comp_bound; // Worst case compressed size of a chunk
+static uint64_t fill_seq; // Chunk being filled by the producer
+static uint64_t write_seq; // Next chunk to be written to the file
+static uint64_t raw_total; // Uncompressed bytes accepted
+static struct iowriter *writer;
+static iqarchive_header_t header;
+static iqarchive_index_t *index_entries;
+static size_t index_size; // Allocated index entries
+static bool archive_error;
+
+static void *worker_thread_ep(void *arg) {
+    (void) arg; // Not used
+    set_thread_name("iqarchive-thread");
+
+    pthread_mutex_lock(&archive_mutex);
+    for (;;) {
+        // Oldest chunk waiting for compression
+        struct slot *s = NULL;
+        for (unsigned i = 0; i < IQARCHIVE_SLOTS; i++) {
+            if (slots[i].state == SLOT_READY && (s == NULL || slots[i].seq < s->seq)) {
+                s = &slots[i];
+            }
+        }
+        if (s == NULL) {
+            if (workers_stop) {
+                break;
+            }
+            pthread_cond_wait(&archive_work_cond, &archive_mutex);
+            continue;
+        }
+        s->state = SLOT_BUSY;
+        pthread_mutex_unlock(&archive_mutex);
+
+        uLongf len = (uLongf) comp_bound;
+        s->error = (compress2(s->comp, &len, s->raw, (uLong) s->raw_len, comp_level) != Z_OK);
+        s->comp_len = len;
+        s->crc = (uint32_t) crc32(crc32(0L, Z_NULL, 0), s->raw, (uInt) s->raw_len);
+
+        pthread_mutex_lock(&archive_mutex);
+        s->state = SLOT_DONE;
+        pthread_cond_broadcast(&archive_done_cond);
+    }
+    pthread_mutex_unlock(&archive_mutex);
+    return NULL;
+}
+
+// Write compressed chunks in order, as far as they are done. Called with mutex held.
+static void drain(void) {
+    for (;;) {
+        struct slot *s = &slots[write_seq % IQARCHIVE_SLOTS];
+        if (s->state != SLOT_DONE || s->seq != write_seq) {
+            return;
+        }
+        pthread_mutex_unlock(&archive_mutex);
+
+        if (write_seq >= index_size) {
+            size_t n = index_size ? index_size * 2 : 1024;
+            iqarchive_index_t *p = realloc(index_entries, n * sizeof (iqarchive_index_t));
+            if (p == NULL) {
+                archive_error = true;
+            } else {
+                index_entries = p;
+                index_size = n;
+            }
+        }
+        if (!archive_error && !s->error) {
+            iqarchive_index_t *e = &index_entries[write_seq];
+            e->offset = iowriter_size(writer);
+            e->comp_bytes = (uint32_t) s->comp_len;
+            e->raw_bytes = (uint32_t) s->raw_len;
+            e->crc = s->crc;
+            e->reserved = 0;
+            archive_error = !iowriter_write(writer, s->comp, s->comp_len);
+        } else {
+            archive_error = true;
+        }
+
+        pthread_mutex_lock(&archive_mutex);
+        s->raw_len = 0;
+        s->state = SLOT_FREE;
+        write_seq++;
+    }
+}
+
+// Hand the chunk being filled to the workers and make the next slot ready for filling.
+static void submit(void) {
+    pthread_mutex_lock(&archive_mutex);
+    struct slot *s = &slots[fill_seq % IQARCHIVE_SLOTS];
+    s->seq = fill_seq++;
+    s->state = SLOT_READY;
+    pthread_cond_signal(&archive_work_cond);
+
+    struct slot *next = &slots[fill_seq % IQARCHIVE_SLOTS];
+    for (;;) {
+        drain();
+        if (next->state == SLOT_FREE) {
+            break;
+        }
+        pthread_cond_wait(&archive_done_cond, &archive_mutex);
+    }
+    pthread_mutex_unlock(&archive_mutex);
+}
+
+bool iqarchive_open(const char *name, iq_format_t format, int level) {
+    const iq_format_desc_t *fmt = iq_format_desc(format);
+
+    chunk_bytes = iq_format_units(fmt, IQ_BUFFER_SIZE) * fmt->unit_size;
+    comp_bound = compressBound((uLong) chunk_bytes);
+    comp_level = level;
+    fill_seq = write_seq = raw_total = 0;
+    index_entries = NULL;
+    index_size = 0;
+    archive_error = false;
+    workers_stop = false;
+
+    for (unsigned i = 0; i < IQARCHIVE_SLOTS; i++) {
+        slots[i].raw = malloc(chunk_bytes);
+        slots[i].comp = malloc(comp_bound);
+        slots[i].raw_len = 0;
+        slots[i].state = SLOT_FREE;
+        if (slots[i].raw == NULL || slots[i].comp == NULL) {
+            goto error;
+        }
+    }
+
+    writer = iowriter_open(name, 0);
+    if (writer == NULL) {
+        goto error;
+    }
+    memcpy(header.magic, IQARCHIVE_MAGIC, sizeof (header.magic));
+    header.version = IQARCHIVE_VERSION;
+    header.format = (uint32_t) format;
+    header.sample_rate = TX_SAMPLERATE;
+    header.chunk_bytes = (uint32_t) chunk_bytes;
+    iowriter_write(writer, &header, sizeof (header));
+
+    // Leave one core to synthesis
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN) - 1;
+    worker_count = (cpus < 1) ? 1 : (cpus > IQARCHIVE_MAX_WORKERS) ? IQARCHIVE_MAX_WORKERS : (unsigned) cpus;
+    for (unsigned i = 0; i < worker_count; i++) {
+        if (pthread_create(&workers[i], NULL, worker_thread_ep, NULL) != 0) {
+            worker_count = i;
+            break;
+        }
+    }
+    if (worker_count == 0) {
+        iowriter_close(writer);
+        goto error;
+    }
+    return true;
+
+error:
+    for (unsigned i = 0; i < IQARCHIVE_SLOTS; i++) {
+        free(slots[i].raw);
+        free(slots[i].comp);
+        slots[i].raw = slots[i].comp = NULL;
+    }
+    return false;
+}
+
+bool iqarchive_write(const void *data, size_t len) {
+    const unsigned char *p = data;
+
+    while (len > 0) {
+        struct slot *s = &slots[fill_seq % IQARCHIVE_SLOTS];
+        size_t n = chunk_bytes - s->raw_len;
+        if (n > len) n = len;
+        memcpy(s->raw + s->raw_len, p, n);
+        s->raw_len += n;
+        raw_total += n;
+        p += n;
+        len -= n;
+        if (s->raw_len == chunk_bytes) {
+            submit();
+        }
+    }
+    return !archive_error;
+}
+
+bool iqarchive_close(gpstime_t start) {
+    if (slots[fill_seq % IQARCHIVE_SLOTS].raw_len > 0) {
+        submit();
+    }
+    // Wait for the last chunks
+    pthread_mutex_lock(&archive_mutex);
+    while (write_seq < fill_seq) {
+        drain();
+        if (write_seq < fill_seq) {
+            pthread_cond_wait(&archive_done_cond, &archive_mutex);
+        }
+    }
+    workers_stop = true;
+    pthread_cond_broadcast(&archive_work_cond);
+    pthread_mutex_unlock(&archive_mutex);
+    for (unsigned i = 0; i < worker_count; i++) {
+        pthread_join(workers[i], NULL);
+    }
+
+    iqarchive_trailer_t trailer;
+    memset(&trailer, 0, sizeof (trailer));
+    trailer.header = header;
+    trailer.chunk_count = write_seq;
+    trailer.index_offset = iowriter_size(writer);
+    trailer.start_week = start.week;
+    trailer.start_sec = start.sec;
+    if (write_seq > 0 && !archive_error) {
+        archive_error = !iowriter_write(writer, index_entries, write_seq * sizeof (iqarchive_index_t));
+    }
+    archive_error |= !iowriter_write(writer, &trailer, sizeof (trailer));
+    archive_error |= !iowriter_close(writer);
+    writer = NULL;
+
+    free(index_entries);
+    index_entries = NULL;
+    for (unsigned i = 0; i < IQARCHIVE_SLOTS; i++) {
+        free(slots[i].raw);
+        free(slots[i].comp);
+        slots[i].raw = slots[i].comp = NULL;
+    }
+    return !archive_error;
+}
+
+uint64_t iqarchive_size(void) {
+    return raw_total;
+}
+
+struct iqarchive_reader {
+    int fd;
+    iqarchive_trailer_t trailer;
+    iqarchive_index_t *index;
+    unsigned char *comp; // Read buffer for one compressed chunk
+    size_t comp_size;
+};
+
+struct iqarchive_reader *iqarchive_reader_open(const char *name) {
+    struct iqarchive_reader *r = calloc(1, sizeof (*r));
+    if (r == NULL) {
+        return NULL;
+    }
+    r->fd = open(name, O_RDONLY);
+    if (r->fd < 0) {
+        free(r);
+        return NULL;
+    }
+
+    off_t end = lseek(r->fd, 0, SEEK_END);
+    iqarchive_trailer_t *t = &r->trailer;
+    if (end < (off_t) (sizeof (iqarchive_header_t) + sizeof (*t))
+            || pread(r->fd, t, sizeof (*t), end - (off_t) sizeof (*t)) != (ssize_t) sizeof (*t)
+            || memcmp(t->header.magic, IQARCHIVE_MAGIC, sizeof (t->header.magic)) != 0
+            || t->header.version != IQARCHIVE_VERSION
+            || t->index_offset + t->chunk_count * sizeof (iqarchive_index_t) + sizeof (*t) != (uint64_t) end) {
+        goto error;
+    }
+
+    size_t index_len = t->chunk_count * sizeof (iqarchive_index_t);
+    r->index = malloc(index_len ? index_len : 1);
+    if (r->index == NULL || pread(r->fd, r->index, index_len, (off_t) t->index_offset) != (ssize_t) index_len) {
+        goto error;
+    }
+    for (uint64_t i = 0; i < t->chunk_count; i++) {
+        if (r->index[i].comp_bytes > r->comp_size) {
+            r->comp_size = r->index[i].comp_bytes;
+        }
+    }
+    r->comp = malloc(r->comp_size ? r->comp_size : 1);
+    if (r->comp == NULL) {
+        goto error;
+    }
+    return r;
+
+error:
+    iqarchive_reader_close(r);
+    return NULL;
+}
+
+void iqarchive_reader_info(const struct iqarchive_reader *r, iqarchive_info_t *info) {
+    info->format = (iq_format_t) r->trailer.header.format;
+    info->sample_rate = r->trailer.header.sample_rate;
+    info->chunk_bytes = r->trailer.header.chunk_bytes;
+    info->chunk_count = r->trailer.chunk_count;
+    info->start.week = r->trailer.start_week;
+    info->start.sec = r->trailer.start_sec;
+}
+
+int64_t iqarchive_chunk_at(const struct iqarchive_reader *r, gpstime_t t) {
+    if (r->trailer.start_week < 0) {
+        return -1;
+    }
+    double dt = (double) (t.week - r->trailer.start_week) * SECONDS_IN_WEEK + (t.sec - r->trailer.start_sec);
+    if (dt < 0.0) {
+        return -1;
+    }
+    uint64_t chunk = (uint64_t) (dt / IQARCHIVE_CHUNK_TIME + 1e-6);
+    return (chunk < r->trailer.chunk_count) ? (int64_t) chunk : -1;
+}
+
+ssize_t iqarchive_read_chunk(const struct iqarchive_reader *r, uint64_t chunk, void *buf, size_t size) {
+    if (chunk >= r->trailer.chunk_count) {
+        return -1;
+    }
+    const iqarchive_index_t *e = &r->index[chunk];
+    if (size < e->raw_bytes || pread(r->fd, r->comp, e->comp_bytes, (off_t) e->offset) != (ssize_t) e->comp_bytes) {
+        return -1;
+    }
+    uLongf len = (uLongf) size;
+    if (uncompress(buf, &len, r->comp, e->comp_bytes) != Z_OK || len != e->raw_bytes
+            || (uint32_t) crc32(crc32(0L, Z_NULL, 0), buf, (uInt) len) != e->crc) {
+        return -1;
+    }
+    return (ssize_t) len;
+}
+
+void iqarchive_reader_close(struct iqarchive_reader *r) {
+    if (r == NULL) {
+        return;
+    }
+    if (r->fd >= 0) {
+        close(r->fd);
+    }
+    free(r->index);
+    free(r->comp);
+    free(r);
+}
@@ -0,0 +1,95 @@
+/**
+ * multi-sdr-gps-sim generates a IQ data stream on-the-fly to simulate a
+ * GPS L1 baseband signal using a SDR platform like HackRF or ADLAM-Pluto.
+ *
+ * This file is part of the Github project at
+ * https://github.com/mictronics/multi-sdr-gps-sim.git
+ *
+ * Copyright © 2021 Mictronics
+ * Distributed under the MIT License.
+ *
+ */
+
+#ifndef IQARCHIVE_H
+#define IQARCHIVE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include "gps.h"
+#include "iqformat.h"
+
+/*
+ * IQ archive file layout, all values little endian:
+ *
+ *   header   iqarchive_header_t
+ *   chunk 0  zlib stream of 100 ms IQ data
+ *   ...
+ *   chunk n-1
+ *   index    iqarchive_index_t[n]
+ *   trailer  iqarchive_trailer_t, at the very end of the file
+ *
+ * Chunks are compressed independently, so any chunk can be decompressed
+ * on its own. The trailer points to the index.
+ */
+#define IQARCHIVE_MAGIC "GPSSIMIQ"
+#define IQARCHIVE_VERSION (1)
+#define IQARCHIVE_CHUNK_TIME (0.1) // Seconds of IQ data per chunk
+#define IQARCHIVE_SLOTS (8) // Chunks in compression at the same time
+#define IQARCHIVE_MAX_WORKERS (4) // Upper bound of compression threads
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t format; /* iq_format_t */
+    uint32_t sample_rate;
+    uint32_t chunk_bytes; /* Uncompressed size of a full chunk */
+} iqarchive_header_t;
+
+typedef struct {
+    uint64_t offset; /* File offset of the compressed chunk */
+    uint32_t comp_bytes; /* Compressed size */
+    uint32_t raw_bytes; /* Uncompressed size, less than chunk_bytes for the last chunk */
+    uint32_t crc; /* CRC-32 of the uncompressed data */
+    uint32_t reserved;
+} iqarchive_index_t;
+
+typedef struct {
+    iqarchive_header_t header;
+    uint64_t chunk_count;
+    uint64_t index_offset;
+    int32_t start_week; /* GPS time of the first sample, week -1 if unknown */
+    uint32_t reserved;
+    double start_sec;
+} iqarchive_trailer_t;
+
+/* Archive properties, see iqarchive_reader_info(). */
+typedef struct {
+    iq_format_t format;
+    unsigned sample_rate;
+    size_t chunk_bytes;
+    uint64_t chunk_count;
+    gpstime_t start;
+} iqarchive_info_t;
+
+/* Writer, one archive at a time. Level is the zlib compression level. */
+bool iqarchive_open(const char *name, iq_format_t format, int level);
+/* Append IQ data, full chunks are handed to the compression threads. */
+bool iqarchive_write(const void *data, size_t len);
+/* Flush the last chunk, write the index and close the file. */
+bool iqarchive_close(gpstime_t start);
+/* Bytes of uncompressed IQ data written so far. */
+uint64_t iqarchive_size(void);
+
+struct iqarchive_reader;
+
+struct iqarchive_reader *iqarchive_reader_open(const char *name);
+void iqarchive_reader_info(const struct iqarchive_reader *r, iqarchive_info_t *info);
+/* Index of the chunk holding the given GPS time, -1 if outside the archive. */
+int64_t iqarchive_chunk_at(const struct iqarchive_reader *r, gpstime_t t);
+/* Decompress one chunk into buf, returns its size or -1 on error. */
+ssize_t iqarchive_read_chunk(const struct iqarchive_reader *r, uint64_t chunk, void *buf, size_t size);
+void iqarchive_reader_close(struct iqarchive_reader *r);
+
+#endif /* IQARCHIVE_H */
@@ -0,0 +1,123 @@
+/**
+ * multi-sdr-gps-sim generates a IQ data stream on-the-fly to simulate a
+ * GPS L1 baseband signal using a SDR platform like HackRF or ADLAM-Pluto.
+ *
+ * This file is part of the Github project at
+ * https://github.com/mictronics/multi-sdr-gps-sim.git
+ *
+ * Copyright © 2021 Mictronics
+ * Distributed under the MIT License.
+ *
+ */
+
+#include <string.h>
+#include <stdint.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "iqformat.h"
+
+// Synthesis output uses 12 bit range, cs8 has always been taken as >> 4
+#define CF32_SCALE (1.0f / 2048.0f)
+
+static void convert_cs8(void *dst, const short *src, size_t count) {
+    signed char *out = dst;
+    size_t i = 0;
+#ifdef __SSE2__
+    // Keep the low byte of each shifted element, same wrap as the scalar cast
+    const __m128i mask = _mm_set1_epi16(0x00ff);
+    for (; i + 16 <= count; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *) (src + i));
+        __m128i b = _mm_loadu_si128((const __m128i *) (src + i + 8));
+        a = _mm_and_si128(_mm_srai_epi16(a, 4), mask);
+        b = _mm_and_si128(_mm_srai_epi16(b, 4), mask);
+        _mm_storeu_si128((__m128i *) (out + i), _mm_packus_epi16(a, b));
+    }
+#endif
+    for (; i < count; i++) {
+        out[i] = src[i] >> 4;
+    }
+}
+
+static void convert_cs16(void *dst, const short *src, size_t count) {
+    memcpy(dst, src, count * sizeof (short));
+}
+
+static void convert_cf32(void *dst, const short *src, size_t count) {
+    float *out = dst;
+    size_t i = 0;
+#ifdef __SSE2__
+    const __m128 scale = _mm_set1_ps(CF32_SCALE);
+    for (; i + 8 <= count; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i *) (src + i));
+        // Sign extend to 32 bit
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+        _mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+    }
+#endif
+    for (; i < count; i++) {
+        out[i] = (float) src[i] * CF32_SCALE;
+    }
+}
+
+static int clamp4(int v) {
+    v >>= 8;
+    return (v < -8) ? -8 : (v > 7) ? 7 : v;
+}
+
+// One byte per sample, I in the high nibble, Q in the low nibble.
+static void convert_cs4(void *dst, const short *src, size_t count) {
+    unsigned char *out = dst;
+    size_t i = 0;
+#ifdef __SSE2__
+    const __m128i vmin = _mm_set1_epi16(-8);
+    const __m128i vmax = _mm_set1_epi16(7);
+    const __m128i nibble = _mm_set1_epi32(0xf);
+    for (; i + 16 <= count; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *) (src + i));
+        __m128i b = _mm_loadu_si128((const __m128i *) (src + i + 8));
+        a = _mm_min_epi16(_mm_max_epi16(_mm_srai_epi16(a, 8), vmin), vmax);
+        b = _mm_min_epi16(_mm_max_epi16(_mm_srai_epi16(b, 8), vmin), vmax);
+        // Each 32 bit lane holds one I/Q pair, I in the low half
+        a = _mm_or_si128(_mm_slli_epi32(_mm_and_si128(a, nibble), 4), _mm_and_si128(_mm_srli_epi32(a, 16), nibble));
+        b = _mm_or_si128(_mm_slli_epi32(_mm_and_si128(b, nibble), 4), _mm_and_si128(_mm_srli_epi32(b, 16), nibble));
+        __m128i w = _mm_packs_epi32(a, b);
+        _mm_storel_epi64((__m128i *) (out + i / 2), _mm_packus_epi16(w, w));
+    }
+#endif
+    for (; i + 1 < count; i += 2) {
+        out[i / 2] = (unsigned char) (((clamp4(src[i]) & 0xf) << 4) | (clamp4(src[i + 1]) & 0xf));
+    }
+}
+
+static const iq_format_desc_t formats[] = {
+    [IQ_FORMAT_CS8] = {"cs8", "ci8", 8, 1, convert_cs8},
+    [IQ_FORMAT_CS16] = {"cs16", "ci16_le", 16, 2, convert_cs16},
+    [IQ_FORMAT_CF32] = {"cf32", "cf32_le", 32, 4, convert_cf32},
+    // SigMF has no 4 bit type, the bytes are declared as ru8 and the
+    // packing is given in the gps_sim extension of the metadata
+    [IQ_FORMAT_CS4] = {"cs4", "ru8", 4, 1, convert_cs4},
+};
+
+const iq_format_desc_t *iq_format_desc(iq_format_t format) {
+    return &formats[format];
+}
+
+int iq_format_by_name(const char *name) {
+    for (unsigned i = 0; i < sizeof (formats) / sizeof (formats[0]); i++) {
+        if (strcmp(formats[i].name, name) == 0) {
+            return (int) i;
+        }
+    }
+    return -1;
+}
+
+size_t iq_format_units(const iq_format_desc_t *fmt, size_t count) {
+    return count * fmt->bits / 8 / fmt->unit_size;
+}
+
+size_t iq_format_elements(const iq_format_desc_t *fmt, size_t units) {
+    return units * fmt->unit_size * 8 / fmt->bits;
+}
@@ -0,0 +1,42 @@
+/**
+ * multi-sdr-gps-sim generates a IQ data stream on-the-fly to simulate a
+ * GPS L1 baseband signal using a SDR platform like HackRF or ADLAM-Pluto.
+ *
+ * This file is part of the Github project at
+ * https://github.com/mictronics/multi-sdr-gps-sim.git
+ *
+ * Copyright © 2021 Mictronics
+ * Distributed under the MIT License.
+ *
+ */
+
+#ifndef IQFORMAT_H
+#define IQFORMAT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* IQ sample formats, interleaved I and Q elements */
+typedef enum {
+    IQ_FORMAT_CS8 = 0, IQ_FORMAT_CS16, IQ_FORMAT_CF32, IQ_FORMAT_CS4,
+    IQ_FORMAT_COUNT /* Number of formats, not a format */
+} iq_format_t;
+
+typedef struct {
+    const char *name; /* Name used on command line */
+    const char *sigmf_datatype; /* SigMF core:datatype */
+    unsigned bits; /* Bits per I or Q element */
+    unsigned unit_size; /* Bytes per FIFO sample unit */
+    /* Convert count I/Q elements from the 16 bit synthesis output */
+    void (*convert)(void *dst, const short *src, size_t count);
+} iq_format_desc_t;
+
+const iq_format_desc_t *iq_format_desc(iq_format_t format);
+/* Returns format for name or -1 if unknown. */
+int iq_format_by_name(const char *name);
+/* Number of FIFO sample units holding count I/Q elements. */
+size_t iq_format_units(const iq_format_desc_t *fmt, size_t count);
+/* Number of I/Q elements fitting into units FIFO sample units. */
+size_t iq_format_elements(const iq_format_desc_t *fmt, size_t units);
+
+#endif /* IQFORMAT_H */
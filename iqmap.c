@@ -0,0 +1,154 @@
+/**
+ * multi-sdr-gps-sim generates a IQ data stream on-the-fly to simulate a
+ * GPS L1 baseband signal using a SDR platform like HackRF or ADLAM-Pluto.
+ *
+ * This file is part of the Github project at
+ * https://github.com/mictronics/multi-sdr-gps-sim.git
+ *
+ * Copyright © 2021 Mictronics
+ * Distributed under the MIT License.
+ *
+ */
+
+#include <string.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "iqmap.h"
+
+struct window {
+    char *addr; // Mapped address
+    uint64_t start; // File offset of the mapping, page aligned
+    size_t len; // Length of the mapping
+    uint64_t used_end; // End of the last region handed out from this window
+};
+
+static pthread_mutex_t iqmap_mutex = PTHREAD_MUTEX_INITIALIZER; // mutex protecting the windows
+static int iqmap_fd = -1; // output file
+static uint64_t file_size; // current size of the output file
+static uint64_t reserve_off; // file offset of the next region handed to the producer
+static uint64_t commit_off; // file offset up to which the data is complete
+static struct window windows[IQMAP_MAX_WINDOWS]; // mapped windows, oldest first
+static unsigned window_count; // number of mapped windows
+static bool iqmap_error; // mapping or file extension failed
+
+static void window_unmap(struct window *w) {
+    msync(w->addr, w->len, MS_ASYNC);
+    munmap(w->addr, w->len);
+}
+
+// Make the file at least size bytes long, in large steps.
+static bool ensure_size(uint64_t size) {
+    if (size <= file_size) {
+        return true;
+    }
+    if (size < file_size + IQMAP_WINDOW) {
+        size = file_size + IQMAP_WINDOW;
+    }
+    // Allocate real blocks, a sparse file would fault in blocks one by one
+    if (fallocate(iqmap_fd, 0, 0, (off_t) size) != 0 && ftruncate(iqmap_fd, (off_t) size) != 0) {
+        return false;
+    }
+    file_size = size;
+    return true;
+}
+
+static struct window *window_map(size_t bytes) {
+    size_t page_size = (size_t) sysconf(_SC_PAGESIZE);
+    uint64_t start = reserve_off & ~((uint64_t) page_size - 1);
+    size_t len = IQMAP_WINDOW;
+
+    if (reserve_off + bytes - start > len) {
+        len = (size_t) (reserve_off + bytes - start + page_size - 1) & ~(page_size - 1);
+    }
+    if (window_count >= IQMAP_MAX_WINDOWS || !ensure_size(start + len)) {
+        return NULL;
+    }
+    void *addr = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, iqmap_fd, (off_t) start);
+    if (addr == MAP_FAILED) {
+        return NULL;
+    }
+    madvise(addr, len, MADV_SEQUENTIAL);
+
+    struct window *w = &windows[window_count++];
+    w->addr = addr;
+    w->start = start;
+    w->len = len;
+    w->used_end = start;
+    return w;
+}
+
+bool iqmap_open(const char *name, uint64_t size) {
+    iqmap_fd = open(name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (iqmap_fd < 0) {
+        return false;
+    }
+    file_size = 0;
+    reserve_off = 0;
+    commit_off = 0;
+    window_count = 0;
+    iqmap_error = false;
+    if (size > 0 && !ensure_size(size)) {
+        close(iqmap_fd);
+        iqmap_fd = -1;
+        return false;
+    }
+    return true;
+}
+
+void *iqmap_reserve(size_t bytes) {
+    char *result = NULL;
+
+    pthread_mutex_lock(&iqmap_mutex);
+    struct window *w = (window_count > 0) ? &windows[window_count - 1] : NULL;
+    if (w == NULL || reserve_off + bytes > w->start + w->len) {
+        // Next window starts at the current offset, may overlap the previous one by a page
+        w = window_map(bytes);
+    }
+    if (w != NULL) {
+        result = w->addr + (reserve_off - w->start);
+        reserve_off += bytes;
+        w->used_end = reserve_off;
+    } else {
+        iqmap_error = true;
+    }
+    pthread_mutex_unlock(&iqmap_mutex);
+    return result;
+}
+
+void iqmap_commit(size_t bytes) {
+    pthread_mutex_lock(&iqmap_mutex);
+    commit_off += bytes;
+    // Retire complete windows except the one still being filled
+    unsigned done = 0;
+    while (done + 1 < window_count && windows[done].used_end <= commit_off) {
+        window_unmap(&windows[done]);
+        done++;
+    }
+    if (done > 0) {
+        memmove(&windows[0], &windows[done], (window_count - done) * sizeof (struct window));
+        window_count -= done;
+    }
+    pthread_mutex_unlock(&iqmap_mutex);
+}
+
+bool iqmap_close(void) {
+    bool ok = !iqmap_error;
+
+    pthread_mutex_lock(&iqmap_mutex);
+    for (unsigned i = 0; i < window_count; i++) {
+        window_unmap(&windows[i]);
+    }
+    window_count = 0;
+    if (iqmap_fd >= 0) {
+        // Drop preallocated space not filled with data
+        if (ftruncate(iqmap_fd, (off_t) commit_off) != 0) {
+            ok = false;
+        }
+        close(iqmap_fd);
+        iqmap_fd = -1;
+    }
+    pthread_mutex_unlock(&iqmap_mutex);
+    return ok;
+}
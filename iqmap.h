@@ -0,0 +1,34 @@
+/**
+ * multi-sdr-gps-sim generates a IQ data stream on-the-fly to simulate a
+ * GPS L1 baseband signal using a SDR platform like HackRF or ADLAM-Pluto.
+ *
+ * This file is part of the Github project at
+ * https://github.com/mictronics/multi-sdr-gps-sim.git
+ *
+ * Copyright © 2021 Mictronics
+ * Distributed under the MIT License.
+ *
+ */
+
+#ifndef IQMAP_H
+#define IQMAP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define IQMAP_WINDOW (64 * 1024 * 1024) // Size of one mapped file window
+#define IQMAP_MAX_WINDOWS (8) // Windows mapped at the same time
+
+/* Create output file of given size and prepare it for mapping. */
+bool iqmap_open(const char *name, uint64_t size);
+/* Producer side, returns the next bytes of the file in a mapped window.
+ * Suits fifo_set_acquire_hook(). */
+void *iqmap_reserve(size_t bytes);
+/* Consumer side, the next bytes of the file are complete. Windows holding
+ * only complete data are flushed and unmapped. */
+void iqmap_commit(size_t bytes);
+/* Unmap all windows and truncate the file to the committed size. */
+bool iqmap_close(void);
+
+#endif /* IQMAP_H */
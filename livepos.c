@@ -0,0 +1,295 @@
+/**
+ * multi-sdr-gps-sim generates a IQ data stream on-the-fly to simulate a
+ * GPS L1 baseband signal using a SDR platform like HackRF or ADLAM-Pluto.
+ *
+ * This file is part of the Github project at
+ * https://github.com/mictronics/multi-sdr-gps-sim.git
+ *
+ * Copyright © 2021 Mictronics
+ * Distributed under the MIT License.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <poll.h>
+#include <time.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "gui.h"
+#include "gps-sim.h"
+#include "sdr_net.h"
+#include "livepos.h"
+
+#define MAILBOX_FRESH (4u) // Slot in the mailbox was not taken yet
+
+// Kinematic state in ECEF and when it arrived
+typedef struct {
+    double xyz[3];
+    double vel[3];
+    double acc[3];
+    struct timespec rx;
+} state_t;
+
+static int sock_fd = -1;
+static char *unix_path; // Socket file to remove on stop
+static pthread_t input_thread;
+static bool input_started;
+static atomic_bool input_exit;
+
+/* Single slot mailbox as triple buffer. The input thread fills its back
+ * slot and swaps it with the middle one, the GPS thread swaps its front
+ * slot with the middle one if that holds a fresh state. Neither side
+ * ever waits for the other. */
+static state_t slots[3];
+static atomic_uint middle;
+static unsigned back_slot; // Owned by the input thread
+static unsigned front_slot; // Owned by the GPS thread
+static bool have_state; // GPS thread took a state at least once
+static bool stale_warned;
+
+static atomic_ulong stat_packets;
+static atomic_ulong stat_lost;
+static atomic_ulong stat_dropped;
+static atomic_ulong stat_reordered;
+static atomic_ulong stat_restarts;
+static atomic_uint stat_latency_avg;
+static atomic_uint stat_latency_max;
+
+static double elapsed_s(const struct timespec *t0, const struct timespec *t1) {
+    return (double) (t1->tv_sec - t0->tv_sec) + (double) (t1->tv_nsec - t0->tv_nsec) / 1e9;
+}
+
+// Packet into ECEF state, rates of LLH packets are north, east and up
+static void to_state(const livepos_packet_t *pkt, state_t *st) {
+    memset(st, 0, sizeof (*st));
+    if (pkt->flags & LIVEPOS_LLH) {
+        double llh[3] = {pkt->pos[0] / R2D, pkt->pos[1] / R2D, pkt->pos[2]};
+        double t[3][3];
+        llh2xyz(llh, st->xyz);
+        ltcmat(llh, t);
+        for (int k = 0; k < 3; k++) {
+            if (pkt->flags & LIVEPOS_VEL) {
+                st->vel[k] = t[0][k] * pkt->vel[0] + t[1][k] * pkt->vel[1] + t[2][k] * pkt->vel[2];
+            }
+            if (pkt->flags & LIVEPOS_ACC) {
+                st->acc[k] = t[0][k] * pkt->acc[0] + t[1][k] * pkt->acc[1] + t[2][k] * pkt->acc[2];
+            }
+        }
+    } else {
+        memcpy(st->xyz, pkt->pos, sizeof (st->xyz));
+        if (pkt->flags & LIVEPOS_VEL) {
+            memcpy(st->vel, pkt->vel, sizeof (st->vel));
+        }
+        if (pkt->flags & LIVEPOS_ACC) {
+            memcpy(st->acc, pkt->acc, sizeof (st->acc));
+        }
+    }
+}
+
+static void *input_thread_ep(void *arg) {
+    (void) arg; // Not used
+    struct pollfd pfd = {sock_fd, POLLIN, 0};
+    union {
+        livepos_packet_t pkt;
+        char raw[sizeof (livepos_packet_t) + 1]; // Tells oversized datagrams apart
+    } buf;
+    uint64_t last_seq = 0;
+    struct timespec last_rx = {0, 0};
+    bool have_seq = false;
+
+    set_thread_name("livepos-thread");
+
+    while (!atomic_load(&input_exit)) {
+        if (poll(&pfd, 1, LIVEPOS_POLL_MS) <= 0) {
+            continue;
+        }
+        // Drain the socket, only the latest state is handed on
+        bool fresh = false;
+        for (;;) {
+            ssize_t n = recv(sock_fd, buf.raw, sizeof (buf.raw), MSG_DONTWAIT);
+            if (n < 0) {
+                break;
+            }
+            struct timespec rx;
+            clock_gettime(CLOCK_MONOTONIC, &rx);
+            if (n != (ssize_t) sizeof (livepos_packet_t) || buf.pkt.magic != LIVEPOS_MAGIC) {
+                atomic_fetch_add_explicit(&stat_dropped, 1, memory_order_relaxed);
+                continue;
+            }
+            // A sequence far behind the last one, or any step back after
+            // the sender was silent, comes from a restarted sender, follow
+            // it. A small step back is a reordered packet.
+            if (have_seq && buf.pkt.seq <= last_seq) {
+                if (last_seq - buf.pkt.seq < LIVEPOS_RESYNC && elapsed_s(&last_rx, &rx) < LIVEPOS_RESYNC_GAP) {
+                    atomic_fetch_add_explicit(&stat_reordered, 1, memory_order_relaxed);
+                    continue;
+                }
+                atomic_fetch_add_explicit(&stat_restarts, 1, memory_order_relaxed);
+                have_seq = false;
+            }
+            if (have_seq) {
+                atomic_fetch_add_explicit(&stat_lost, buf.pkt.seq - last_seq - 1, memory_order_relaxed);
+            }
+            last_seq = buf.pkt.seq;
+            last_rx = rx;
+            have_seq = true;
+            atomic_fetch_add_explicit(&stat_packets, 1, memory_order_relaxed);
+            to_state(&buf.pkt, &slots[back_slot]);
+            slots[back_slot].rx = rx;
+            fresh = true;
+        }
+        if (fresh) {
+            back_slot = atomic_exchange_explicit(&middle, back_slot | MAILBOX_FRESH, memory_order_acq_rel) & 3;
+        }
+    }
+    return NULL;
+}
+
+static int open_unix(const char *path) {
+    struct sockaddr_un addr;
+
+    if (strlen(path) >= sizeof (addr.sun_path)) {
+        return -1;
+    }
+    int fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    memset(&addr, 0, sizeof (addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    unlink(path); // Left over from an earlier run
+    if (bind(fd, (struct sockaddr *) &addr, sizeof (addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    unix_path = strdup(path);
+    return fd;
+}
+
+static int open_udp(const char *url) {
+    bool tcp;
+    int fd = -1;
+
+    struct addrinfo *res = net_resolve(url, LIVEPOS_DEFAULT_PORT, &tcp, true);
+    if (res == NULL || tcp) {
+        if (res != NULL) {
+            freeaddrinfo(res);
+        }
+        return -1;
+    }
+    for (struct addrinfo *ai = res; ai != NULL && fd < 0; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, ai->ai_protocol);
+        if (fd >= 0 && bind(fd, ai->ai_addr, ai->ai_addrlen) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(res);
+    return fd;
+}
+
+bool livepos_start(const char *url) {
+    if (strncmp(url, "unix://", 7) == 0) {
+        sock_fd = open_unix(url + 7);
+    } else {
+        sock_fd = open_udp(url);
+    }
+    if (sock_fd < 0) {
+        gui_status_wprintw(RED, "Unable to listen for live positions on %s.\n", url);
+        return false;
+    }
+
+    back_slot = 0;
+    atomic_store(&middle, 1);
+    front_slot = 2;
+    have_state = false;
+    stale_warned = false;
+    atomic_store_explicit(&stat_packets, 0, memory_order_relaxed);
+    atomic_store_explicit(&stat_lost, 0, memory_order_relaxed);
+    atomic_store_explicit(&stat_dropped, 0, memory_order_relaxed);
+    atomic_store_explicit(&stat_reordered, 0, memory_order_relaxed);
+    atomic_store_explicit(&stat_restarts, 0, memory_order_relaxed);
+    atomic_store_explicit(&stat_latency_avg, 0, memory_order_relaxed);
+    atomic_store_explicit(&stat_latency_max, 0, memory_order_relaxed);
+
+    atomic_store(&input_exit, false);
+    if (pthread_create(&input_thread, NULL, input_thread_ep, NULL) != 0) {
+        livepos_stop();
+        return false;
+    }
+    input_started = true;
+    gui_status_wprintw(GREEN, "Waiting for live positions on %s.\n", url);
+    return true;
+}
+
+void livepos_stop(void) {
+    if (input_started) {
+        atomic_store(&input_exit, true);
+        pthread_join(input_thread, NULL);
+        input_started = false;
+    }
+    if (sock_fd >= 0) {
+        close(sock_fd);
+        sock_fd = -1;
+    }
+    if (unix_path != NULL) {
+        unlink(unix_path);
+        free(unix_path);
+        unix_path = NULL;
+    }
+}
+
+bool livepos_position(double lead, double *xyz) {
+    if (atomic_load_explicit(&middle, memory_order_relaxed) & MAILBOX_FRESH) {
+        front_slot = atomic_exchange_explicit(&middle, front_slot, memory_order_acq_rel) & 3;
+        have_state = true;
+        stale_warned = false;
+    }
+    if (!have_state) {
+        return false;
+    }
+    const state_t *st = &slots[front_slot];
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double age = elapsed_s(&st->rx, &now);
+    double dt = age + lead;
+
+    // Age of the state when the epoch goes on air
+    unsigned us = (unsigned) (dt * 1e6);
+    unsigned a = atomic_load_explicit(&stat_latency_avg, memory_order_relaxed);
+    a = (a == 0) ? us : a + ((int) us - (int) a) / 8;
+    atomic_store_explicit(&stat_latency_avg, a, memory_order_relaxed);
+    if (us > atomic_load_explicit(&stat_latency_max, memory_order_relaxed)) {
+        atomic_store_explicit(&stat_latency_max, us, memory_order_relaxed);
+    }
+
+    if (age > LIVEPOS_MAX_EXTRAP && !stale_warned) {
+        gui_status_wprintw(YELLOW, "Live position input stale for %.1fs.\n", age);
+        stale_warned = true;
+    }
+    if (dt > LIVEPOS_MAX_EXTRAP) {
+        dt = LIVEPOS_MAX_EXTRAP;
+    }
+    for (int k = 0; k < 3; k++) {
+        xyz[k] = st->xyz[k] + dt * (st->vel[k] + 0.5 * dt * st->acc[k]);
+    }
+    return true;
+}
+
+void livepos_get_stats(livepos_stats_t *stats) {
+    stats->packets = atomic_load_explicit(&stat_packets, memory_order_relaxed);
+    stats->lost = atomic_load_explicit(&stat_lost, memory_order_relaxed);
+    stats->dropped = atomic_load_explicit(&stat_dropped, memory_order_relaxed);
+    stats->reordered = atomic_load_explicit(&stat_reordered, memory_order_relaxed);
+    stats->restarts = atomic_load_explicit(&stat_restarts, memory_order_relaxed);
+    stats->latency_avg_us = atomic_load_explicit(&stat_latency_avg, memory_order_relaxed);
+    stats->latency_max_us = atomic_load_explicit(&stat_latency_max, memory_order_relaxed);
+}
@@ -0,0 +1,67 @@
+/**
+ * multi-sdr-gps-sim generates a IQ data stream on-the-fly to simulate a
+ * GPS L1 baseband signal using a SDR platform like HackRF or ADLAM-Pluto.
+ *
+ * This file is part of the Github project at
+ * https://github.com/mictronics/multi-sdr-gps-sim.git
+ *
+ * Copyright © 2021 Mictronics
+ * Distributed under the MIT License.
+ *
+ */
+
+#ifndef LIVEPOS_H
+#define LIVEPOS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "gps-sim.h"
+
+#define LIVEPOS_MAGIC 0x4c535047 // "GPSL" little endian
+#define LIVEPOS_DEFAULT_PORT "4951"
+#define LIVEPOS_POLL_MS (200) // Exit check interval of the input thread
+#define LIVEPOS_MAX_EXTRAP (1.0) // Seconds a state is extrapolated at most
+#define LIVEPOS_RESYNC (1000) // Sequence step back taken as restart of the sender
+#define LIVEPOS_RESYNC_GAP (1.0) // Seconds of silence after which any step back is a restart
+
+/* Optional parts and frame of a packet */
+#define LIVEPOS_LLH (1u << 0) // Latitude, longitude in degrees, height, NEU rates
+#define LIVEPOS_VEL (1u << 1)
+#define LIVEPOS_ACC (1u << 2)
+
+/* One datagram of the live position input, native byte order. Positions
+ * are ECEF in meters, velocity in m/s and acceleration in m/s^2, or
+ * latitude, longitude and height with north, east and up rates with
+ * LIVEPOS_LLH. */
+typedef struct {
+    uint32_t magic;
+    uint32_t flags; /* LIVEPOS_* */
+    uint64_t seq; /* Sequence number, gaps are counted as lost */
+    double pos[3];
+    double vel[3]; /* Valid with LIVEPOS_VEL */
+    double acc[3]; /* Valid with LIVEPOS_ACC */
+} livepos_packet_t;
+
+/* Input counters and input to RF latency */
+typedef struct {
+    unsigned long packets; /* Packets accepted */
+    unsigned long lost; /* Packets missing in the sequence */
+    unsigned long dropped; /* Malformed packets */
+    unsigned long reordered; /* Packets behind the last one, dropped */
+    unsigned long restarts; /* Sender restarts, the sequence started over */
+    unsigned latency_avg_us; /* Smoothed age of the state when it goes on air */
+    unsigned latency_max_us;
+} livepos_stats_t;
+
+/* Receive positions on "udp://host:port" or "unix:///path" datagram
+ * sockets on a background thread. */
+bool livepos_start(const char *url);
+void livepos_stop(void);
+/* ECEF position of the latest received state extrapolated lead seconds
+ * past now, the time until the epoch goes on air. False until the first
+ * packet arrived. */
+bool livepos_position(double lead, double *xyz);
+/* Take a snapshot of the input counters, may be called from any thread. */
+void livepos_get_stats(livepos_stats_t *stats);
+
+#endif /* LIVEPOS_H */
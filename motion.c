@@ -0,0 +1,506 @@
+/**
+ * multi-sdr-gps-sim generates a IQ data stream on-the-fly to simulate a
+ * GPS L1 baseband signal using a SDR platform like HackRF or ADLAM-Pluto.
+ *
+ * This file is part of the Github project at
+ * https://github.com/mictronics/multi-sdr-gps-sim.git
+ *
+ * Copyright © 2021 Mictronics
+ * Distributed under the MIT License.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <zlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "gps.h"
+#include "gps-sim.h"
+#include "gui.h"
+#include "numscan.h"
+#include "motion.h"
+
+#define MOTION_BATCH (256) // Points handed to the ring under one lock
+#define MAX_COLUMNS (10) // t, position, velocity, acceleration
+
+struct motion {
+    int fd;
+    gzFile gz; // Compressed text file, NULL if plain
+    size_t taken; // points taken by the generator
+
+    // Binary trajectory
+    const unsigned char *map; // Memory mapped file, NULL for text files
+    size_t map_size;
+    motion_bin_header_t bin;
+    size_t values; // Values per record
+    size_t record_size;
+
+    // Text file reader
+    bool reader; // Reader thread running
+    pthread_t thread;
+    pthread_mutex_t mutex; // mutex protecting the ring
+    pthread_cond_t notempty_cond; // condition used to signal ring-not-empty
+    pthread_cond_t notfull_cond; // condition used to signal ring-not-full
+    motion_point_t ring[MOTION_RING_SIZE];
+    unsigned head; // index of the oldest point
+    unsigned count; // number of points in the ring
+    bool eof; // true if the reader added its last point
+    bool closed; // true if the generator is gone
+
+    // Resampling, points k-1, k, k+1 and k+2 around the segment k to k+1
+    motion_point_t win[4];
+    bool has[4];
+    bool started; // window primed
+    bool ended; // no more points, end of file or bad time
+    double t_first; // time of the first point
+    double t_last; // time of the last point taken
+    double coef[4][3]; // Hermite polynomial of the segment, NAN if stale
+};
+
+static inline bool is_number_start(char c) {
+    return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.';
+}
+
+// North, east and up vector into ECEF, t from ltcmat()
+static void neu2xyz(double t[3][3], const double *neu, double *xyz) {
+    for (int k = 0; k < 3; k++) {
+        xyz[k] = t[0][k] * neu[0] + t[1][k] * neu[1] + t[2][k] * neu[2];
+    }
+}
+
+/* Parse one "t,x,y,z[,vx,vy,vz[,ax,ay,az]]" line from p up to e
+ * Returns 1 for a point, 0 for a blank or header line, -1 if malformed
+ */
+static int parse_line(const char *p, const char *e, motion_point_t *point) {
+    double v[MAX_COLUMNS];
+    int n = 0;
+
+    while (p < e && (*p == ' ' || *p == '\t' || *p == '\r')) {
+        p++;
+    }
+    if (p == e || !is_number_start(*p)) {
+        return 0;
+    }
+    for (;;) {
+        const char *c = memchr(p, ',', (size_t) (e - p));
+        if (c == NULL) {
+            c = e;
+        }
+        if (n == MAX_COLUMNS) {
+            return -1;
+        }
+        v[n++] = numscan_double(p, (size_t) (c - p));
+        if (c == e) {
+            break;
+        }
+        p = c + 1;
+    }
+    if (n != 4 && n != 7 && n != 10) {
+        return -1;
+    }
+    point->t = v[0];
+    memcpy(point->xyz, &v[1], sizeof (point->xyz));
+    point->flags = 0;
+    if (n >= 7) {
+        memcpy(point->vel, &v[4], sizeof (point->vel));
+        point->flags |= MOTION_VEL;
+    }
+    if (n == 10) {
+        memcpy(point->acc, &v[7], sizeof (point->acc));
+        point->flags |= MOTION_ACC;
+    }
+    return 1;
+}
+
+// Hand parsed points to the generator, false if it is gone
+static bool push(motion_t *m, const motion_point_t *points, size_t n) {
+    pthread_mutex_lock(&m->mutex);
+    for (size_t i = 0; i < n && !m->closed; i++) {
+        while (!m->closed && m->count == MOTION_RING_SIZE) {
+            pthread_cond_signal(&m->notempty_cond);
+            pthread_cond_wait(&m->notfull_cond, &m->mutex);
+        }
+        if (!m->closed) {
+            m->ring[(m->head + m->count) % MOTION_RING_SIZE] = points[i];
+            m->count++;
+        }
+    }
+    bool open = !m->closed;
+    pthread_cond_signal(&m->notempty_cond);
+    pthread_mutex_unlock(&m->mutex);
+    return open;
+}
+
+static ssize_t read_chunk(motion_t *m, char *buf, size_t size) {
+    if (m->gz != NULL) {
+        return gzread(m->gz, buf, (unsigned) size);
+    }
+    ssize_t r;
+    do {
+        r = read(m->fd, buf, size);
+    } while (r < 0 && errno == EINTR);
+    return r;
+}
+
+static void *reader_thread_ep(void *arg) {
+    motion_t *m = (motion_t *) arg;
+    motion_point_t batch[MOTION_BATCH];
+    size_t nb = 0;
+    size_t len = 0; // Bytes of an unfinished line at the buffer start
+    size_t line = 0;
+    bool done = false;
+
+    set_thread_name("motion-thread");
+
+    char *buf = malloc(MOTION_CHUNK_SIZE);
+    if (buf == NULL) {
+        gui_status_wprintw(RED, "Failed to allocate user motion buffer.\n");
+        done = true;
+    }
+
+    while (!done) {
+        ssize_t r = read_chunk(m, buf + len, MOTION_CHUNK_SIZE - len);
+        if (r < 0) {
+            gui_status_wprintw(RED, "Failed to read user motion file.\n");
+            break;
+        }
+        if (r == 0) {
+            // Last line may come without line feed
+            if (len == 0) {
+                break;
+            }
+            buf[len++] = '\n';
+            done = true;
+        }
+        len += (size_t) r;
+
+        char *p = buf;
+        char *end = buf + len;
+        char *nl;
+        while ((nl = memchr(p, '\n', (size_t) (end - p))) != NULL) {
+            line++;
+            int result = parse_line(p, nl, &batch[nb]);
+            if (result < 0) {
+                gui_status_wprintw(RED, "User motion file line %zu malformed.\n", line);
+                done = true;
+                break;
+            }
+            nb += (size_t) result;
+            if (nb == MOTION_BATCH) {
+                done = !push(m, batch, nb);
+                nb = 0;
+                if (done) {
+                    break;
+                }
+            }
+            p = nl + 1;
+        }
+        len = (size_t) (end - p);
+        memmove(buf, p, len);
+        if (len == MOTION_CHUNK_SIZE) {
+            gui_status_wprintw(RED, "User motion file line %zu too long.\n", line + 1);
+            break;
+        }
+    }
+    push(m, batch, nb);
+    free(buf);
+
+    pthread_mutex_lock(&m->mutex);
+    m->eof = true;
+    pthread_cond_signal(&m->notempty_cond);
+    pthread_mutex_unlock(&m->mutex);
+    return NULL;
+}
+
+static bool open_binary(motion_t *m, const char *filename) {
+    struct stat st;
+
+    if (fstat(m->fd, &st) != 0 || (size_t) st.st_size < sizeof (motion_bin_header_t)
+            || pread(m->fd, &m->bin, sizeof (m->bin), 0) != (ssize_t) sizeof (m->bin)) {
+        return false;
+    }
+    m->values = 3;
+    m->values += (m->bin.flags & MOTION_BIN_VEL) ? 3 : 0;
+    m->values += (m->bin.flags & MOTION_BIN_ACC) ? 3 : 0;
+    m->record_size = m->values * ((m->bin.flags & MOTION_BIN_FLOAT) ? sizeof (float) : sizeof (double));
+
+    size_t size = (size_t) st.st_size;
+    size_t records = (size - sizeof (motion_bin_header_t)) / m->record_size;
+    if (m->bin.version != MOTION_BIN_VERSION
+            || (m->bin.flags & ~(MOTION_BIN_LLH | MOTION_BIN_FLOAT | MOTION_BIN_VEL | MOTION_BIN_ACC)) != 0
+            || !isfinite(m->bin.rate) || m->bin.rate <= 0.0 || !isfinite(m->bin.epoch)
+            || m->bin.count > records) {
+        gui_status_wprintw(RED, "User motion file %s: invalid trajectory header.\n", filename);
+        return false;
+    }
+
+    m->map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, m->fd, 0);
+    if (m->map == MAP_FAILED) {
+        m->map = NULL;
+        return false;
+    }
+    m->map_size = size;
+    madvise((void *) m->map, size, MADV_SEQUENTIAL);
+    return true;
+}
+
+// Decode record i of a binary trajectory
+static void binary_point(const motion_t *m, uint64_t i, motion_point_t *point) {
+    const unsigned char *rec = m->map + sizeof (motion_bin_header_t) + i * m->record_size;
+    double v[9];
+
+    if (m->bin.flags & MOTION_BIN_FLOAT) {
+        float f[9];
+        memcpy(f, rec, m->record_size);
+        for (size_t k = 0; k < m->values; k++) {
+            v[k] = f[k];
+        }
+    } else {
+        memcpy(v, rec, m->record_size);
+    }
+
+    point->t = m->bin.epoch + (double) i / m->bin.rate;
+    point->flags = 0;
+    const double *vel = &v[3];
+    const double *acc = (m->bin.flags & MOTION_BIN_VEL) ? &v[6] : &v[3];
+
+    if (m->bin.flags & MOTION_BIN_LLH) {
+        double llh[3] = {v[0] / R2D, v[1] / R2D, v[2]};
+        double tmat[3][3];
+        llh2xyz(llh, point->xyz);
+        ltcmat(llh, tmat);
+        if (m->bin.flags & MOTION_BIN_VEL) {
+            neu2xyz(tmat, vel, point->vel);
+        }
+        if (m->bin.flags & MOTION_BIN_ACC) {
+            neu2xyz(tmat, acc, point->acc);
+        }
+    } else {
+        memcpy(point->xyz, v, sizeof (point->xyz));
+        if (m->bin.flags & MOTION_BIN_VEL) {
+            memcpy(point->vel, vel, sizeof (point->vel));
+        }
+        if (m->bin.flags & MOTION_BIN_ACC) {
+            memcpy(point->acc, acc, sizeof (point->acc));
+        }
+    }
+    if (m->bin.flags & MOTION_BIN_VEL) {
+        point->flags |= MOTION_VEL;
+    }
+    if (m->bin.flags & MOTION_BIN_ACC) {
+        point->flags |= MOTION_ACC;
+    }
+}
+
+static bool start_reader(motion_t *m) {
+    unsigned char magic[2];
+
+    if (pread(m->fd, magic, sizeof (magic), 0) == (ssize_t) sizeof (magic)
+            && magic[0] == 0x1f && magic[1] == 0x8b) {
+        m->gz = gzdopen(m->fd, "rb");
+        if (m->gz == NULL) {
+            return false;
+        }
+        m->fd = -1; // Closed by gzclose()
+        gzbuffer(m->gz, MOTION_CHUNK_SIZE);
+    } else {
+        posix_fadvise(m->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+
+    pthread_mutex_init(&m->mutex, NULL);
+    pthread_cond_init(&m->notempty_cond, NULL);
+    pthread_cond_init(&m->notfull_cond, NULL);
+    if (pthread_create(&m->thread, NULL, reader_thread_ep, m) != 0) {
+        pthread_cond_destroy(&m->notfull_cond);
+        pthread_cond_destroy(&m->notempty_cond);
+        pthread_mutex_destroy(&m->mutex);
+        return false;
+    }
+    m->reader = true;
+    return true;
+}
+
+motion_t *motion_open(const char *filename) {
+    char magic[sizeof (MOTION_BIN_MAGIC) - 1];
+
+    motion_t *m = calloc(1, sizeof (motion_t));
+    if (m == NULL) {
+        return NULL;
+    }
+    m->fd = open(filename, O_RDONLY | O_CLOEXEC);
+    if (m->fd < 0) {
+        free(m);
+        return NULL;
+    }
+
+    bool ok;
+    if (pread(m->fd, magic, sizeof (magic), 0) == (ssize_t) sizeof (magic)
+            && memcmp(magic, MOTION_BIN_MAGIC, sizeof (magic)) == 0) {
+        ok = open_binary(m, filename);
+    } else {
+        ok = start_reader(m);
+    }
+    if (!ok) {
+        motion_close(m);
+        return NULL;
+    }
+    return m;
+}
+
+static bool next_point(motion_t *m, motion_point_t *point) {
+    if (m->map != NULL) {
+        if (m->taken >= m->bin.count) {
+            return false;
+        }
+        binary_point(m, m->taken++, point);
+        return true;
+    }
+
+    pthread_mutex_lock(&m->mutex);
+    while (!m->eof && m->count == 0) {
+        pthread_cond_wait(&m->notempty_cond, &m->mutex);
+    }
+    bool result = (m->count > 0);
+    if (result) {
+        *point = m->ring[m->head];
+        m->head = (m->head + 1) % MOTION_RING_SIZE;
+        m->count--;
+        pthread_cond_signal(&m->notfull_cond);
+        m->taken++;
+    }
+    pthread_mutex_unlock(&m->mutex);
+    return result;
+}
+
+// Next point with a later time than the last one
+static bool take_point(motion_t *m, motion_point_t *point) {
+    if (m->ended || !next_point(m, point)) {
+        m->ended = true;
+        return false;
+    }
+    if (m->taken > 1 && !(point->t > m->t_last)) {
+        gui_status_wprintw(RED, "User motion point %zu time %.3f not after %.3f.\n", m->taken, point->t, m->t_last);
+        m->ended = true;
+        return false;
+    }
+    m->t_last = point->t;
+    return true;
+}
+
+// Move the window one point ahead
+static void shift_window(motion_t *m) {
+    memmove(&m->win[0], &m->win[1], 3 * sizeof (m->win[0]));
+    memmove(&m->has[0], &m->has[1], 3 * sizeof (m->has[0]));
+    m->has[3] = m->has[2] && take_point(m, &m->win[3]);
+    m->coef[0][0] = NAN;
+}
+
+/* Tangent at window point k in m/s, the point's velocity if it has one.
+ * Otherwise the slope between its neighbours, one sided at the ends. */
+static void tangent(const motion_t *m, int k, double *v) {
+    const motion_point_t *w = m->win;
+
+    if (w[k].flags & MOTION_VEL) {
+        memcpy(v, w[k].vel, 3 * sizeof (double));
+        return;
+    }
+    int a = m->has[k - 1] ? k - 1 : k;
+    int b = m->has[k + 1] ? k + 1 : k;
+    for (int i = 0; i < 3; i++) {
+        v[i] = (w[b].xyz[i] - w[a].xyz[i]) / (w[b].t - w[a].t);
+    }
+}
+
+// Cubic Hermite polynomial in s = 0..1 between window points 1 and 2
+static void segment_coef(motion_t *m) {
+    const double *p0 = m->win[1].xyz;
+    const double *p1 = m->win[2].xyz;
+    double h = m->win[2].t - m->win[1].t;
+    double m0[3], m1[3];
+
+    tangent(m, 1, m0);
+    tangent(m, 2, m1);
+    for (int i = 0; i < 3; i++) {
+        m->coef[0][i] = p0[i];
+        m->coef[1][i] = h * m0[i];
+        m->coef[2][i] = 3.0 * (p1[i] - p0[i]) - h * (2.0 * m0[i] + m1[i]);
+        m->coef[3][i] = 2.0 * (p0[i] - p1[i]) + h * (m0[i] + m1[i]);
+    }
+}
+
+bool motion_position(motion_t *m, double t, double *xyz) {
+    if (!m->started) {
+        m->started = true;
+        m->has[0] = false;
+        m->has[1] = take_point(m, &m->win[1]);
+        m->has[2] = m->has[1] && take_point(m, &m->win[2]);
+        m->has[3] = m->has[2] && take_point(m, &m->win[3]);
+        m->t_first = m->win[1].t;
+        m->coef[0][0] = NAN;
+    }
+    if (!m->has[1]) {
+        return false;
+    }
+    t += m->t_first;
+
+    while (m->has[2] && m->win[2].t < t) {
+        shift_window(m);
+    }
+    if (t == m->win[1].t) {
+        memcpy(xyz, m->win[1].xyz, 3 * sizeof (double));
+        return true;
+    }
+    if (!m->has[2] || t > m->win[2].t) {
+        return false;
+    }
+    if (t == m->win[2].t) {
+        memcpy(xyz, m->win[2].xyz, 3 * sizeof (double));
+        return true;
+    }
+
+    if (isnan(m->coef[0][0])) {
+        segment_coef(m);
+    }
+    double s = (t - m->win[1].t) / (m->win[2].t - m->win[1].t);
+    for (int i = 0; i < 3; i++) {
+        xyz[i] = m->coef[0][i] + s * (m->coef[1][i] + s * (m->coef[2][i] + s * m->coef[3][i]));
+    }
+    return true;
+}
+
+size_t motion_count(const motion_t *m) {
+    return m->taken;
+}
+
+void motion_close(motion_t *m) {
+    if (m == NULL) {
+        return;
+    }
+    if (m->reader) {
+        pthread_mutex_lock(&m->mutex);
+        m->closed = true;
+        pthread_cond_signal(&m->notfull_cond);
+        pthread_mutex_unlock(&m->mutex);
+        pthread_join(m->thread, NULL);
+        pthread_cond_destroy(&m->notfull_cond);
+        pthread_cond_destroy(&m->notempty_cond);
+        pthread_mutex_destroy(&m->mutex);
+    }
+    if (m->map != NULL) {
+        munmap((void *) m->map, m->map_size);
+    }
+    if (m->gz != NULL) {
+        gzclose(m->gz);
+    }
+    if (m->fd >= 0) {
+        close(m->fd);
+    }
+    free(m);
+}
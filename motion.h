@@ -0,0 +1,86 @@
+/**
+ * multi-sdr-gps-sim generates a IQ data stream on-the-fly to simulate a
+ * GPS L1 baseband signal using a SDR platform like HackRF or ADLAM-Pluto.
+ *
+ * This file is part of the Github project at
+ * https://github.com/mictronics/multi-sdr-gps-sim.git
+ *
+ * Copyright © 2021 Mictronics
+ * Distributed under the MIT License.
+ *
+ */
+
+#ifndef MOTION_H
+#define MOTION_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define MOTION_RING_SIZE (4096) // Points parsed ahead of the generator
+#define MOTION_CHUNK_SIZE (64 * 1024) // Bytes read from the file at once
+
+/*
+ * Binary trajectory file layout, native byte order:
+ *
+ *   header   motion_bin_header_t
+ *   records  count times position[3], velocity[3] and acceleration[3],
+ *            velocity and acceleration only if flagged, as double or
+ *            float with MOTION_BIN_FLOAT
+ *
+ * Positions are ECEF in meters, or latitude and longitude in degrees and
+ * height in meters with MOTION_BIN_LLH. Velocity and acceleration are ECEF,
+ * or north, east and up with MOTION_BIN_LLH. Point i is at time
+ * epoch + i / rate.
+ */
+#define MOTION_BIN_MAGIC "GPSSIMTR"
+#define MOTION_BIN_VERSION (1)
+
+#define MOTION_BIN_LLH (1u << 0)
+#define MOTION_BIN_FLOAT (1u << 1)
+#define MOTION_BIN_VEL (1u << 2)
+#define MOTION_BIN_ACC (1u << 3)
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t flags; /* MOTION_BIN_* */
+    double rate; /* Points per second */
+    double epoch; /* Time of the first point, seconds */
+    uint64_t count; /* Number of records */
+    uint64_t reserved;
+} motion_bin_header_t;
+
+/* Optional parts of a point */
+#define MOTION_VEL (1u << 0)
+#define MOTION_ACC (1u << 1)
+
+/* One point of a user motion file. */
+typedef struct {
+    double t; // Time, seconds
+    double xyz[3]; // ECEF position, meters
+    double vel[3]; // ECEF velocity, m/s, valid with MOTION_VEL
+    double acc[3]; // ECEF acceleration, m/s^2, valid with MOTION_ACC
+    unsigned flags; // MOTION_VEL, MOTION_ACC
+} motion_point_t;
+
+typedef struct motion motion_t;
+
+/* Open a user motion file. Text files, also gzip compressed, hold
+ * "t,x,y,z[,vx,vy,vz[,ax,ay,az]]" ECEF lines with increasing time t in
+ * seconds at any rate and are read ahead on a background thread. Binary
+ * trajectories are memory mapped.
+ * Returns NULL if the file can't be opened or has an invalid header. */
+motion_t *motion_open(const char *filename);
+/* Position at t seconds after the first point, cubic Hermite interpolated
+ * between the points around t. Tangents are the point velocities if given,
+ * else slopes between the neighbouring points. t must not decrease from
+ * call to call. Waits if the reader is behind. False after the last point,
+ * a malformed line or a time that doesn't increase. */
+bool motion_position(motion_t *m, double t, double *xyz);
+/* Number of points read so far. */
+size_t motion_count(const motion_t *m);
+/* Stop the reader and release the motion source. */
+void motion_close(motion_t *m);
+
+#endif /* MOTION_H */
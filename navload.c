@@ -0,0 +1,257 @@
+/**
+ * multi-sdr-gps-sim generates a IQ data stream on-the-fly to simulate a
+ * GPS L1 baseband signal using a SDR platform like HackRF or ADLAM-Pluto.
+ *
+ * This file is part of the Github project at
+ * https://github.com/mictronics/multi-sdr-gps-sim.git
+ *
+ * Copyright © 2021 Mictronics
+ * Distributed under the MIT License.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <glob.h>
+#include <sys/stat.h>
+#include "gps-sim.h"
+#include "gui.h"
+#include "rinex.h"
+#include "ephcache.h"
+#include "navload.h"
+
+// One navigation file, parsed by a worker into its own store.
+typedef struct {
+    char *name;
+    ephstore_t store;
+    ionoutc_t ionoutc;
+    char date[21];
+    int result; // Ephemerides read or a RINEX_ERR_* code
+    bool cached; // Loaded from the binary cache
+    bool cache_failed; // Binary cache could not be written
+} nav_job_t;
+
+typedef struct {
+    nav_job_t *jobs;
+    size_t count;
+    size_t capacity;
+    atomic_size_t next; // Next job to be taken by a worker
+    bool use_cache;
+} nav_batch_t;
+
+static bool add_job(nav_batch_t *b, const char *name) {
+    if (b->count == b->capacity) {
+        size_t cap = (b->capacity > 0) ? b->capacity * 2 : 16;
+        nav_job_t *tmp = realloc(b->jobs, cap * sizeof (nav_job_t));
+        if (tmp == NULL) {
+            return false;
+        }
+        b->jobs = tmp;
+        b->capacity = cap;
+    }
+    nav_job_t *job = &b->jobs[b->count];
+    memset(job, 0, sizeof (*job));
+    job->name = strdup(name);
+    if (job->name == NULL) {
+        return false;
+    }
+    b->count++;
+    return true;
+}
+
+// Cache files and their temporaries live next to the navigation files
+bool navload_is_nav_name(const char *name) {
+    const char *base = strrchr(name, '/');
+    base = (base != NULL) ? base + 1 : name;
+    return base[0] != '.' && strstr(base, EPHCACHE_SUFFIX) == NULL;
+}
+
+static int dir_filter(const struct dirent *d) {
+    return navload_is_nav_name(d->d_name);
+}
+
+static bool is_regular(const char *name) {
+    struct stat st;
+    return stat(name, &st) == 0 && S_ISREG(st.st_mode);
+}
+
+// Expand one path into jobs. Returns the number of files found.
+static size_t expand_path(nav_batch_t *b, const char *path) {
+    struct stat st;
+    size_t found = 0;
+
+    if (strncmp(path, "file://", 7) == 0) {
+        path += 7;
+    }
+
+    if (stat(path, &st) == 0) {
+        if (!S_ISDIR(st.st_mode)) {
+            return add_job(b, path) ? 1 : 0;
+        }
+        struct dirent **list;
+        int n = scandir(path, &list, dir_filter, alphasort);
+        for (int i = 0; i < n; i++) {
+            char *name;
+            if (asprintf(&name, "%s/%s", path, list[i]->d_name) >= 0) {
+                if (is_regular(name) && add_job(b, name)) {
+                    found++;
+                }
+                free(name);
+            }
+            free(list[i]);
+        }
+        if (n >= 0) {
+            free(list);
+        }
+        return found;
+    }
+
+    glob_t g;
+    if (glob(path, 0, NULL, &g) == 0) {
+        for (size_t i = 0; i < g.gl_pathc; i++) {
+            if (navload_is_nav_name(g.gl_pathv[i]) && is_regular(g.gl_pathv[i]) && add_job(b, g.gl_pathv[i])) {
+                found++;
+            }
+        }
+    }
+    globfree(&g);
+    return found;
+}
+
+static void read_job(nav_job_t *job, bool use_cache) {
+    rinex_nav_t nav = {0};
+
+    ephstore_init(&job->store);
+    if (use_cache) {
+        int n = ephcache_load(job->name, &job->store, &job->ionoutc, job->date);
+        if (n > 0) {
+            job->result = n;
+            job->cached = true;
+            return;
+        }
+        ephstore_free(&job->store);
+        memset(&job->ionoutc, 0, sizeof (job->ionoutc));
+    }
+
+    job->result = rinex_read(job->name, &nav, &job->ionoutc);
+    if (job->result < 0) {
+        return;
+    }
+    strcpy(job->date, nav.date);
+    for (size_t i = 0; i < nav.count; i++) {
+        if (!ephstore_add(&job->store, &nav.eph[i])) {
+            break;
+        }
+    }
+    rinex_free(&nav);
+
+    job->result = (int) ephstore_count(&job->store);
+    if (use_cache && job->result > 0) {
+        job->cache_failed = !ephcache_save(job->name, &job->store, &job->ionoutc, job->date);
+    }
+}
+
+static void *worker_thread_ep(void *arg) {
+    nav_batch_t *b = (nav_batch_t *) arg;
+    set_thread_name("navload-thread");
+
+    for (;;) {
+        size_t i = atomic_fetch_add(&b->next, 1);
+        if (i >= b->count) {
+            break;
+        }
+        read_job(&b->jobs[i], b->use_cache);
+    }
+    return NULL;
+}
+
+static const char *error_text(int result) {
+    switch (result) {
+        case RINEX_ERR_OPEN:
+            return "not readable";
+        case RINEX_ERR_VERSION:
+            return "unsupported RINEX version, v2 and v3 are supported";
+        case RINEX_ERR_TYPE:
+            return "no GPS navigation data";
+        default:
+            return "no ephemeris";
+    }
+}
+
+int navload_read(const char *const *paths, size_t path_count, ephstore_t *store,
+        ionoutc_t *ionoutc, char date[21], bool use_cache, unsigned threads) {
+    nav_batch_t b;
+    pthread_t workers[NAVLOAD_MAX_WORKERS];
+    unsigned worker_count = 0;
+
+    memset(&b, 0, sizeof (b));
+    atomic_init(&b.next, 0);
+    b.use_cache = use_cache;
+
+    for (size_t i = 0; i < path_count; i++) {
+        if (expand_path(&b, paths[i]) == 0) {
+            gui_status_wprintw(YELLOW, "No RINEX file found for %s.\n", paths[i]);
+        }
+    }
+
+    // The calling thread takes part in the parsing
+    long limit = (threads > 0) ? (long) threads : sysconf(_SC_NPROCESSORS_ONLN);
+    while (worker_count < NAVLOAD_MAX_WORKERS && worker_count + 1 < b.count
+            && (long) worker_count + 1 < limit) {
+        if (pthread_create(&workers[worker_count], NULL, worker_thread_ep, &b) != 0) {
+            break;
+        }
+        worker_count++;
+    }
+    worker_thread_ep(&b);
+    for (unsigned i = 0; i < worker_count; i++) {
+        pthread_join(workers[i], NULL);
+    }
+
+    // Merge in input order, the store keeps the newest upload per TOE
+    const nav_job_t *iono_job = NULL;
+    size_t loaded = 0, cached = 0;
+    for (size_t i = 0; i < b.count; i++) {
+        nav_job_t *job = &b.jobs[i];
+        if (job->result <= 0) {
+            gui_status_wprintw((b.count > 1) ? YELLOW : RED, "RINEX file %s: %s.\n", job->name, error_text(job->result));
+        } else {
+            if (job->cache_failed) {
+                gui_status_wprintw(YELLOW, "Ephemeris cache of %s not written.\n", job->name);
+            }
+            for (int sv = 0; sv < MAX_SAT; sv++) {
+                const ephstore_sv_t *s = &job->store.sv[sv];
+                for (size_t k = 0; k < s->count; k++) {
+                    ephstore_add(store, &s->eph[k]);
+                }
+            }
+            if (iono_job == NULL || (!iono_job->ionoutc.vflg && job->ionoutc.vflg)) {
+                iono_job = job;
+            }
+            loaded++;
+            cached += job->cached;
+        }
+        ephstore_free(&job->store);
+    }
+
+    if (iono_job != NULL) {
+        int enable = ionoutc->enable; // Set by the user, not part of the file
+        *ionoutc = iono_job->ionoutc;
+        ionoutc->enable = enable;
+        strcpy(date, iono_job->date);
+    }
+    if (b.count > 1 || cached > 0) {
+        gui_status_wprintw(GREEN, "Ephemeris: %zu of %zu files read, %zu from cache.\n", loaded, b.count, cached);
+    }
+
+    for (size_t i = 0; i < b.count; i++) {
+        free(b.jobs[i].name);
+    }
+    free(b.jobs);
+    return (int) ephstore_count(store);
+}
@@ -0,0 +1,35 @@
+/**
+ * multi-sdr-gps-sim generates a IQ data stream on-the-fly to simulate a
+ * GPS L1 baseband signal using a SDR platform like HackRF or ADLAM-Pluto.
+ *
+ * This file is part of the Github project at
+ * https://github.com/mictronics/multi-sdr-gps-sim.git
+ *
+ * Copyright © 2021 Mictronics
+ * Distributed under the MIT License.
+ *
+ */
+
+#ifndef NAVLOAD_H
+#define NAVLOAD_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "gps.h"
+#include "ephstore.h"
+
+#define NAVLOAD_MAX_WORKERS (8) // Upper bound of RINEX parser threads
+
+/* Read the RINEX navigation files named by paths and merge their
+ * ephemerides into store. A path is a file or file:// URL, a directory
+ * whose files are all read, or a glob pattern. Files are parsed in parallel, each through
+ * its binary cache if use_cache is set. Iono/UTC parameters and the date
+ * are taken from the first file that has them. Files that can't be read
+ * are reported. threads limits the parser threads, 0 for one per core.
+ * Returns the number of ephemerides in store. */
+int navload_read(const char *const *paths, size_t path_count, ephstore_t *store,
+        ionoutc_t *ionoutc, char date[21], bool use_cache, unsigned threads);
+/* False for names of files that are never navigation input, like caches. */
+bool navload_is_nav_name(const char *name);
+
+#endif /* NAVLOAD_H */
@@ -0,0 +1,234 @@
+/**
+ * multi-sdr-gps-sim generates a IQ data stream on-the-fly to simulate a
+ * GPS L1 baseband signal using a SDR platform like HackRF or ADLAM-Pluto.
+ *
+ * This file is part of the Github project at
+ * https://github.com/mictronics/multi-sdr-gps-sim.git
+ *
+ * Copyright © 2021 Mictronics
+ * Distributed under the MIT License.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <poll.h>
+#include <time.h>
+#include <fnmatch.h>
+#include <libgen.h>
+#include <limits.h>
+#include <sys/inotify.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include "gui.h"
+#include "navload.h"
+#include "navwatch.h"
+
+#define WATCH_EVENTS (IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE)
+
+// One watched directory and the names in it that belong to a nav input
+typedef struct {
+    int wd;
+    char *dir;
+    char *pattern; // Full path pattern, NULL for all files in dir
+} watch_t;
+
+static simulator_t *sim;
+static int inotify_fd = -1;
+static watch_t *watches;
+static size_t watch_count;
+static pthread_t watch_thread;
+static bool watch_started;
+static atomic_bool watch_exit;
+static _Atomic(ephstore_t *) pending; // Reload waiting for the GPS thread
+
+static long long now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static bool add_watch(const char *path) {
+    struct stat st;
+    char *dir, *pattern = NULL;
+
+    if (strncmp(path, "file://", 7) == 0) {
+        path += 7;
+    }
+    if (stat(path, &st) == 0 && S_ISDIR(st.st_mode)) {
+        dir = strdup(path);
+    } else {
+        // File or glob pattern, watch the directory it is in
+        char *tmp = strdup(path);
+        if (tmp == NULL) {
+            return false;
+        }
+        dir = strdup(dirname(tmp));
+        free(tmp);
+        pattern = strdup(path);
+    }
+
+    watch_t *tmp = realloc(watches, (watch_count + 1) * sizeof (watch_t));
+    if (dir == NULL || tmp == NULL) {
+        free(dir);
+        free(pattern);
+        return false;
+    }
+    watches = tmp;
+    watch_t *w = &watches[watch_count];
+    w->wd = inotify_add_watch(inotify_fd, dir, WATCH_EVENTS);
+    w->dir = dir;
+    w->pattern = pattern;
+    if (w->wd < 0) {
+        gui_status_wprintw(YELLOW, "Can't watch %s for nav updates.\n", dir);
+        free(dir);
+        free(pattern);
+        return false;
+    }
+    watch_count++;
+    return true;
+}
+
+// Does the event name a file of one of the nav inputs?
+static bool is_nav_event(const struct inotify_event *ev) {
+    if (ev->len == 0 || !navload_is_nav_name(ev->name)) {
+        return false;
+    }
+    for (size_t i = 0; i < watch_count; i++) {
+        const watch_t *w = &watches[i];
+        if (w->wd != ev->wd) {
+            continue;
+        }
+        if (w->pattern == NULL) {
+            return true;
+        }
+        char name[PATH_MAX];
+        snprintf(name, sizeof (name), "%s/%s", w->dir, ev->name);
+        if (fnmatch(w->pattern, name, FNM_PATHNAME) == 0 || strcmp(w->pattern, name) == 0) {
+            return true;
+        }
+        // A plain file name given relative to the working directory
+        if (strcmp(w->dir, ".") == 0 && strcmp(w->pattern, ev->name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void reload(void) {
+    ionoutc_t ionoutc = {0};
+    char date[21];
+
+    ephstore_t *store = malloc(sizeof (ephstore_t));
+    if (store == NULL) {
+        return;
+    }
+    ephstore_init(store);
+    int n = navload_read((const char *const *) sim->nav_files, sim->nav_file_count,
+            store, &ionoutc, date, sim->nav_cache, 1);
+    if (n <= 0) {
+        gui_status_wprintw(YELLOW, "Nav reload failed, keeping current ephemeris.\n");
+        ephstore_free(store);
+        free(store);
+        return;
+    }
+
+    // Publish, a reload the GPS thread did not take yet is replaced
+    ephstore_t *old = atomic_exchange(&pending, store);
+    if (old != NULL) {
+        ephstore_free(old);
+        free(old);
+    }
+    gui_status_wprintw(GREEN, "Nav reload: %d ephemerides, active at next 30s frame.\n", n);
+}
+
+static void *watch_thread_ep(void *arg) {
+    (void) arg; // Not used
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    struct pollfd pfd = {inotify_fd, POLLIN, 0};
+    long long last_change = 0;
+    bool dirty = false;
+
+    set_thread_name("navwatch-thread");
+    // Parsing runs beside the signal generation, let it yield
+    setpriority(PRIO_PROCESS, 0, 10);
+
+    while (!atomic_load(&watch_exit)) {
+        if (poll(&pfd, 1, NAVWATCH_POLL_MS) > 0) {
+            ssize_t len = read(inotify_fd, buf, sizeof (buf));
+            for (ssize_t off = 0; off < len;) {
+                const struct inotify_event *ev = (const struct inotify_event *) (buf + off);
+                if (is_nav_event(ev)) {
+                    dirty = true;
+                    last_change = now_ms();
+                }
+                off += (ssize_t) (sizeof (struct inotify_event) + ev->len);
+            }
+        }
+        // Wait until writers are done, files often come in several steps
+        if (dirty && now_ms() - last_change >= NAVWATCH_SETTLE_MS) {
+            dirty = false;
+            reload();
+        }
+    }
+    return NULL;
+}
+
+bool navwatch_start(simulator_t *simulator) {
+    sim = simulator;
+    inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_fd < 0) {
+        gui_status_wprintw(RED, "Nav watch not available.\n");
+        return false;
+    }
+    for (size_t i = 0; i < simulator->nav_file_count; i++) {
+        add_watch(simulator->nav_files[i]);
+    }
+    if (watch_count == 0) {
+        navwatch_stop();
+        return false;
+    }
+
+    atomic_store(&watch_exit, false);
+    if (pthread_create(&watch_thread, NULL, watch_thread_ep, NULL) != 0) {
+        navwatch_stop();
+        return false;
+    }
+    watch_started = true;
+    return true;
+}
+
+void navwatch_stop(void) {
+    if (watch_started) {
+        atomic_store(&watch_exit, true);
+        pthread_join(watch_thread, NULL);
+        watch_started = false;
+    }
+    for (size_t i = 0; i < watch_count; i++) {
+        free(watches[i].dir);
+        free(watches[i].pattern);
+    }
+    free(watches);
+    watches = NULL;
+    watch_count = 0;
+    if (inotify_fd >= 0) {
+        close(inotify_fd);
+        inotify_fd = -1;
+    }
+    ephstore_t *old = atomic_exchange(&pending, NULL);
+    if (old != NULL) {
+        ephstore_free(old);
+        free(old);
+    }
+}
+
+ephstore_t *navwatch_take(void) {
+    if (atomic_load_explicit(&pending, memory_order_relaxed) == NULL) {
+        return NULL;
+    }
+    return atomic_exchange(&pending, NULL);
+}
@@ -0,0 +1,32 @@
+/**
+ * multi-sdr-gps-sim generates a IQ data stream on-the-fly to simulate a
+ * GPS L1 baseband signal using a SDR platform like HackRF or ADLAM-Pluto.
+ *
+ * This file is part of the Github project at
+ * https://github.com/mictronics/multi-sdr-gps-sim.git
+ *
+ * Copyright © 2021 Mictronics
+ * Distributed under the MIT License.
+ *
+ */
+
+#ifndef NAVWATCH_H
+#define NAVWATCH_H
+
+#include <stdbool.h>
+#include "gps-sim.h"
+#include "ephstore.h"
+
+#define NAVWATCH_SETTLE_MS (1000) // Quiet time after the last change before reloading
+#define NAVWATCH_POLL_MS (200) // Exit check interval of the watch thread
+
+/* Watch the navigation inputs of the simulator and parse them again on a
+ * low priority thread whenever one changes. */
+bool navwatch_start(simulator_t *simulator);
+/* Stop watching and drop a reload nobody took. */
+void navwatch_stop(void);
+/* Take the latest reloaded ephemerides, NULL if there are none. The
+ * caller owns the store and frees it with ephstore_free() and free(). */
+ephstore_t *navwatch_take(void);
+
+#endif /* NAVWATCH_H */
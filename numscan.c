@@ -0,0 +1,128 @@
+/**
+ * multi-sdr-gps-sim generates a IQ data stream on-the-fly to simulate a
+ * GPS L1 baseband signal using a SDR platform like HackRF or ADLAM-Pluto.
+ *
+ * This file is part of the Github project at
+ * https://github.com/mictronics/multi-sdr-gps-sim.git
+ *
+ * Copyright © 2021 Mictronics
+ * Distributed under the MIT License.
+ *
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include "numscan.h"
+
+// Powers of ten exactly representable as double
+static const double pow10_exact[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+#define MAX_EXACT_POW10 22
+#define MAX_EXACT_MANTISSA (1ull << 53)
+#define MAX_DIGITS 19 // Decimal digits fitting in uint64_t for sure
+
+static inline bool is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+// Rare case outside the exact range, let the C library round it.
+static double scan_slow(const char *p, size_t width) {
+    char tmp[40];
+    size_t n = 0;
+
+    for (; n < width && n < sizeof (tmp) - 1 && p[n] != '\n' && p[n] != '\r' && p[n] != 0; n++) {
+        tmp[n] = (p[n] == 'D' || p[n] == 'd') ? 'E' : p[n];
+    }
+    tmp[n] = 0;
+    return strtod(tmp, NULL);
+}
+
+double numscan_double(const char *p, size_t width) {
+    const char *end = p + width;
+    const char *s = p;
+    uint64_t mant = 0;
+    int digits = 0;
+    int scale = 0; // Decimal exponent of the last mantissa digit
+    bool neg = false;
+
+    while (s < end && *s == ' ') {
+        s++;
+    }
+    if (s < end && (*s == '-' || *s == '+')) {
+        neg = (*s++ == '-');
+    }
+    while (s < end && *s == '0') {
+        s++; // Leading zeros do not count as significant
+    }
+    for (; s < end && is_digit(*s); s++) {
+        if (digits < MAX_DIGITS) {
+            mant = mant * 10 + (uint64_t) (*s - '0');
+        } else {
+            scale++;
+        }
+        digits += (mant != 0);
+    }
+    if (s < end && *s == '.') {
+        for (s++; s < end && is_digit(*s); s++) {
+            if (digits < MAX_DIGITS) {
+                mant = mant * 10 + (uint64_t) (*s - '0');
+                scale--;
+            }
+            digits += (mant != 0);
+        }
+    }
+    if (s < end && (*s == 'D' || *s == 'd' || *s == 'E' || *s == 'e')) {
+        bool eneg = false;
+        int e = 0;
+        s++;
+        if (s < end && (*s == '-' || *s == '+')) {
+            eneg = (*s++ == '-');
+        }
+        for (; s < end && is_digit(*s); s++) {
+            if (e < 10000) {
+                e = e * 10 + (*s - '0');
+            }
+        }
+        scale += eneg ? -e : e;
+    }
+
+    if (mant == 0) {
+        return neg ? -0.0 : 0.0;
+    }
+    // Trailing zeros of the fixed mantissa width often keep the exact range
+    while (scale < -MAX_EXACT_POW10 && mant % 10 == 0) {
+        mant /= 10;
+        scale++;
+    }
+    if (digits > MAX_DIGITS || mant >= MAX_EXACT_MANTISSA
+            || scale > MAX_EXACT_POW10 || scale < -MAX_EXACT_POW10) {
+        return scan_slow(p, width);
+    }
+
+    // Exact mantissa times or by exact power of ten rounds once, as strtod
+    double v = (double) mant;
+    v = (scale < 0) ? v / pow10_exact[-scale] : v * pow10_exact[scale];
+    return neg ? -v : v;
+}
+
+long numscan_long(const char *p, size_t width) {
+    const char *end = p + width;
+    const char *s = p;
+    long v = 0;
+    bool neg = false;
+
+    while (s < end && *s == ' ') {
+        s++;
+    }
+    if (s < end && (*s == '-' || *s == '+')) {
+        neg = (*s++ == '-');
+    }
+    for (; s < end && is_digit(*s); s++) {
+        v = v * 10 + (*s - '0');
+    }
+    return neg ? -v : v;
+}
@@ -0,0 +1,28 @@
+/**
+ * multi-sdr-gps-sim generates a IQ data stream on-the-fly to simulate a
+ * GPS L1 baseband signal using a SDR platform like HackRF or ADLAM-Pluto.
+ *
+ * This file is part of the Github project at
+ * https://github.com/mictronics/multi-sdr-gps-sim.git
+ *
+ * Copyright © 2021 Mictronics
+ * Distributed under the MIT License.
+ *
+ */
+
+#ifndef NUMSCAN_H
+#define NUMSCAN_H
+
+#include <stddef.h>
+
+/* Decode a fixed-width numeric field as written by Fortran programs, e.g.
+ * "-1.234567890123D-04". D, d, E and e are accepted as exponent designator,
+ * leading blanks are skipped and scanning stops at the first character not
+ * part of the number or after width bytes. A blank field yields 0.
+ * Results are identical to strtod(). */
+double numscan_double(const char *p, size_t width);
+
+/* Decode a fixed-width integer field, see numscan_double(). */
+long numscan_long(const char *p, size_t width);
+
+#endif /* NUMSCAN_H */
@@ -0,0 +1,138 @@
+/**
+ * multi-sdr-gps-sim generates a IQ data stream on-the-fly to simulate a
+ * GPS L1 baseband signal using a SDR platform like HackRF or ADLAM-Pluto.
+ *
+ * This file is part of the Github project at
+ * https://github.com/mictronics/multi-sdr-gps-sim.git
+ *
+ * Copyright © 2021 Mictronics
+ * Distributed under the MIT License.
+ *
+ */
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include "pipeline.h"
+
+static pthread_mutex_t epochq_mutex = PTHREAD_MUTEX_INITIALIZER; // mutex protecting the queue
+static pthread_cond_t epochq_notempty_cond = PTHREAD_COND_INITIALIZER; // condition used to signal queue-not-empty
+static pthread_cond_t epochq_notfull_cond = PTHREAD_COND_INITIALIZER; // condition used to signal queue-not-full
+static epoch_t epochq_ring[EPOCH_QUEUE_SIZE]; // epoch slots
+static unsigned epochq_head; // index of the oldest committed epoch
+static unsigned epochq_count; // number of committed epochs
+static bool epochq_closed; // true if no more epochs are written
+static bool epochq_reading; // head slot is held by the synthesis stage
+
+static atomic_ulong stat_epochs;
+static atomic_uint stat_queued;
+static atomic_uint stat_obs_avg;
+static atomic_uint stat_obs_max;
+static atomic_uint stat_synth_avg;
+static atomic_uint stat_synth_max;
+
+void epochq_init(void) {
+    pthread_mutex_lock(&epochq_mutex);
+    epochq_head = 0;
+    epochq_count = 0;
+    epochq_closed = false;
+    epochq_reading = false;
+    pthread_mutex_unlock(&epochq_mutex);
+    atomic_store_explicit(&stat_epochs, 0, memory_order_relaxed);
+    atomic_store_explicit(&stat_queued, 0, memory_order_relaxed);
+    atomic_store_explicit(&stat_obs_avg, 0, memory_order_relaxed);
+    atomic_store_explicit(&stat_obs_max, 0, memory_order_relaxed);
+    atomic_store_explicit(&stat_synth_avg, 0, memory_order_relaxed);
+    atomic_store_explicit(&stat_synth_max, 0, memory_order_relaxed);
+}
+
+epoch_t *epochq_write_acquire(void) {
+    pthread_mutex_lock(&epochq_mutex);
+    // One slot is kept back, it may be in use by the synthesis stage.
+    while (!epochq_closed && epochq_count >= EPOCH_QUEUE_SIZE - 1) {
+        pthread_cond_wait(&epochq_notfull_cond, &epochq_mutex);
+    }
+    epoch_t *result = NULL;
+    if (!epochq_closed) {
+        result = &epochq_ring[(epochq_head + epochq_count) % EPOCH_QUEUE_SIZE];
+    }
+    pthread_mutex_unlock(&epochq_mutex);
+    return result;
+}
+
+void epochq_write_commit(void) {
+    pthread_mutex_lock(&epochq_mutex);
+    epochq_count++;
+    atomic_store_explicit(&stat_queued, epochq_count, memory_order_relaxed);
+    pthread_cond_signal(&epochq_notempty_cond);
+    pthread_mutex_unlock(&epochq_mutex);
+}
+
+epoch_t *epochq_read_acquire(void) {
+    pthread_mutex_lock(&epochq_mutex);
+    while (!epochq_closed && epochq_count == 0) {
+        pthread_cond_wait(&epochq_notempty_cond, &epochq_mutex);
+    }
+    epoch_t *result = NULL;
+    if (epochq_count > 0) {
+        result = &epochq_ring[epochq_head];
+        epochq_reading = true;
+    }
+    pthread_mutex_unlock(&epochq_mutex);
+    return result;
+}
+
+void epochq_read_release(void) {
+    pthread_mutex_lock(&epochq_mutex);
+    epochq_head = (epochq_head + 1) % EPOCH_QUEUE_SIZE;
+    epochq_count--;
+    epochq_reading = false;
+    atomic_store_explicit(&stat_queued, epochq_count, memory_order_relaxed);
+    atomic_fetch_add_explicit(&stat_epochs, 1, memory_order_relaxed);
+    pthread_cond_signal(&epochq_notfull_cond);
+    pthread_mutex_unlock(&epochq_mutex);
+}
+
+void epochq_close(bool drop) {
+    pthread_mutex_lock(&epochq_mutex);
+    epochq_closed = true;
+    if (drop) {
+        // Discard what was not read yet, the held slot is released later
+        epochq_count = epochq_reading ? 1 : 0;
+    }
+    pthread_cond_broadcast(&epochq_notempty_cond);
+    pthread_cond_broadcast(&epochq_notfull_cond);
+    pthread_mutex_unlock(&epochq_mutex);
+}
+
+void epochq_destroy(void) {
+    pthread_cond_destroy(&epochq_notempty_cond);
+    pthread_cond_destroy(&epochq_notfull_cond);
+    pthread_mutex_destroy(&epochq_mutex);
+}
+
+// Smoothed average and maximum of a stage time.
+static void stage_time(atomic_uint *avg, atomic_uint *max, unsigned us) {
+    unsigned a = atomic_load_explicit(avg, memory_order_relaxed);
+    a = (a == 0) ? us : a + ((int) us - (int) a) / 8;
+    atomic_store_explicit(avg, a, memory_order_relaxed);
+    if (us > atomic_load_explicit(max, memory_order_relaxed)) {
+        atomic_store_explicit(max, us, memory_order_relaxed);
+    }
+}
+
+void pipeline_obs_time(unsigned us) {
+    stage_time(&stat_obs_avg, &stat_obs_max, us);
+}
+
+void pipeline_synth_time(unsigned us) {
+    stage_time(&stat_synth_avg, &stat_synth_max, us);
+}
+
+void pipeline_get_stats(pipeline_stats_t *stats) {
+    stats->epochs = atomic_load_explicit(&stat_epochs, memory_order_relaxed);
+    stats->queued = atomic_load_explicit(&stat_queued, memory_order_relaxed);
+    stats->obs_avg_us = atomic_load_explicit(&stat_obs_avg, memory_order_relaxed);
+    stats->obs_max_us = atomic_load_explicit(&stat_obs_max, memory_order_relaxed);
+    stats->synth_avg_us = atomic_load_explicit(&stat_synth_avg, memory_order_relaxed);
+    stats->synth_max_us = atomic_load_explicit(&stat_synth_max, memory_order_relaxed);
+}
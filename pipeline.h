@@ -0,0 +1,79 @@
+/**
+ * multi-sdr-gps-sim generates a IQ data stream on-the-fly to simulate a
+ * GPS L1 baseband signal using a SDR platform like HackRF or ADLAM-Pluto.
+ *
+ * This file is part of the Github project at
+ * https://github.com/mictronics/multi-sdr-gps-sim.git
+ *
+ * Copyright © 2021 Mictronics
+ * Distributed under the MIT License.
+ *
+ */
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stdbool.h>
+#include "gps.h"
+
+/* Number of epochs the observation stage may run ahead of synthesis */
+#define EPOCH_QUEUE_SIZE (10)
+
+/* Parameters of one channel for one 100 ms epoch */
+typedef struct {
+    int prn; /* PRN Number, 0 if channel is unused */
+    bool fresh; /* Channel newly allocated, synthesis takes over carr_phase */
+    double f_carr; /* Carrier frequency */
+    double f_code; /* Code frequency */
+#ifdef FLOAT_CARR_PHASE
+    double carr_phase; /* Initial carrier phase, valid if fresh */
+#else
+    unsigned int carr_phase; /* Initial carrier phase, valid if fresh */
+    int carr_phasestep; /* Carrier phasestep */
+#endif
+    double code_phase; /* Code phase */
+    int iword; /* initial word */
+    int ibit; /* initial bit */
+    int icode; /* initial code */
+    int dataBit; /* current data bit */
+    int codeCA; /* current C/A code */
+    double gain; /* Signal gain */
+    unsigned long dwrd[N_DWRD]; /* Data words of sub-frame */
+} chan_epoch_t;
+
+/* Snapshot of all channels for one epoch, produced by the observation stage */
+typedef struct {
+    gpstime_t grx; /* Receiver time at epoch start */
+    chan_epoch_t chan[MAX_CHAN];
+} epoch_t;
+
+/* Pipeline stage timing, microseconds */
+typedef struct {
+    unsigned long epochs; /* Epochs synthesized */
+    unsigned queued; /* Epochs waiting for synthesis */
+    unsigned obs_avg_us; /* Smoothed observation time per epoch */
+    unsigned obs_max_us; /* Longest observation time per epoch */
+    unsigned synth_avg_us; /* Smoothed synthesis time per epoch */
+    unsigned synth_max_us; /* Longest synthesis time per epoch */
+} pipeline_stats_t;
+
+void epochq_init(void);
+/* Get a free epoch slot to fill, blocks while the queue is full. NULL if closed. */
+epoch_t *epochq_write_acquire(void);
+/* Hand the slot from epochq_write_acquire() to the synthesis stage. */
+void epochq_write_commit(void);
+/* Get the oldest epoch, blocks while the queue is empty. NULL if closed and drained. */
+epoch_t *epochq_read_acquire(void);
+/* Return the slot from epochq_read_acquire() to the observation stage. */
+void epochq_read_release(void);
+/* No more epochs will be written. With drop set pending epochs are discarded. */
+void epochq_close(bool drop);
+void epochq_destroy(void);
+
+/* Record processing time of one epoch. */
+void pipeline_obs_time(unsigned us);
+void pipeline_synth_time(unsigned us);
+/* Take a snapshot of the stage timing, may be called from any thread. */
+void pipeline_get_stats(pipeline_stats_t *stats);
+
+#endif /* PIPELINE_H */
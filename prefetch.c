@@ -0,0 +1,242 @@
+/**
+ * multi-sdr-gps-sim generates a IQ data stream on-the-fly to simulate a
+ * GPS L1 baseband signal using a SDR platform like HackRF or ADLAM-Pluto.
+ *
+ * This file is part of the Github project at
+ * https://github.com/mictronics/multi-sdr-gps-sim.git
+ *
+ * Copyright © 2021 Mictronics
+ * Distributed under the MIT License.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "gui.h"
+#include "navload.h"
+#include "prefetch.h"
+
+enum {
+    JOB_EPHEMERIS = 0, JOB_ALMANAC, JOB_COUNT
+};
+
+struct ftp_file {
+    const char *filename;
+    FILE *stream;
+};
+
+static simulator_t *sim;
+static prefetch_t prefetch;
+static pthread_t threads[JOB_COUNT];
+static bool thread_started[JOB_COUNT];
+static bool started;
+static bool taken; // Results handed to prefetch_join()
+
+static size_t fwrite_rinex(void *buffer, size_t size, size_t nmemb, void *stream) {
+    struct ftp_file *out = (struct ftp_file *) stream;
+    if (out && !out->stream) {
+        /* open file for writing */
+        out->stream = fopen(out->filename, "wb");
+        if (!out->stream)
+            return -1; /* failure, can't open file to write */
+    }
+    return fwrite(buffer, size, nmemb, out->stream);
+}
+
+// URL of a file below the online base, or below the mirror if one is given
+static void source_url(char *url, size_t size, const char *base, const char *path) {
+    if (sim->mirror_url != NULL) {
+        base = sim->mirror_url;
+    }
+    size_t len = strlen(base);
+    snprintf(url, size, "%s%s%s", base, (len > 0 && base[len - 1] == '/') ? "" : "/", path);
+}
+
+static CURLcode download_rinex(const char *filename) {
+    CURL *curl;
+    CURLcode curl_code = CURLE_GOT_NOTHING;
+    struct ftp_file ftp = {
+        filename,
+        NULL
+    };
+    time_t t = time(NULL);
+    struct tm *tm = gmtime(&t);
+    char path[NAME_MAX];
+    char url[PATH_MAX];
+    gpstime_t g0;
+    int station_index = 0;
+
+    date2gps(&sim->start, &g0);
+
+    // Use RINEX v2 by default or v3 on request
+    const stations_t *pstation = stations_v2;
+    if (sim->use_rinex3) {
+        pstation = stations_v3;
+    }
+
+    // Get number of stations available, find index for given one
+    for (int s = 0; pstation[s].id_v2 != NULL; s++) {
+        // Station id given, get index
+        if (sim->station_id != NULL) {
+            if (strncmp(pstation[s].id_v2, sim->station_id, 4) == 0 || strncmp(pstation[s].id_v3, sim->station_id, 9) == 0) {
+                break;
+            }
+        }
+        station_index += 1;
+    }
+
+    // Pick a random station if none given
+    if (sim->station_id == NULL) {
+        srand((unsigned int) g0.sec);
+        station_index = rand() % station_index;
+    }
+    // Check that we have a picked a valid station
+    // Take the first one when invalid
+    if (pstation[station_index].id_v2 == NULL) {
+        station_index = 0;
+    }
+
+    gui_status_wprintw(GREEN, "Pulling RINEX v%u from station: %s\n", (sim->use_rinex3) ? 3 : 2, pstation[station_index].name);
+
+    // We fetch data from previous hour because the actual hour is still in progress
+    tm->tm_hour -= 1;
+    if (tm->tm_hour < 0) {
+        tm->tm_hour = 23;
+    }
+
+    // Compose FTP URL
+    snprintf(path, sizeof (path), RINEX_FTP_FILE, (sim->use_rinex3) ? RINEX3_SUBFOLDER : RINEX2_SUBFOLDER,
+            tm->tm_yday + 1, tm->tm_hour, pstation[station_index].id_v2, tm->tm_yday + 1, 'a' + tm->tm_hour, tm->tm_year - 100);
+    source_url(url, sizeof (url), RINEX_FTP_URL, path);
+
+    curl = curl_easy_init();
+    if (curl) {
+        curl_easy_setopt(curl, CURLOPT_URL, url);
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, fwrite_rinex);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &ftp);
+        curl_easy_setopt(curl, CURLOPT_USE_SSL, CURLUSESSL_NONE);
+        curl_easy_setopt(curl, CURLOPT_VERBOSE, 0L);
+        curl_easy_setopt(curl, CURLOPT_USERPWD, "anonymous:anonymous");
+        curl_code = curl_easy_perform(curl);
+        curl_easy_cleanup(curl);
+    }
+
+    if (ftp.stream)
+        fclose(ftp.stream);
+
+    return curl_code;
+}
+
+static void *ephemeris_thread_ep(void *arg) {
+    (void) arg; // Not used
+    set_thread_name("prefetch-eph");
+
+    if (sim->use_ftp) {
+        const char *filename = RINEX2_FILE_NAME;
+        CURLcode curl_code = download_rinex(filename);
+        prefetch.eph_code = curl_code;
+        if (curl_code != CURLE_OK) {
+            switch (curl_code) {
+                case CURLE_REMOTE_FILE_NOT_FOUND:
+                case CURLE_FILE_COULDNT_READ_FILE:
+                    gui_status_wprintw(RED, "Curl error: Ephemeris file not found!\n");
+                    break;
+                default:
+                    gui_status_wprintw(RED, "Curl error: %d\n", curl_code);
+                    break;
+            }
+            // Source or mirror unreachable, go on with an earlier download
+            if (access(filename, R_OK) != 0) {
+                return NULL;
+            }
+            gui_status_wprintw(YELLOW, "Using previously downloaded %s.\n", filename);
+        }
+        prefetch.neph = navload_read(&filename, 1, &prefetch.store, &prefetch.ionoutc, prefetch.date, sim->nav_cache, 0);
+    } else {
+        prefetch.neph = navload_read((const char *const *) sim->nav_files, sim->nav_file_count,
+                &prefetch.store, &prefetch.ionoutc, prefetch.date, sim->nav_cache, 0);
+    }
+    return NULL;
+}
+
+static void *almanac_thread_ep(void *arg) {
+    (void) arg; // Not used
+    set_thread_name("prefetch-alm");
+
+    prefetch.alm = almanac_init();
+    if (sim->almanac_enable) {
+        if (sim->use_ftp) {
+            char url[PATH_MAX];
+            source_url(url, sizeof (url), ALMANAC_DOWNLOAD_URL, ALMANAC_SEM_FILE);
+            prefetch.alm_code = almanac_download(url);
+            // Almanacs stay usable for weeks, fall back to an earlier download
+            if (prefetch.alm_code != CURLE_OK && almanac_read_file() == CURLE_OK) {
+                gui_status_wprintw(YELLOW, "Almanac download failed (%d), using previous almanac.sem.\n", prefetch.alm_code);
+                prefetch.alm_code = CURLE_OK;
+            }
+        } else {
+            prefetch.alm_code = almanac_read_file();
+        }
+    }
+    return NULL;
+}
+
+void prefetch_start(simulator_t *simulator) {
+    void *(*jobs[JOB_COUNT])(void *) = {ephemeris_thread_ep, almanac_thread_ep};
+
+    if (started) {
+        return;
+    }
+    sim = simulator;
+    started = true;
+    taken = false;
+    memset(&prefetch, 0, sizeof (prefetch));
+    ephstore_init(&prefetch.store);
+    prefetch.ionoutc.enable = simulator->ionosphere_enable;
+    prefetch.eph_code = CURLE_OK;
+    prefetch.alm_code = CURLE_OK;
+
+    // Not thread safe, once before any transfer
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+
+    for (int i = 0; i < JOB_COUNT; i++) {
+        thread_started[i] = (pthread_create(&threads[i], NULL, jobs[i], NULL) == 0);
+        if (!thread_started[i]) {
+            jobs[i](NULL);
+        }
+    }
+}
+
+static void join_threads(void) {
+    for (int i = 0; i < JOB_COUNT; i++) {
+        if (thread_started[i]) {
+            pthread_join(threads[i], NULL);
+            thread_started[i] = false;
+        }
+    }
+}
+
+void prefetch_join(simulator_t *simulator, prefetch_t *result) {
+    prefetch_start(simulator);
+    join_threads();
+    *result = prefetch;
+    ephstore_init(&prefetch.store);
+    taken = true;
+}
+
+void prefetch_close(void) {
+    if (!started) {
+        return;
+    }
+    join_threads();
+    if (!taken) {
+        ephstore_free(&prefetch.store);
+    }
+    curl_global_cleanup();
+    started = false;
+}
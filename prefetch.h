@@ -0,0 +1,42 @@
+/**
+ * multi-sdr-gps-sim generates a IQ data stream on-the-fly to simulate a
+ * GPS L1 baseband signal using a SDR platform like HackRF or ADLAM-Pluto.
+ *
+ * This file is part of the Github project at
+ * https://github.com/mictronics/multi-sdr-gps-sim.git
+ *
+ * Copyright © 2021 Mictronics
+ * Distributed under the MIT License.
+ *
+ */
+
+#ifndef PREFETCH_H
+#define PREFETCH_H
+
+#include <curl/curl.h>
+#include "gps.h"
+#include "gps-sim.h"
+#include "almanac.h"
+#include "ephstore.h"
+
+/* Results of the startup loads. */
+typedef struct {
+    ephstore_t store; // Owned by the caller after prefetch_join()
+    ionoutc_t ionoutc;
+    char date[21]; // RINEX file date
+    int neph; // Number of ephemerides, 0 if none could be loaded
+    CURLcode eph_code; // Ephemeris download result, CURLE_OK for local files
+    almanac_gps_t *alm;
+    CURLcode alm_code; // Almanac load result, CURLE_OK when disabled
+} prefetch_t;
+
+/* Start downloading and parsing ephemeris and almanac, each on its own
+ * thread, so they overlap with each other and the SDR initialization. */
+void prefetch_start(simulator_t *simulator);
+/* Wait for the loads and take their results. Loads right away when
+ * prefetch_start() was not called. */
+void prefetch_join(simulator_t *simulator, prefetch_t *result);
+/* Wait for unfinished loads and release results nobody took. */
+void prefetch_close(void);
+
+#endif /* PREFETCH_H */
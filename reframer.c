@@ -0,0 +1,85 @@
+/**
+ * multi-sdr-gps-sim generates a IQ data stream on-the-fly to simulate a
+ * GPS L1 baseband signal using a SDR platform like HackRF or ADLAM-Pluto.
+ *
+ * This file is part of the Github project at
+ * https://github.com/mictronics/multi-sdr-gps-sim.git
+ *
+ * Copyright © 2021 Mictronics
+ * Distributed under the MIT License.
+ *
+ */
+
+#include <string.h>
+#include "reframer.h"
+
+bool reframer_init(reframer_t *rf, const iq_format_desc_t *fmt) {
+    rf->unit_size = fmt->unit_size;
+    rf->iq = fifo_acquire();
+    return rf->iq != NULL;
+}
+
+void *reframer_view(reframer_t *rf, size_t *units) {
+    if (rf->iq == NULL) {
+        *units = 0;
+        return NULL;
+    }
+    // validLength starts with 0 on acquire
+    *units = rf->iq->totalLength - rf->iq->validLength;
+    return (char *) fifo_buffer_data(rf->iq) + (size_t) rf->iq->validLength * rf->unit_size;
+}
+
+bool reframer_commit(reframer_t *rf, size_t units) {
+    if (rf->iq == NULL) {
+        return false;
+    }
+    rf->iq->validLength += (unsigned) units;
+    if (rf->iq->validLength == rf->iq->totalLength) {
+        // Enqueue full buffer and get a new one
+        fifo_enqueue(rf->iq);
+        rf->iq = fifo_acquire();
+    }
+    return rf->iq != NULL;
+}
+
+bool reframer_write(reframer_t *rf, const void *data, size_t bytes) {
+    const char *p = data;
+
+    while (bytes > 0) {
+        size_t units;
+        char *dst = reframer_view(rf, &units);
+        if (dst == NULL) {
+            return false;
+        }
+        size_t n = units * rf->unit_size;
+        if (n > bytes) {
+            n = bytes;
+        }
+        if (p != NULL) {
+            memcpy(dst, p, n);
+            p += n;
+        } else {
+            memset(dst, 0, n);
+        }
+        bytes -= n;
+        if (!reframer_commit(rf, n / rf->unit_size)) {
+            return bytes == 0;
+        }
+    }
+    return true;
+}
+
+void reframer_flush(reframer_t *rf) {
+    if (rf->iq == NULL || rf->iq->validLength == 0) {
+        return;
+    }
+    unsigned align = fifo_block_align();
+    unsigned pad = (align - rf->iq->validLength % align) % align;
+    if (pad > rf->iq->totalLength - rf->iq->validLength) {
+        pad = rf->iq->totalLength - rf->iq->validLength;
+    }
+    memset((char *) fifo_buffer_data(rf->iq) + (size_t) rf->iq->validLength * rf->unit_size, 0, (size_t) pad * rf->unit_size);
+    rf->iq->validLength += pad;
+    fifo_enqueue(rf->iq);
+    rf->iq = NULL;
+}
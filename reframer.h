@@ -0,0 +1,42 @@
+/**
+ * multi-sdr-gps-sim generates a IQ data stream on-the-fly to simulate a
+ * GPS L1 baseband signal using a SDR platform like HackRF or ADLAM-Pluto.
+ *
+ * This file is part of the Github project at
+ * https://github.com/mictronics/multi-sdr-gps-sim.git
+ *
+ * Copyright © 2021 Mictronics
+ * Distributed under the MIT License.
+ *
+ */
+
+#ifndef REFRAMER_H
+#define REFRAMER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "fifo.h"
+#include "iqformat.h"
+
+/*
+ * Cuts a continuous IQ stream into FIFO buffers of the size the sink asked
+ * for in fifo_create(). Producers write straight into the current buffer
+ * through views, a buffer is enqueued as soon as it is full.
+ */
+typedef struct {
+    struct iq_buf *iq; /* Buffer being filled, NULL once the FIFO is halted */
+    unsigned unit_size; /* Bytes per FIFO sample unit */
+} reframer_t;
+
+/* Acquire the first buffer, blocks until one is free. */
+bool reframer_init(reframer_t *rf, const iq_format_desc_t *fmt);
+/* Writable room left in the current buffer, count in sample units. NULL if halted. */
+void *reframer_view(reframer_t *rf, size_t *units);
+/* Mark units of the view as written, full buffers are handed to the FIFO. */
+bool reframer_commit(reframer_t *rf, size_t units);
+/* Copy bytes into as many buffers as needed, data NULL writes silence. */
+bool reframer_write(reframer_t *rf, const void *data, size_t bytes);
+/* Hand out a partly filled buffer, padded with silence to the sink alignment. */
+void reframer_flush(reframer_t *rf);
+
+#endif /* REFRAMER_H */
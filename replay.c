@@ -0,0 +1,262 @@
+/**
+ * multi-sdr-gps-sim generates a IQ data stream on-the-fly to simulate a
+ * GPS L1 baseband signal using a SDR platform like HackRF or ADLAM-Pluto.
+ *
+ * This file is part of the Github project at
+ * https://github.com/mictronics/multi-sdr-gps-sim.git
+ *
+ * Copyright © 2021 Mictronics
+ * Distributed under the MIT License.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "sdr.h"
+#include "gui.h"
+#include "fifo.h"
+#include "reframer.h"
+#include "iqarchive.h"
+#include "gps-sim.h"
+#include "timeutil.h"
+#include "replay.h"
+
+// Replay source, either a raw IQ file mapped into memory or a chunk archive.
+typedef struct {
+    int fd;
+    const unsigned char *map; // Raw file mapping
+    uint64_t size; // Raw file size
+    uint64_t readahead; // Readahead issued up to this offset
+    struct iqarchive_reader *archive;
+    unsigned char *chunk; // Decompressed archive chunk
+    size_t chunk_bytes;
+    int64_t chunk_no; // Chunk held in buffer, -1 if none
+    size_t chunk_len;
+    uint64_t start; // Byte offset where replay starts and loops back to
+    uint64_t pos; // Current byte offset in the IQ stream
+} replay_src_t;
+
+static atomic_ullong stat_played_us;
+static atomic_ullong stat_elapsed_us;
+static atomic_uint stat_loops;
+static atomic_uint stat_late;
+
+static double elapsed_sec(const struct timespec *t0) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double) (now.tv_sec - t0->tv_sec) + (double) (now.tv_nsec - t0->tv_nsec) / 1e9;
+}
+
+static bool src_open(replay_src_t *src, const char *name, const iq_format_desc_t *fmt, simulator_t *simulator) {
+    char magic[8];
+
+    memset(src, 0, sizeof (*src));
+    src->chunk_no = -1;
+    src->fd = open(name, O_RDONLY);
+    if (src->fd < 0) {
+        gui_status_wprintw(RED, "Error opening replay file %s.\n", name);
+        return false;
+    }
+
+    if (pread(src->fd, magic, sizeof (magic), 0) == (ssize_t) sizeof (magic)
+            && memcmp(magic, IQARCHIVE_MAGIC, sizeof (magic)) == 0) {
+        iqarchive_info_t info;
+        src->archive = iqarchive_reader_open(name);
+        if (src->archive == NULL) {
+            gui_status_wprintw(RED, "Replay archive %s is damaged.\n", name);
+            return false;
+        }
+        iqarchive_reader_info(src->archive, &info);
+        if (info.format != simulator->iq_format) {
+            gui_status_wprintw(RED, "Replay archive is %s, radio needs %s.\n",
+                    iq_format_desc(info.format)->name, fmt->name);
+            return false;
+        }
+        src->chunk_bytes = info.chunk_bytes;
+        src->chunk = malloc(src->chunk_bytes);
+        if (src->chunk == NULL) {
+            return false;
+        }
+        src->size = info.chunk_count * info.chunk_bytes; // Upper bound, last chunk may be short
+        if (info.start.week >= 0) {
+            simulator->start_gps = info.start;
+        }
+        gui_status_wprintw(GREEN, "Replay archive: %llu chunks %s.\n", (unsigned long long) info.chunk_count, fmt->name);
+    } else {
+        struct stat st;
+        if (fstat(src->fd, &st) != 0 || st.st_size == 0) {
+            gui_status_wprintw(RED, "Replay file %s is empty.\n", name);
+            return false;
+        }
+        src->size = (uint64_t) st.st_size;
+        src->map = mmap(NULL, src->size, PROT_READ, MAP_SHARED, src->fd, 0);
+        if (src->map == MAP_FAILED) {
+            src->map = NULL;
+            gui_status_wprintw(RED, "Error mapping replay file %s.\n", name);
+            return false;
+        }
+        madvise((void *) src->map, src->size, MADV_SEQUENTIAL);
+        gui_status_wprintw(GREEN, "Replay file: %.1fs %s.\n",
+                (double) src->size / fmt->unit_size / iq_format_units(fmt, IQ_BUFFER_SIZE) / 10.0, fmt->name);
+    }
+
+    // Start offset on a sample boundary
+    uint64_t samples = (uint64_t) (simulator->replay_offset * TX_SAMPLERATE);
+    src->start = iq_format_units(fmt, samples * 2) * fmt->unit_size;
+    if (src->start >= src->size) {
+        gui_status_wprintw(RED, "Replay offset beyond end of file.\n");
+        return false;
+    }
+    src->pos = src->readahead = src->start;
+    if (simulator->start_gps.week >= 0) {
+        simulator->start_gps.sec += (double) samples / TX_SAMPLERATE;
+    }
+    return true;
+}
+
+static void src_close(replay_src_t *src) {
+    if (src->map != NULL) {
+        munmap((void *) src->map, src->size);
+    }
+    iqarchive_reader_close(src->archive);
+    free(src->chunk);
+    if (src->fd >= 0) {
+        close(src->fd);
+    }
+}
+
+// Next contiguous span of IQ data at the current position, 0 at end of data.
+static size_t src_span(replay_src_t *src, const unsigned char **data) {
+    if (src->archive != NULL) {
+        int64_t no = (int64_t) (src->pos / src->chunk_bytes);
+        size_t off = (size_t) (src->pos % src->chunk_bytes);
+        if (no != src->chunk_no) {
+            ssize_t len = iqarchive_read_chunk(src->archive, (uint64_t) no, src->chunk, src->chunk_bytes);
+            if (len < 0) {
+                return 0;
+            }
+            src->chunk_no = no;
+            src->chunk_len = (size_t) len;
+        }
+        if (off >= src->chunk_len) {
+            return 0;
+        }
+        *data = src->chunk + off;
+        return src->chunk_len - off;
+    }
+
+    if (src->pos >= src->size) {
+        return 0;
+    }
+    // Keep the kernel reading ahead of the mapping access
+    if (src->readahead < src->pos + REPLAY_READAHEAD && src->readahead < src->size) {
+        readahead(src->fd, (off64_t) src->readahead, REPLAY_READAHEAD);
+        src->readahead += REPLAY_READAHEAD;
+    }
+    *data = src->map + src->pos;
+    return (size_t) (src->size - src->pos);
+}
+
+void *replay_thread_ep(void *arg) {
+    simulator_t *simulator = (simulator_t *) (arg);
+    const iq_format_desc_t *fmt = iq_format_desc(simulator->iq_format);
+    replay_src_t src;
+    reframer_t rf;
+    struct timespec t0;
+    unsigned loops = 0;
+    unsigned late = 0;
+    double elapsed;
+    uint64_t sent = 0; // FIFO sample units enqueued
+    // File and null sinks take data as fast as we give it, pace those to real time
+    bool pace = (simulator->sdr_type == SDR_IQFILE || simulator->sdr_type == SDR_NONE);
+    double unit_time = (double) iq_format_elements(fmt, 1) / 2.0 / TX_SAMPLERATE;
+
+    thread_to_role(CORE_SYNTHESIS);
+    set_thread_name("replay-thread");
+
+    atomic_store_explicit(&stat_played_us, 0, memory_order_relaxed);
+    atomic_store_explicit(&stat_elapsed_us, 0, memory_order_relaxed);
+    atomic_store_explicit(&stat_loops, 0, memory_order_relaxed);
+    atomic_store_explicit(&stat_late, 0, memory_order_relaxed);
+
+    if (!src_open(&src, simulator->replay_file_name, fmt, simulator)) {
+        goto end_replay_thread;
+    }
+
+    simulator->gps_thread_running = true;
+    pthread_cond_signal(&(simulator->gps_init_done));
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    bool fifo_open = reframer_init(&rf, fmt);
+    while (!simulator->gps_thread_exit && fifo_open) {
+        const unsigned char *data;
+        size_t avail = src_span(&src, &data);
+        if (avail < fmt->unit_size) {
+            if (!simulator->replay_loop || src.pos == src.start) {
+                break;
+            }
+            src.pos = src.start;
+            loops++;
+            atomic_store_explicit(&stat_loops, loops, memory_order_relaxed);
+            continue;
+        }
+
+        size_t units;
+        void *dst = reframer_view(&rf, &units);
+        size_t n = units * fmt->unit_size;
+        if (n > avail) {
+            n = avail - avail % fmt->unit_size;
+        }
+        memcpy(dst, data, n);
+        src.pos += n;
+        sent += n / fmt->unit_size;
+        fifo_open = reframer_commit(&rf, n / fmt->unit_size);
+        if (n < units * fmt->unit_size) {
+            continue; // Block not full yet
+        }
+
+        if (pace) {
+            double t = (double) sent * unit_time;
+            if (elapsed_sec(&t0) > t + REPLAY_LATE) {
+                late++;
+                atomic_store_explicit(&stat_late, late, memory_order_relaxed);
+            }
+            sleep_until(&t0, t);
+        }
+        double played = (double) sent * unit_time;
+        elapsed = elapsed_sec(&t0);
+        atomic_store_explicit(&stat_played_us, (unsigned long long) (played * 1e6), memory_order_relaxed);
+        atomic_store_explicit(&stat_elapsed_us, (unsigned long long) (elapsed * 1e6), memory_order_relaxed);
+        gui_mvwprintw(LS_FIX, 12, 40, "Elapsed:         %5.1fs", played);
+        gui_mvwprintw(LS_FIX, 14, 40, "Replay:          pos %7.1fs loop %u rate %5.3fx late %u  ",
+                (double) (src.pos / fmt->unit_size) * unit_time, loops, played / elapsed, late);
+    }
+
+    // Hand out the last partly filled block
+    if (fifo_open && !simulator->gps_thread_exit) {
+        reframer_flush(&rf);
+    }
+    if (!simulator->gps_thread_exit) {
+        gui_status_wprintw(GREEN, "Replay complete\n");
+    }
+
+end_replay_thread:
+    src_close(&src);
+    gui_status_wprintw(RED, "Exit replay thread\n");
+    simulator->gps_thread_exit = true;
+    pthread_cond_signal(&(simulator->gps_init_done));
+    pthread_exit(NULL);
+}
+
+void replay_get_stats(replay_stats_t *stats) {
+    stats->played = (double) atomic_load_explicit(&stat_played_us, memory_order_relaxed) / 1e6;
+    stats->elapsed = (double) atomic_load_explicit(&stat_elapsed_us, memory_order_relaxed) / 1e6;
+    stats->loops = atomic_load_explicit(&stat_loops, memory_order_relaxed);
+    stats->late = atomic_load_explicit(&stat_late, memory_order_relaxed);
+}
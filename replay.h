@@ -0,0 +1,32 @@
+/**
+ * multi-sdr-gps-sim generates a IQ data stream on-the-fly to simulate a
+ * GPS L1 baseband signal using a SDR platform like HackRF or ADLAM-Pluto.
+ *
+ * This file is part of the Github project at
+ * https://github.com/mictronics/multi-sdr-gps-sim.git
+ *
+ * Copyright © 2021 Mictronics
+ * Distributed under the MIT License.
+ *
+ */
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#define REPLAY_READAHEAD (8 * 1024 * 1024) // Bytes read ahead of the replay position
+#define REPLAY_LATE (0.1) // Seconds behind schedule a paced block counts as late
+
+/* Replay progress, see replay_get_stats(). */
+typedef struct {
+    double played; // Seconds of IQ data handed to the FIFO
+    double elapsed; // Seconds since replay started, at the last block
+    unsigned loops; // Times the replay wrapped around
+    unsigned late; // Paced blocks handed out too late
+} replay_stats_t;
+
+/* Feed the FIFO from a pre-rendered IQ file or archive instead of the generator. */
+void *replay_thread_ep(void *arg);
+/* Take a snapshot of the replay progress, may be called from any thread. */
+void replay_get_stats(replay_stats_t *stats);
+
+#endif /* REPLAY_H */
@@ -0,0 +1,342 @@
+/**
+ * multi-sdr-gps-sim generates a IQ data stream on-the-fly to simulate a
+ * GPS L1 baseband signal using a SDR platform like HackRF or ADLAM-Pluto.
+ *
+ * This file is part of the Github project at
+ * https://github.com/mictronics/multi-sdr-gps-sim.git
+ *
+ * Copyright © 2021 Mictronics
+ * Distributed under the MIT License.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+#include <sys/stat.h>
+#include <zlib.h>
+#include "numscan.h"
+#include "rinex.h"
+
+#define RINEX_READ_CHUNK (1 << 20)
+#define RINEX_LABEL_COL 60
+#define RINEX_ORBIT_LINES 7 // Broadcast orbit lines following the SV/EPOCH/SV CLK line
+
+typedef struct {
+    const char *p;
+    size_t len; // Without line break
+} line_t;
+
+// Inflate the whole file into one NUL terminated buffer. Plain files are read as is.
+static char *read_file(const char *fname, size_t *size) {
+    struct stat st;
+    size_t cap = RINEX_READ_CHUNK;
+    size_t len = 0;
+
+    if (stat(fname, &st) == 0 && (size_t) st.st_size * 2 > cap) {
+        cap = (size_t) st.st_size * 2; // Headroom for compressed files
+    }
+    gzFile fp = gzopen(fname, "rb");
+    if (fp == NULL) {
+        return NULL;
+    }
+    gzbuffer(fp, RINEX_READ_CHUNK);
+
+    char *buf = malloc(cap);
+    while (buf != NULL) {
+        if (cap - len < RINEX_READ_CHUNK) {
+            char *tmp = realloc(buf, cap * 2);
+            if (tmp == NULL) {
+                free(buf);
+                buf = NULL;
+                break;
+            }
+            buf = tmp;
+            cap *= 2;
+        }
+        int n = gzread(fp, buf + len, RINEX_READ_CHUNK - 1);
+        if (n < 0) {
+            free(buf);
+            buf = NULL;
+        } else if (n == 0) {
+            buf[len] = 0;
+            *size = len;
+            break;
+        } else {
+            len += (size_t) n;
+        }
+    }
+    gzclose(fp);
+    return buf;
+}
+
+static bool next_line(const char **pos, const char *end, line_t *line) {
+    const char *p = *pos;
+    if (p >= end) {
+        return false;
+    }
+    const char *nl = memchr(p, '\n', (size_t) (end - p));
+    const char *eol = (nl != NULL) ? nl : end;
+    line->p = p;
+    line->len = (size_t) (eol - p);
+    if (line->len > 0 && p[line->len - 1] == '\r') {
+        line->len--;
+    }
+    *pos = (nl != NULL) ? nl + 1 : end;
+    return true;
+}
+
+// Fields beyond a trimmed line end are blank
+static double field(const line_t *line, size_t col, size_t width) {
+    if (col >= line->len) {
+        return 0.0;
+    }
+    if (width > line->len - col) {
+        width = line->len - col;
+    }
+    return numscan_double(line->p + col, width);
+}
+
+static int ifield(const line_t *line, size_t col, size_t width) {
+    if (col >= line->len) {
+        return 0;
+    }
+    if (width > line->len - col) {
+        width = line->len - col;
+    }
+    return (int) numscan_long(line->p + col, width);
+}
+
+static char column(const line_t *line, size_t col) {
+    return (col < line->len) ? line->p[col] : ' ';
+}
+
+static bool has_label(const line_t *line, const char *label) {
+    size_t n = strlen(label);
+    return line->len >= RINEX_LABEL_COL + n && memcmp(line->p + RINEX_LABEL_COL, label, n) == 0;
+}
+
+// Header lines up to END OF HEADER. Returns 0 or a RINEX_ERR_* code.
+static int read_header(const char **pos, const char *end, rinex_nav_t *nav, ionoutc_t *ionoutc) {
+    line_t l;
+    int flags = 0x0;
+    // Iono columns differ, v2 "ION ALPHA" at 2, v3 "GPSA" at 5
+    size_t ion = 2;
+
+    nav->version = 0;
+    nav->date[0] = 0;
+    while (next_line(pos, end, &l)) {
+        if (has_label(&l, "COMMENT")) {
+            continue;
+        } else if (has_label(&l, "END OF HEADER")) {
+            break;
+        } else if (has_label(&l, "RINEX VERSION / TYPE")) {
+            double ver = field(&l, 0, 9);
+            if (ver < 2.0 || ver >= 4.0) {
+                return RINEX_ERR_VERSION;
+            }
+            nav->version = (int) ver;
+            if (nav->version == 2 && column(&l, 20) != 'N') {
+                return RINEX_ERR_TYPE;
+            }
+            if (nav->version == 3 && column(&l, 20) != 'N' && column(&l, 40) != 'G') {
+                return RINEX_ERR_TYPE;
+            }
+            ion = (nav->version == 2) ? 2 : 5;
+        } else if (has_label(&l, "PGM / RUN BY / DATE")) {
+            memcpy(nav->date, l.p + 40, 20); // Label check ensures the length
+            nav->date[20] = 0;
+        } else if ((has_label(&l, "ION ALPHA")) || (has_label(&l, "IONOSPHERIC CORR") && memcmp(l.p, "GPSA", 4) == 0)) {
+            ionoutc->alpha0 = field(&l, ion, 12);
+            ionoutc->alpha1 = field(&l, ion + 12, 12);
+            ionoutc->alpha2 = field(&l, ion + 24, 12);
+            ionoutc->alpha3 = field(&l, ion + 36, 12);
+            flags |= 0x1;
+        } else if ((has_label(&l, "ION BETA")) || (has_label(&l, "IONOSPHERIC CORR") && memcmp(l.p, "GPSB", 4) == 0)) {
+            ionoutc->beta0 = field(&l, ion, 12);
+            ionoutc->beta1 = field(&l, ion + 12, 12);
+            ionoutc->beta2 = field(&l, ion + 24, 12);
+            ionoutc->beta3 = field(&l, ion + 36, 12);
+            flags |= 0x1 << 1;
+        } else if (has_label(&l, "DELTA-UTC")) {
+            ionoutc->A0 = field(&l, 3, 19);
+            ionoutc->A1 = field(&l, 22, 19);
+            ionoutc->tot = ifield(&l, 41, 9);
+            ionoutc->wnt = ifield(&l, 50, 9);
+            if (ionoutc->tot % 4096 == 0)
+                flags |= 0x1 << 2;
+        } else if (has_label(&l, "TIME SYSTEM CORR") && memcmp(l.p, "GPUT", 4) == 0) {
+            ionoutc->A0 = field(&l, 5, 17);
+            ionoutc->A1 = field(&l, 22, 16);
+            ionoutc->tot = ifield(&l, 38, 7);
+            ionoutc->wnt = ifield(&l, 45, 6);
+            if (ionoutc->tot % 4096 == 0)
+                flags |= 0x1 << 2;
+        } else if (has_label(&l, "LEAP SECONDS")) {
+            ionoutc->dtls = ifield(&l, 0, 6);
+            flags |= 0x1 << 3;
+        }
+    }
+
+    if (nav->version == 0) {
+        return RINEX_ERR_VERSION;
+    }
+    ionoutc->vflg = (flags == 0xF); // Read all Iono/UTC lines
+    return 0;
+}
+
+static ephem_t *append(rinex_nav_t *nav) {
+    if (nav->count == nav->capacity) {
+        size_t cap = (nav->capacity > 0) ? nav->capacity * 2 : 1024;
+        ephem_t *tmp = realloc(nav->eph, cap * sizeof (ephem_t));
+        if (tmp == NULL) {
+            return NULL;
+        }
+        nav->eph = tmp;
+        nav->capacity = cap;
+    }
+    return &nav->eph[nav->count];
+}
+
+// Decode one record, the SV/EPOCH/SV CLK line followed by the broadcast orbit lines.
+static void decode_record(ephem_t *eph, const line_t *l, int prn, bool v3) {
+    // Data fields are four columns of 19, indented by 3 in v2 and 4 in v3
+    const size_t c0 = v3 ? 4 : 3;
+    const size_t c1 = c0 + 19, c2 = c0 + 38, c3 = c0 + 57;
+
+    memset(eph, 0, sizeof (*eph));
+    eph->prn = prn;
+    if (v3) {
+        eph->t.y = ifield(&l[0], 4, 4);
+        eph->t.m = ifield(&l[0], 9, 2);
+        eph->t.d = ifield(&l[0], 12, 2);
+        eph->t.hh = ifield(&l[0], 15, 2);
+        eph->t.mm = ifield(&l[0], 18, 2);
+        eph->t.sec = (double) ifield(&l[0], 21, 2);
+    } else {
+        eph->t.y = ifield(&l[0], 3, 2) + 2000;
+        eph->t.m = ifield(&l[0], 6, 2);
+        eph->t.d = ifield(&l[0], 9, 2);
+        eph->t.hh = ifield(&l[0], 12, 2);
+        eph->t.mm = ifield(&l[0], 15, 2);
+        eph->t.sec = field(&l[0], 18, 2);
+    }
+    date2gps(&eph->t, &eph->toc);
+
+    // SV CLK
+    eph->af0 = field(&l[0], c1, 19);
+    eph->af1 = field(&l[0], c2, 19);
+    eph->af2 = field(&l[0], c3, 19);
+    // BROADCAST ORBIT - 1
+    eph->iode = (int) field(&l[1], c0, 19);
+    eph->crs = field(&l[1], c1, 19);
+    eph->deltan = field(&l[1], c2, 19);
+    eph->m0 = field(&l[1], c3, 19);
+    // BROADCAST ORBIT - 2
+    eph->cuc = field(&l[2], c0, 19);
+    eph->ecc = field(&l[2], c1, 19);
+    eph->cus = field(&l[2], c2, 19);
+    eph->sqrta = field(&l[2], c3, 19);
+    // BROADCAST ORBIT - 3
+    eph->toe.sec = field(&l[3], c0, 19);
+    eph->cic = field(&l[3], c1, 19);
+    eph->omg0 = field(&l[3], c2, 19);
+    eph->cis = field(&l[3], c3, 19);
+    // BROADCAST ORBIT - 4
+    eph->inc0 = field(&l[4], c0, 19);
+    eph->crc = field(&l[4], c1, 19);
+    eph->aop = field(&l[4], c2, 19);
+    eph->omgdot = field(&l[4], c3, 19);
+    // BROADCAST ORBIT - 5
+    eph->idot = field(&l[5], c0, 19);
+    eph->code = (int) field(&l[5], c1, 19);
+    eph->toe.week = (int) field(&l[5], c2, 19);
+    eph->flag = (int) field(&l[5], c3, 19);
+    // BROADCAST ORBIT - 6
+    eph->sva = (int) field(&l[6], c0, 19);
+    eph->svh = (int) field(&l[6], c1, 19);
+    if ((eph->svh > 0) && (eph->svh < 32))
+        eph->svh += 32; // Set MSB to 1
+    eph->tgd = field(&l[6], c2, 19);
+    eph->iodc = (int) field(&l[6], c3, 19);
+    // BROADCAST ORBIT - 7
+    // Transmission time is seconds into the TOE week, unknown taken as TOE
+    double tot = field(&l[7], c0, 19);
+    eph->tot = eph->toe;
+    if (tot > -SECONDS_IN_WEEK && tot < SECONDS_IN_WEEK) {
+        eph->tot.sec = tot;
+        if (tot - eph->toe.sec > SECONDS_IN_WEEK / 2) {
+            eph->tot.week--;
+        } else if (tot - eph->toe.sec < -SECONDS_IN_WEEK / 2) {
+            eph->tot.week++;
+        }
+        if (eph->tot.sec < 0.0) {
+            eph->tot.sec += SECONDS_IN_WEEK;
+            eph->tot.week--;
+        }
+    }
+    eph->fit = field(&l[7], c1, 19);
+
+    // Set valid flag
+    eph->vflg = true;
+
+    // Update the working variables
+    eph->A = eph->sqrta * eph->sqrta;
+    eph->n = sqrt(GM_EARTH / (eph->A * eph->A * eph->A)) + eph->deltan;
+    eph->sq1e2 = sqrt(1.0 - eph->ecc * eph->ecc);
+    eph->omgkdot = eph->omgdot - OMEGA_EARTH;
+}
+
+int rinex_read(const char *fname, rinex_nav_t *nav, ionoutc_t *ionoutc) {
+    size_t size = 0;
+    char *buf = read_file(fname, &size);
+    if (buf == NULL) {
+        return RINEX_ERR_OPEN;
+    }
+
+    const char *pos = buf;
+    const char *end = buf + size;
+    int ret = read_header(&pos, end, nav, ionoutc);
+    if (ret < 0) {
+        free(buf);
+        return ret;
+    }
+
+    bool v3 = (nav->version == 3);
+    int count = 0;
+    line_t l[RINEX_ORBIT_LINES + 1];
+    while (next_line(&pos, end, &l[0])) {
+        // v3 files may mix constellations, GPS records start with 'G'
+        if (v3 ? (l[0].len == 0 || l[0].p[0] != 'G') : (l[0].len < 22)) {
+            continue;
+        }
+        int i;
+        for (i = 1; i <= RINEX_ORBIT_LINES && next_line(&pos, end, &l[i]); i++) {
+        }
+        if (i <= RINEX_ORBIT_LINES) {
+            break; // Truncated record
+        }
+        int prn = ifield(&l[0], v3 ? 1 : 0, 2);
+        if (prn < 1 || prn > MAX_SAT) {
+            continue;
+        }
+        ephem_t *eph = append(nav);
+        if (eph == NULL) {
+            break;
+        }
+        decode_record(eph, l, prn, v3);
+        nav->count++;
+        count++;
+    }
+
+    free(buf);
+    return count;
+}
+
+void rinex_free(rinex_nav_t *nav) {
+    free(nav->eph);
+    nav->eph = NULL;
+    nav->count = 0;
+    nav->capacity = 0;
+}
@@ -0,0 +1,41 @@
+/**
+ * multi-sdr-gps-sim generates a IQ data stream on-the-fly to simulate a
+ * GPS L1 baseband signal using a SDR platform like HackRF or ADLAM-Pluto.
+ *
+ * This file is part of the Github project at
+ * https://github.com/mictronics/multi-sdr-gps-sim.git
+ *
+ * Copyright © 2021 Mictronics
+ * Distributed under the MIT License.
+ *
+ */
+
+#ifndef RINEX_H
+#define RINEX_H
+
+#include <stddef.h>
+#include "gps.h"
+
+#define RINEX_ERR_OPEN (-1) /* File not readable */
+#define RINEX_ERR_VERSION (-2) /* Neither RINEX v2 nor v3 */
+#define RINEX_ERR_TYPE (-3) /* No GPS navigation data */
+
+/* GPS navigation data of one or more RINEX files */
+typedef struct {
+    ephem_t *eph; /* Ephemerides in file order */
+    size_t count;
+    size_t capacity;
+    int version; /* RINEX major version of the last file read */
+    char date[21]; /* PGM / RUN BY / DATE of the last file read */
+} rinex_nav_t;
+
+/* Read a RINEX v2 or v3 navigation file, plain or gzip compressed. The
+ * version is taken from the header. GPS ephemerides are appended to nav,
+ * iono/UTC parameters present in the header are stored in ionoutc.
+ * Returns the number of ephemerides read or a RINEX_ERR_* code. */
+int rinex_read(const char *fname, rinex_nav_t *nav, ionoutc_t *ionoutc);
+
+/* Release the ephemerides of nav. */
+void rinex_free(rinex_nav_t *nav);
+
+#endif /* RINEX_H */
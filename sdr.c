@@ -11,9 +11,12 @@
  */
 
 #include "gui.h"
+#include "fifo.h"
 #include "sdr_hackrf.h"
 #include "sdr_iqfile.h"
 #include "sdr_pluto.h"
+#include "sdr_net.h"
+#include "sdr_stdout.h"
 #include "sdr.h"
 
 static int no_init(void);
@@ -23,26 +26,32 @@ static int no_set_gain(const int);
 
 typedef struct {
     int (*init)();
+    int (*init_tap)(); // Attach as additional FIFO consumer, NULL if not supported
     void (*close)();
     int (*run)();
     int (*set_gain)(const int);
+    unsigned (*delay_ms)(); // Buffered behind the FIFO, NULL if nothing
     const char *name;
     sdr_type_t sdr_type;
 } sdr_handler;
 
 static sdr_type_t current_type = SDR_NONE;
+static sdr_type_t tap_types[FIFO_MAX_CONSUMERS - 1]; // Additional sinks fed by the same FIFO
+static int tap_count = 0;
 
 static sdr_handler sdr_handlers[] = {
-    { no_init, no_close, no_run, no_set_gain, "none", SDR_NONE},
-    { sdr_iqfile_init, sdr_iqfile_close, sdr_iqfile_run, no_set_gain, "iqfile", SDR_IQFILE},
+    { no_init, NULL, no_close, no_run, no_set_gain, NULL, "none", SDR_NONE},
+    { sdr_iqfile_init, sdr_iqfile_init_tap, sdr_iqfile_close, sdr_iqfile_run, no_set_gain, NULL, "iqfile", SDR_IQFILE},
+    { sdr_net_init, sdr_net_init_tap, sdr_net_close, sdr_net_run, no_set_gain, NULL, "net", SDR_NET},
+    { sdr_stdout_init, sdr_stdout_init_tap, sdr_stdout_close, sdr_stdout_run, no_set_gain, NULL, "stdout", SDR_STDOUT},
 #ifdef ENABLE_HACKRFSDR
-    { sdr_hackrf_init, sdr_hackrf_close, sdr_hackrf_run, sdr_hackrf_set_gain, "hackrf", SDR_HACKRF},
+    { sdr_hackrf_init, NULL, sdr_hackrf_close, sdr_hackrf_run, sdr_hackrf_set_gain, sdr_hackrf_delay_ms, "hackrf", SDR_HACKRF},
 #endif
 
 #ifdef ENABLE_PLUTOSDR
-    { sdr_pluto_init, sdr_pluto_close, sdr_pluto_run, sdr_pluto_set_gain, "plutosdr", SDR_PLUTOSDR},
+    { sdr_pluto_init, NULL, sdr_pluto_close, sdr_pluto_run, sdr_pluto_set_gain, sdr_pluto_delay_ms, "plutosdr", SDR_PLUTOSDR},
 #endif
-    { NULL, NULL, NULL, NULL, NULL, SDR_NONE} /* must come last */
+    { NULL, NULL, NULL, NULL, NULL, NULL, NULL, SDR_NONE} /* must come last */
 };
 
 static int no_init() {
@@ -65,9 +74,9 @@ static int no_set_gain(const int gain) {
     return -100;
 }
 
-static sdr_handler *current_handler(void) {
+static sdr_handler *find_handler(sdr_type_t type) {
     for (int i = 0; sdr_handlers[i].name; ++i) {
-        if (current_type == sdr_handlers[i].sdr_type) {
+        if (type == sdr_handlers[i].sdr_type) {
             return &sdr_handlers[i];
         }
     }
@@ -75,25 +84,73 @@ static sdr_handler *current_handler(void) {
     return &sdr_handlers[0];
 }
 
-int sdr_init(simulator_t *simulator) {
+static sdr_handler *current_handler(void) {
+    return find_handler(current_type);
+}
+
+static sdr_type_t type_by_name(const char *name) {
     for (int i = 0; sdr_handlers[i].name; ++i) {
-        if (!strcasecmp(sdr_handlers[i].name, simulator->sdr_name)) {
-            current_type = sdr_handlers[i].sdr_type;
-            simulator->sdr_type = sdr_handlers[i].sdr_type;
+        if (!strcasecmp(sdr_handlers[i].name, name)) {
+            return sdr_handlers[i].sdr_type;
+        }
+    }
+    return SDR_NONE;
+}
+
+int sdr_init(simulator_t *simulator) {
+    // The radio name is a comma separated list. The first SDR type is the
+    // primary sink, all further types are fed with the same IQ buffers.
+    char *names = strdup((simulator->sdr_name != NULL) ? simulator->sdr_name : "none");
+    char *saveptr = NULL;
+    char *name = strtok_r(names, ",", &saveptr);
+
+    current_type = (name != NULL) ? type_by_name(name) : SDR_NONE;
+    simulator->sdr_type = current_type;
+
+    int ret = current_handler()->init(simulator);
+    if (ret == 0 && !fifo_is_locked()) {
+        gui_status_wprintw(YELLOW, "Unable to lock IQ buffers in memory, check RLIMIT_MEMLOCK.\n");
+    }
+
+    while (ret == 0 && (name = strtok_r(NULL, ",", &saveptr)) != NULL) {
+        sdr_handler *tap = find_handler(type_by_name(name));
+        if (tap->init_tap == NULL || tap_count >= FIFO_MAX_CONSUMERS - 1) {
+            gui_status_wprintw(RED, "SDR type %s can't be used as additional sink.\n", name);
+            ret = -1;
+        } else {
+            ret = tap->init_tap(simulator);
+            if (ret == 0) {
+                tap_types[tap_count++] = tap->sdr_type;
+            }
         }
     }
 
-    return current_handler()->init(simulator);
+    free(names);
+    return ret;
 }
 
 void sdr_close(void) {
+    // Taps first, the primary sink finally destroys the FIFO.
+    for (int i = 0; i < tap_count; i++) {
+        find_handler(tap_types[i])->close();
+    }
     current_handler()->close();
 }
 
 int sdr_run(void) {
+    for (int i = 0; i < tap_count; i++) {
+        if (find_handler(tap_types[i])->run() != 0) {
+            return -1;
+        }
+    }
     return current_handler()->run();
 }
 
 int sdr_set_gain(const int gain) {
     return current_handler()->set_gain(gain);
-}
\ No newline at end of file
+}
+
+unsigned sdr_get_delay_ms(void) {
+    sdr_handler *h = current_handler();
+    return (h->delay_ms != NULL) ? h->delay_ms() : 0;
+}
@@ -32,11 +32,15 @@
 // Fixed to 4 * 8192 = 262144 bytes
 // Defined in libhackrf, hackrf.c
 #define HACKRF_TRANSFER_BUFFER_SIZE 262144
+#define HACKRF_RING_SIZE (NUM_FIFO_BUFFERS + 1) // Transfer blocks, one per FIFO buffer and the one sent last
+#define HACKRF_USB_TRANSFERS 4 // Transfers libhackrf keeps queued on USB
 
 int sdr_init(simulator_t *simulator);
 void sdr_close(void);
 int sdr_run(void);
 int sdr_set_gain(int gain);
+// Time the primary sink holds behind the FIFO until samples go out, in ms
+unsigned sdr_get_delay_ms(void);
 
 #endif /* SDR_H */
 
@@ -18,6 +18,8 @@
 #include <sys/types.h> 
 /* for PRIX64 */
 #include <inttypes.h>
+#include <string.h>
+#include <semaphore.h>
 #include <hackrf.h>
 #include "gui.h"
 #include "fifo.h"
@@ -28,6 +30,46 @@ static hackrf_device_list_t *list;
 static hackrf_device* device;
 static const int gui_y_offset = 4;
 static const int gui_x_offset = 2;
+static simulator_t *scenario;
+
+// Transfer blocks for the libusb callback. The generator renders into the
+// slot at fill through the FIFO acquire hook, the slot is ready at head once
+// enqueued and the callback sends from tail; all indices only grow. The slot
+// sent last stays intact for repeats. With one slot per FIFO buffer on top,
+// a slot is not filled again while a tap may still hold its buffer.
+static struct {
+    signed char *block[HACKRF_RING_SIZE];
+    unsigned fill; // Next slot handed to the generator, producer only
+    atomic_uint head; // Next slot to become ready, written at enqueue
+    atomic_uint tail; // Next slot to send, written by the callback
+    sem_t consumed; // Posted by the callback for every block taken
+} ring;
+static bool tx_started = false;
+static atomic_bool ring_exit = false; // No more blocks will arrive
+static bool underrun_repeat = false;
+
+// FIFO buffer memory is the next ring slot, waits while the callback still
+// has to send it.
+static void *hackrf_acquire(size_t bytes) {
+    if (bytes > HACKRF_TRANSFER_BUFFER_SIZE) {
+        return NULL;
+    }
+    while (ring.fill - atomic_load_explicit(&ring.tail, memory_order_acquire) >= HACKRF_RING_SIZE - 1) {
+        if (ring_exit) {
+            return NULL;
+        }
+        sem_wait(&ring.consumed);
+    }
+    return ring.block[ring.fill++ % HACKRF_RING_SIZE];
+}
+
+// The enqueued buffer is the block at head, ready for the callback.
+static void hackrf_enqueue(const struct iq_buf *buf) {
+    unsigned head = atomic_load_explicit(&ring.head, memory_order_relaxed);
+    if (buf->data8 == ring.block[head % HACKRF_RING_SIZE]) {
+        atomic_store_explicit(&ring.head, head + 1, memory_order_release);
+    }
+}
 
 int sdr_hackrf_init(simulator_t *simulator) {
     int result = HACKRF_SUCCESS;
@@ -42,10 +84,13 @@ int sdr_hackrf_init(simulator_t *simulator) {
     int y = gui_y_offset;
 
     // HackRF wants 8 bit signed samples
-    if (simulator->sample_size == SC16) {
-        gui_status_wprintw(YELLOW, "16 bit sample size requested. Reset to 8 bit with HackRF.\n");
+    if (simulator->iq_format != IQ_FORMAT_CS8) {
+        gui_status_wprintw(YELLOW, "%s sample format requested. Reset to 8 bit with HackRF.\n", iq_format_desc(simulator->iq_format)->name);
     }
     simulator->sample_size = SC08;
+    simulator->iq_format = IQ_FORMAT_CS8;
+    scenario = simulator;
+    underrun_repeat = simulator->underrun_repeat;
 
     result = hackrf_init();
     if (result != HACKRF_SUCCESS) {
@@ -212,17 +257,56 @@ int sdr_hackrf_init(simulator_t *simulator) {
         return -1;
     }
 
+    // The ring holds the blocks, FIFO depth is fixed by it
+    if (simulator->fifo_slack_ms > 0) {
+        gui_status_wprintw(YELLOW, "FIFO slack is set by the HackRF ring.\n");
+        fifo_set_target_slack(0);
+    }
     if (!fifo_create(NUM_FIFO_BUFFERS, HACKRF_TRANSFER_BUFFER_SIZE, sizeof (signed char))) {
         gui_status_wprintw(RED, "Error creating TX fifo!");
         return -1;
     }
+    // Transfers are always sent in full
+    fifo_set_block_align(HACKRF_TRANSFER_BUFFER_SIZE);
+
+    // Ring blocks are touched now, the callback must not fault them in
+    ring.fill = 0;
+    atomic_store(&ring.head, 0);
+    atomic_store(&ring.tail, 0);
+    tx_started = false;
+    ring_exit = false;
+    for (int i = 0; i < HACKRF_RING_SIZE; i++) {
+        ring.block[i] = malloc(HACKRF_TRANSFER_BUFFER_SIZE);
+        if (ring.block[i] == NULL) {
+            gui_status_wprintw(RED, "Error allocating TX ring!");
+            return -1;
+        }
+        memset(ring.block[i], 0, HACKRF_TRANSFER_BUFFER_SIZE);
+    }
+    sem_init(&ring.consumed, 0, 0);
+    fifo_set_acquire_hook(hackrf_acquire);
+    fifo_set_enqueue_hook(hackrf_enqueue);
+    gui_mvwprintw(TRACK, y++, gui_x_offset, "Underrun fill: %s", underrun_repeat ? "repeat last block" : "silence");
 
     return 0;
 }
 
+// Wait up to timeout_ms until the callback took all ready blocks.
+static void ring_drain(int timeout_ms) {
+    while (timeout_ms-- > 0 && atomic_load(&ring.tail) != atomic_load(&ring.head)) {
+        usleep(1000);
+    }
+}
+
 void sdr_hackrf_close(void) {
+    // Send what is left in the ring unless TX never started
+    if (tx_started) {
+        ring_drain(HACKRF_RING_SIZE * 50);
+    }
+    // Release a generator waiting for a free slot
+    ring_exit = true;
+    sem_post(&ring.consumed);
     fifo_halt();
-    fifo_destroy();
     if (device != NULL) {
         hackrf_stop_tx(device);
         hackrf_set_amp_enable(device, 0);
@@ -231,20 +315,40 @@ void sdr_hackrf_close(void) {
     }
     hackrf_device_list_free(list);
     hackrf_exit();
+    fifo_set_acquire_hook(NULL);
+    fifo_set_enqueue_hook(NULL);
+    fifo_destroy();
+    sem_destroy(&ring.consumed);
+    for (int i = 0; i < HACKRF_RING_SIZE; i++) {
+        free(ring.block[i]);
+        ring.block[i] = NULL;
+    }
 }
 
 static int sdr_tx_callback(hackrf_transfer *transfer) {
-    // Get a fifo block
-    struct iq_buf *iq = fifo_dequeue();
-    if (iq != NULL && iq->data8 != NULL) {
-        // Fifo has transfer block size
-        memcpy(transfer->buffer, iq->data8, transfer->valid_length);
-        // Release and free up used block
-        fifo_release(iq);
+    unsigned tail = atomic_load_explicit(&ring.tail, memory_order_relaxed);
+
+    if (tail != atomic_load_explicit(&ring.head, memory_order_acquire)) {
+        memcpy(transfer->buffer, ring.block[tail % HACKRF_RING_SIZE], transfer->valid_length);
+        atomic_store_explicit(&ring.tail, tail + 1, memory_order_release);
+        sem_post(&ring.consumed);
         return 0;
     }
 
-    return -1;
+    if (ring_exit) {
+        return -1; // Stream ended
+    }
+    // Underrun, keep the radio going instead of ending the stream. Once the
+    // source finished the ring running empty is the end of the signal.
+    if (underrun_repeat && tail > 0) {
+        memcpy(transfer->buffer, ring.block[(tail - 1) % HACKRF_RING_SIZE], transfer->valid_length);
+    } else {
+        memset(transfer->buffer, 0, transfer->valid_length);
+    }
+    if (!scenario->gps_thread_exit) {
+        fifo_report_underrun();
+    }
+    return 0;
 }
 
 int sdr_hackrf_run(void) {
@@ -253,7 +357,11 @@ int sdr_hackrf_run(void) {
         return -1;
     }
 
-    fifo_wait_full();
+    // Start with a full ring
+    while (!scenario->gps_thread_exit && atomic_load(&ring.head) < HACKRF_RING_SIZE - 1) {
+        usleep(1000);
+    }
+    tx_started = true;
 
     int result = hackrf_start_tx(device, sdr_tx_callback, NULL);
     if (result != HACKRF_SUCCESS) {
@@ -278,4 +386,13 @@ int sdr_hackrf_set_gain(const int gain) {
     }
 
     return g;
-}
\ No newline at end of file
+}
+
+// Ready ring blocks and the transfers on USB once started
+unsigned sdr_hackrf_delay_ms(void) {
+    unsigned blocks = atomic_load(&ring.head) - atomic_load(&ring.tail);
+    if (tx_started) {
+        blocks += HACKRF_USB_TRANSFERS;
+    }
+    return (unsigned) (blocks * (HACKRF_TRANSFER_BUFFER_SIZE / 2) * 1000.0 / TX_SAMPLERATE);
+}
@@ -10,68 +10,285 @@
  *
  */
 
+#include <stdio.h>
+#include <string.h>
 #include "gui.h"
 #include "sdr.h"
 #include "sdr_iqfile.h"
 #include "fifo.h"
+#include "iowriter.h"
+#include "iqmap.h"
+#include "iqarchive.h"
 
 static atomic_bool iqfile_thread_exit = false;
 static pthread_t iqfile_thread;
 static int sample_size = SC08;
+static int consumer = 0; // FIFO consumer id, non-zero when recording as tap
+static uint64_t prealloc_size = 0; // Expected file size, 0 if unknown
+static bool use_mmap = false; // Generator writes straight into the mapped file
+static bool use_archive = false; // Data is written as compressed chunk archive
+static uint64_t written_size = 0; // Bytes of IQ data in the file
+static const char *file_name = IQFILE_DEFAULT_NAME;
+static const simulator_t *scenario; // Scenario parameters for the metadata
 
 static void *iqfile_thread_ep(void *arg) {
     (void) arg; // Not used
-    FILE *fp = fopen("iqdata.bin", "wb");
+    struct iowriter *w = iowriter_open(file_name, prealloc_size);
 
-    if (fp == NULL) {
+    if (w == NULL) {
         gui_status_wprintw(RED, "Error opening IQ data file.\n");
         pthread_exit(NULL);
     }
+    gui_status_wprintw(GREEN, "IQ file writer: %s\n", iowriter_mode(w));
 
     /* On a multi-core CPU we run the main thread and reader thread on different cores.
-     * Try sticking the main thread to core 3
+     * Try sticking the writer thread to the sink core
      */
-    thread_to_core(3);
+    thread_to_role(CORE_SINK);
     set_thread_name("iqfile-thread");
 
+    bool write_error = false;
     while (!iqfile_thread_exit) {
         // Get a fifo block
-        struct iq_buf *iq = fifo_dequeue();
+        struct iq_buf *iq = fifo_dequeue_consumer(consumer);
         if (iq != NULL) {
-            if (sample_size == sizeof (signed short)) {
-                fwrite(iq->data16, sizeof (signed short), iq->validLength, fp);
-            } else {
-                fwrite(iq->data8, sizeof (signed char), iq->validLength, fp);
-            }
+            // Data is copied into aligned staging buffers, release the block right away
+            write_error |= !iowriter_write(w, fifo_buffer_data(iq), (size_t) iq->validLength * sample_size);
             // Release and free up used block
             fifo_release(iq);
-            if (ferror(fp)) {
+            if (write_error) {
                 gui_status_wprintw(RED, "Error writing IQ data file.\n");
+                break;
             }
         }
     }
-    fclose(fp);
+    written_size = iowriter_size(w);
+    if (!iowriter_close(w) && !write_error) {
+        gui_status_wprintw(RED, "Error writing IQ data file.\n");
+    }
     pthread_exit(NULL);
 }
 
-int sdr_iqfile_init(simulator_t *simulator) {
+// FIFO blocks live in the mapped file, data is complete once dequeued.
+static void *iqmap_thread_ep(void *arg) {
+    (void) arg; // Not used
+
+    thread_to_role(CORE_SINK);
+    set_thread_name("iqfile-thread");
+
+    while (!iqfile_thread_exit) {
+        struct iq_buf *iq = fifo_dequeue();
+        if (iq != NULL) {
+            iqmap_commit((size_t) iq->validLength * sample_size);
+            written_size += (uint64_t) iq->validLength * sample_size;
+            fifo_release(iq);
+        }
+    }
+    pthread_exit(NULL);
+}
+
+// Chunks are compressed on worker threads while the generator keeps rendering.
+static void *iqarchive_thread_ep(void *arg) {
+    (void) arg; // Not used
+
+    thread_to_role(CORE_SINK);
+    set_thread_name("iqfile-thread");
+
+    bool write_error = false;
+    while (!iqfile_thread_exit) {
+        struct iq_buf *iq = fifo_dequeue_consumer(consumer);
+        if (iq != NULL) {
+            write_error |= !iqarchive_write(fifo_buffer_data(iq), (size_t) iq->validLength * sample_size);
+            fifo_release(iq);
+            if (write_error) {
+                gui_status_wprintw(RED, "Error writing IQ archive file.\n");
+                break;
+            }
+        }
+    }
+    written_size = iqarchive_size();
+    pthread_exit(NULL);
+}
+
+static void json_string(FILE *fp, const char *str) {
+    fputc('"', fp);
+    for (; *str != '\0'; str++) {
+        if (*str == '"' || *str == '\\') {
+            fprintf(fp, "\\%c", *str);
+        } else if ((unsigned char) *str < 0x20) {
+            fprintf(fp, "\\u%04x", *str);
+        } else {
+            fputc(*str, fp);
+        }
+    }
+    fputc('"', fp);
+}
+
+// Write SigMF metadata next to the data file, "name.ext" gets "name.sigmf-meta".
+static void write_sigmf_meta(void) {
+    const iq_format_desc_t *fmt = iq_format_desc(scenario->iq_format);
+    const char *base = strrchr(file_name, '/');
+    base = (base != NULL) ? base + 1 : file_name;
+    const char *ext = strrchr(base, '.');
+    size_t stem = (ext != NULL && ext != base) ? (size_t) (ext - file_name) : strlen(file_name);
+    char *meta_name = malloc(stem + sizeof (".sigmf-meta"));
+    if (meta_name == NULL) {
+        return;
+    }
+    memcpy(meta_name, file_name, stem);
+    strcpy(meta_name + stem, ".sigmf-meta");
+
+    FILE *fp = fopen(meta_name, "w");
+    if (fp == NULL) {
+        gui_status_wprintw(RED, "Error writing SigMF metadata %s.\n", meta_name);
+        free(meta_name);
+        return;
+    }
+    fprintf(fp, "{\n  \"global\": {\n");
+    fprintf(fp, "    \"core:datatype\": \"%s\",\n", fmt->sigmf_datatype);
+    fprintf(fp, "    \"core:sample_rate\": %d,\n", TX_SAMPLERATE);
+    fprintf(fp, "    \"core:version\": \"1.0.0\",\n");
+    if (ext == NULL || strcmp(ext, ".sigmf-data") != 0) {
+        // Data file name does not follow SigMF convention
+        fprintf(fp, "    \"core:dataset\": ");
+        json_string(fp, base);
+        fprintf(fp, ",\n");
+    }
+    fprintf(fp, "    \"core:recorder\": \"multi-sdr-gps-sim\",\n");
+    fprintf(fp, "    \"core:description\": \"GPS L1 C/A baseband simulation\",\n");
+    // The ru8 bytes of cs4 only make sense with the packing noted below
+    fprintf(fp, "    \"core:extensions\": [{\"name\": \"gps_sim\", \"version\": \"1.0.0\", \"optional\": %s}],\n",
+            (scenario->iq_format == IQ_FORMAT_CS4) ? "false" : "true");
+    if (use_archive) {
+        fprintf(fp, "    \"gps_sim:container\": \"chunked zlib archive, see iqarchive.h\",\n");
+    }
+    if (scenario->iq_format == IQ_FORMAT_CS4) {
+        fprintf(fp, "    \"gps_sim:datatype\": \"ci4\",\n");
+        fprintf(fp, "    \"gps_sim:packing\": \"one byte per sample, I high nibble, Q low nibble\",\n");
+    }
+    if (scenario->nav_file_count == 1) {
+        fprintf(fp, "    \"gps_sim:nav_file\": ");
+        json_string(fp, scenario->nav_files[0]);
+        fprintf(fp, ",\n");
+    } else if (scenario->nav_file_count > 1) {
+        fprintf(fp, "    \"gps_sim:nav_files\": [");
+        for (size_t i = 0; i < scenario->nav_file_count; i++) {
+            fputs((i > 0) ? ", " : "", fp);
+            json_string(fp, scenario->nav_files[i]);
+        }
+        fprintf(fp, "],\n");
+    }
+    if (scenario->motion_file_name != NULL) {
+        fprintf(fp, "    \"gps_sim:motion_file\": ");
+        json_string(fp, scenario->motion_file_name);
+        fprintf(fp, ",\n");
+    }
+    fprintf(fp, "    \"gps_sim:location\": [%.7f, %.7f, %.2f],\n",
+            scenario->location.lat, scenario->location.lon, scenario->location.height);
+    fprintf(fp, "    \"gps_sim:ionosphere\": %s,\n", scenario->ionosphere_enable ? "true" : "false");
+    fprintf(fp, "    \"gps_sim:duration\": %.1f\n  },\n", (double) written_size / sample_size / iq_format_units(fmt, IQ_BUFFER_SIZE) / 10.0);
+    fprintf(fp, "  \"captures\": [\n    {\n      \"core:sample_start\": 0,\n");
+    if (scenario->start_gps.week >= 0) {
+        datetime_t t;
+        gps2date(&scenario->start_gps, &t);
+        fprintf(fp, "      \"gps_sim:gps_week\": %d,\n", scenario->start_gps.week);
+        fprintf(fp, "      \"gps_sim:gps_tow\": %.1f,\n", scenario->start_gps.sec);
+        fprintf(fp, "      \"gps_sim:gps_datetime\": \"%04d-%02d-%02dT%02d:%02d:%06.3f\",\n",
+                t.y, t.m, t.d, t.hh, t.mm, t.sec);
+    }
+    fprintf(fp, "      \"core:frequency\": %d\n    }\n  ],\n", TX_FREQUENCY);
+    fprintf(fp, "  \"annotations\": []\n}\n");
+    if (fclose(fp) != 0) {
+        gui_status_wprintw(RED, "Error writing SigMF metadata %s.\n", meta_name);
+    }
+    free(meta_name);
+}
+
+static bool set_output(simulator_t *simulator) {
+    scenario = simulator;
+    if (simulator->iq_file_name != NULL) {
+        file_name = simulator->iq_file_name;
+    }
+    // FIFO sample units follow the output format
     sample_size = simulator->sample_size;
-    if (!fifo_create(NUM_FIFO_BUFFERS, IQ_BUFFER_SIZE, sample_size)) {
+    prealloc_size = (uint64_t) simulator->duration * iq_format_units(iq_format_desc(simulator->iq_format), IQ_BUFFER_SIZE) * sample_size;
+    if (simulator->iq_archive_level >= 0) {
+        if (!iqarchive_open(file_name, simulator->iq_format, simulator->iq_archive_level)) {
+            gui_status_wprintw(RED, "Error opening IQ archive file.\n");
+            return false;
+        }
+        use_archive = true;
+    }
+    return true;
+}
+
+int sdr_iqfile_init(simulator_t *simulator) {
+    if (!set_output(simulator)) {
+        return -1;
+    }
+    if (!fifo_create(NUM_FIFO_BUFFERS, iq_format_units(iq_format_desc(simulator->iq_format), IQ_BUFFER_SIZE), sample_size)) {
         gui_status_wprintw(RED, "Error creating IQ file fifo!");
         return -1;
     }
+    use_mmap = simulator->iq_mmap && !use_archive;
+    if (simulator->iq_mmap && use_archive) {
+        gui_status_wprintw(YELLOW, "IQ archive is compressed, ignoring memory mapping.\n");
+    }
+    if (use_mmap) {
+        if (!iqmap_open(file_name, prealloc_size)) {
+            gui_status_wprintw(RED, "Error creating mapped IQ data file.\n");
+            return -1;
+        }
+        fifo_set_acquire_hook(iqmap_reserve);
+        gui_status_wprintw(GREEN, "IQ file writer: memory mapped\n");
+    }
+    return 0;
+}
+
+// Record the IQ stream of another sink, e.g. exactly what HackRF transmits.
+int sdr_iqfile_init_tap(simulator_t *simulator) {
+    if (simulator->sdr_type == SDR_IQFILE) {
+        gui_status_wprintw(RED, "IQ file is already the primary sink.\n");
+        return -1;
+    }
+    if (simulator->iq_mmap) {
+        gui_status_wprintw(YELLOW, "IQ file mapping needs iqfile as primary radio, using file writer.\n");
+    }
+    // Use the sample format the primary sink has settled on
+    if (!set_output(simulator)) {
+        return -1;
+    }
+    consumer = fifo_add_consumer();
+    if (consumer < 0) {
+        gui_status_wprintw(RED, "Error attaching IQ file to fifo!\n");
+        return -1;
+    }
     return 0;
 }
 
 void sdr_iqfile_close(void) {
     iqfile_thread_exit = true;
     fifo_halt();
-    fifo_destroy();
     pthread_join(iqfile_thread, NULL);
+    if (use_archive && !iqarchive_close(scenario->start_gps)) {
+        gui_status_wprintw(RED, "Error writing IQ archive file.\n");
+    }
+    write_sigmf_meta();
+    if (use_mmap) {
+        fifo_set_acquire_hook(NULL);
+        if (!iqmap_close()) {
+            gui_status_wprintw(RED, "Error writing IQ data file.\n");
+        }
+    }
+    // The primary sink owns the FIFO
+    if (consumer == 0) {
+        fifo_destroy();
+    }
 }
 
 int sdr_iqfile_run(void) {
     fifo_wait_full();
-    pthread_create(&iqfile_thread, NULL, iqfile_thread_ep, NULL);
+    iqfile_thread_exit = false;
+    pthread_create(&iqfile_thread, NULL, use_mmap ? iqmap_thread_ep : use_archive ? iqarchive_thread_ep : iqfile_thread_ep, NULL);
     return 0;
 }
\ No newline at end of file
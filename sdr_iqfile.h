@@ -13,7 +13,10 @@
 #ifndef SDR_IQFILE_H
 #define SDR_IQFILE_H
 
+#define IQFILE_DEFAULT_NAME "iqdata.bin"
+
 int sdr_iqfile_init(simulator_t *simulator);
+int sdr_iqfile_init_tap(simulator_t *simulator);
 void sdr_iqfile_close(void);
 int sdr_iqfile_run(void);
 
@@ -0,0 +1,609 @@
+/**
+ * multi-sdr-gps-sim generates a IQ data stream on-the-fly to simulate a
+ * GPS L1 baseband signal using a SDR platform like HackRF or ADLAM-Pluto.
+ *
+ * This file is part of the Github project at
+ * https://github.com/mictronics/multi-sdr-gps-sim.git
+ *
+ * Copyright © 2021 Mictronics
+ * Distributed under the MIT License.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include "gui.h"
+#include "sdr.h"
+#include "fifo.h"
+#include "reframer.h"
+#include "timeutil.h"
+#include "sdr_net.h"
+
+#define NET_SOCKET_BUFFER (8 * 1024 * 1024) // Kernel socket buffer size
+#define NET_TCP_CHUNK (64 * 1024) // Receive size for TCP streams
+
+static atomic_bool net_thread_exit = false;
+static pthread_t net_thread;
+static int sock = -1; // Sender socket
+static int rx_sock = -1; // Receiver socket
+static bool use_tcp = false;
+static int sample_size = SC08;
+static int consumer = 0; // FIFO consumer id, non-zero when streaming as tap
+static const simulator_t *scenario;
+
+// Traffic counters, shown once per second
+static atomic_ullong net_packets = 0;
+static atomic_ullong net_bytes = 0;
+static atomic_ullong net_lost = 0; // Datagrams failed to send or missing on receive
+static atomic_ullong net_late = 0; // Datagrams received out of order and dropped
+static atomic_ullong net_restarts = 0; // Sender restarts seen on receive
+
+struct addrinfo *net_resolve(const char *url, const char *default_port, bool *tcp, bool passive) {
+    char host[256];
+    const char *port = default_port;
+    struct addrinfo hints, *res = NULL;
+
+    *tcp = false;
+    if (strncmp(url, "tcp://", 6) == 0) {
+        *tcp = true;
+        url += 6;
+    } else if (strncmp(url, "udp://", 6) == 0) {
+        url += 6;
+    }
+    snprintf(host, sizeof (host), "%s", url);
+    char *h = host;
+    char *colon = strrchr(host, ':');
+    if (host[0] == '[') {
+        // IPv6 literal
+        char *end = strchr(host, ']');
+        if (end == NULL) {
+            return NULL;
+        }
+        *end = '\0';
+        h = host + 1;
+        colon = (end[1] == ':') ? end + 1 : NULL;
+    }
+    if (colon != NULL) {
+        *colon = '\0';
+        port = colon + 1;
+    }
+
+    memset(&hints, 0, sizeof (hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = *tcp ? SOCK_STREAM : SOCK_DGRAM;
+    hints.ai_flags = passive ? AI_PASSIVE : 0;
+    if (getaddrinfo((*h != '\0') ? h : NULL, port, &hints, &res) != 0) {
+        return NULL;
+    }
+    return res;
+}
+
+static void reset_stats(void) {
+    net_packets = 0;
+    net_bytes = 0;
+    net_lost = 0;
+    net_late = 0;
+    net_restarts = 0;
+}
+
+static void show_stats(const char *dir, struct timespec *last, uint64_t *last_bytes) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double dt = (double) (now.tv_sec - last->tv_sec) + (double) (now.tv_nsec - last->tv_nsec) / 1e9;
+    if (dt < 1.0) {
+        return;
+    }
+    gui_mvwprintw(LS_FIX, 20, 40, "Network:         %s %6.1fMbit/s pkts %llu lost %llu late %llu  ",
+            dir, (double) (net_bytes - *last_bytes) * 8.0 / 1e6 / dt,
+            (unsigned long long) net_packets, (unsigned long long) net_lost, (unsigned long long) net_late);
+    *last = now;
+    *last_bytes = net_bytes;
+}
+
+static double bytes_per_sec(void) {
+    return (double) iq_format_units(iq_format_desc(scenario->iq_format), IQ_BUFFER_SIZE) * sample_size * 10.0;
+}
+
+static void fill_header(net_header_t *h, uint32_t seq, uint64_t offset, size_t len) {
+    h->magic = NET_MAGIC;
+    h->seq = seq;
+    h->format = (uint32_t) scenario->iq_format;
+    h->len = (uint32_t) len;
+    h->reserved = 0;
+    h->gps_week = scenario->start_gps.week;
+    h->gps_sec = scenario->start_gps.sec + (double) offset / bytes_per_sec();
+    if (h->gps_week >= 0 && h->gps_sec >= SECONDS_IN_WEEK) {
+        h->gps_week++;
+        h->gps_sec -= SECONDS_IN_WEEK;
+    }
+}
+
+static bool send_all(int fd, struct iovec *iov, int count) {
+    struct msghdr msg;
+    memset(&msg, 0, sizeof (msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = (size_t) count;
+
+    while (msg.msg_iovlen > 0) {
+        ssize_t n = sendmsg(fd, &msg, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        // Skip what went out, partial writes happen on TCP
+        while (n > 0 && msg.msg_iovlen > 0) {
+            if ((size_t) n >= msg.msg_iov->iov_len) {
+                n -= (ssize_t) msg.msg_iov->iov_len;
+                msg.msg_iov++;
+                msg.msg_iovlen--;
+            } else {
+                msg.msg_iov->iov_base = (char *) msg.msg_iov->iov_base + n;
+                msg.msg_iov->iov_len -= (size_t) n;
+                n = 0;
+            }
+        }
+    }
+    return true;
+}
+
+static void send_batch(struct mmsghdr *msg, int count) {
+    int sent = 0;
+    while (sent < count) {
+        int n = sendmmsg(sock, msg + sent, (unsigned) (count - sent), 0);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            // E.g. no receiver listening, drop this datagram
+            net_lost++;
+            sent++;
+            continue;
+        }
+        for (int i = sent; i < sent + n; i++) {
+            net_bytes += msg[i].msg_len - sizeof (net_header_t);
+        }
+        net_packets += (uint64_t) n;
+        sent += n;
+    }
+}
+
+// FIFO blocks are cut into datagrams of fixed size, the tail of a block is
+// carried into the next datagram.
+static void *udp_thread_ep(void *arg) {
+    (void) arg; // Not used
+    static net_header_t hdr[NET_BATCH];
+    static struct iovec iov[NET_BATCH][3];
+    static struct mmsghdr msg[NET_BATCH];
+    unsigned char carry[NET_UDP_PAYLOAD];
+    size_t carry_len = 0;
+    uint32_t seq = 0;
+    uint64_t offset = 0; // Bytes of IQ data sent
+    struct timespec t0, last;
+    uint64_t last_bytes = 0;
+
+    thread_to_role(CORE_SINK);
+    set_thread_name("net-thread");
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    last = t0;
+    while (!net_thread_exit) {
+        struct iq_buf *iq = fifo_dequeue_consumer(consumer);
+        if (iq == NULL) {
+            continue;
+        }
+        const unsigned char *p = fifo_buffer_data(iq);
+        size_t len = (size_t) iq->validLength * sample_size;
+
+        while (carry_len + len >= NET_UDP_PAYLOAD) {
+            int n = 0;
+            for (; n < NET_BATCH && carry_len + len >= NET_UDP_PAYLOAD; n++) {
+                int k = 0;
+                fill_header(&hdr[n], seq++, offset, NET_UDP_PAYLOAD);
+                iov[n][k].iov_base = &hdr[n];
+                iov[n][k++].iov_len = sizeof (net_header_t);
+                if (carry_len > 0) {
+                    iov[n][k].iov_base = carry;
+                    iov[n][k++].iov_len = carry_len;
+                }
+                size_t take = NET_UDP_PAYLOAD - carry_len;
+                iov[n][k].iov_base = (void *) p;
+                iov[n][k++].iov_len = take;
+                p += take;
+                len -= take;
+                carry_len = 0;
+                offset += NET_UDP_PAYLOAD;
+                memset(&msg[n], 0, sizeof (msg[n]));
+                msg[n].msg_hdr.msg_iov = iov[n];
+                msg[n].msg_hdr.msg_iovlen = (size_t) k;
+            }
+            send_batch(msg, n);
+        }
+        memcpy(carry + carry_len, p, len);
+        carry_len += len;
+        fifo_release(iq);
+
+        // Nothing slows down a UDP sender, keep close to real time
+        double t = (double) offset / bytes_per_sec() - NET_UDP_LEAD;
+        if (t > 0.0) {
+            sleep_until(&t0, t);
+        }
+        show_stats("tx", &last, &last_bytes);
+    }
+
+    // Short final datagram
+    if (carry_len > 0) {
+        fill_header(&hdr[0], seq, offset, carry_len);
+        iov[0][0].iov_base = &hdr[0];
+        iov[0][0].iov_len = sizeof (net_header_t);
+        iov[0][1].iov_base = carry;
+        iov[0][1].iov_len = carry_len;
+        memset(&msg[0], 0, sizeof (msg[0]));
+        msg[0].msg_hdr.msg_iov = iov[0];
+        msg[0].msg_hdr.msg_iovlen = 2;
+        send_batch(msg, 1);
+    }
+    pthread_exit(NULL);
+}
+
+// One record per FIFO block, TCP flow control paces the generator.
+static void *tcp_thread_ep(void *arg) {
+    (void) arg; // Not used
+    net_header_t hdr;
+    uint32_t seq = 0;
+    uint64_t offset = 0;
+    bool connected = true;
+    struct timespec last;
+    uint64_t last_bytes = 0;
+
+    thread_to_role(CORE_SINK);
+    set_thread_name("net-thread");
+
+    clock_gettime(CLOCK_MONOTONIC, &last);
+    while (!net_thread_exit) {
+        struct iq_buf *iq = fifo_dequeue_consumer(consumer);
+        if (iq == NULL) {
+            continue;
+        }
+        size_t len = (size_t) iq->validLength * sample_size;
+        if (connected) {
+            fill_header(&hdr, seq++, offset, len);
+            struct iovec iov[2] = {
+                {&hdr, sizeof (hdr)},
+                {fifo_buffer_data(iq), len}
+            };
+            connected = send_all(sock, iov, 2);
+            if (connected) {
+                net_packets++;
+                net_bytes += len;
+            } else {
+                // Keep draining so other sinks are not stalled
+                gui_status_wprintw(RED, "Network connection lost.\n");
+            }
+        }
+        if (!connected) {
+            net_lost++;
+        }
+        offset += len;
+        fifo_release(iq);
+        show_stats("tx", &last, &last_bytes);
+    }
+    pthread_exit(NULL);
+}
+
+static bool set_output(simulator_t *simulator) {
+    bool tcp;
+
+    scenario = simulator;
+    sample_size = simulator->sample_size;
+    reset_stats();
+    if (simulator->net_url == NULL) {
+        gui_status_wprintw(RED, "Network sink needs a destination, use --net.\n");
+        return false;
+    }
+    struct addrinfo *res = net_resolve(simulator->net_url, NET_DEFAULT_PORT, &tcp, false);
+    if (res == NULL) {
+        gui_status_wprintw(RED, "Unable to resolve %s.\n", simulator->net_url);
+        return false;
+    }
+    use_tcp = tcp;
+    for (struct addrinfo *ai = res; ai != NULL; ai = ai->ai_next) {
+        sock = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (sock < 0) {
+            continue;
+        }
+        int size = NET_SOCKET_BUFFER;
+        setsockopt(sock, SOL_SOCKET, SO_SNDBUF, &size, sizeof (size));
+        // Connected UDP socket, sendmmsg needs no addresses
+        if (connect(sock, ai->ai_addr, ai->ai_addrlen) == 0) {
+            break;
+        }
+        close(sock);
+        sock = -1;
+    }
+    freeaddrinfo(res);
+    if (sock < 0) {
+        gui_status_wprintw(RED, "Unable to connect to %s.\n", simulator->net_url);
+        return false;
+    }
+    gui_status_wprintw(GREEN, "Streaming %s over %s to %s.\n",
+            iq_format_desc(simulator->iq_format)->name, use_tcp ? "TCP" : "UDP", simulator->net_url);
+    return true;
+}
+
+int sdr_net_init(simulator_t *simulator) {
+    if (!set_output(simulator)) {
+        return -1;
+    }
+    if (!fifo_create(NUM_FIFO_BUFFERS, iq_format_units(iq_format_desc(simulator->iq_format), IQ_BUFFER_SIZE), sample_size)) {
+        gui_status_wprintw(RED, "Error creating network fifo!\n");
+        return -1;
+    }
+    return 0;
+}
+
+// Stream the IQ data of another sink, e.g. what the local radio transmits.
+int sdr_net_init_tap(simulator_t *simulator) {
+    if (simulator->sdr_type == SDR_NET) {
+        gui_status_wprintw(RED, "Network is already the primary sink.\n");
+        return -1;
+    }
+    if (!set_output(simulator)) {
+        return -1;
+    }
+    consumer = fifo_add_consumer();
+    if (consumer < 0) {
+        gui_status_wprintw(RED, "Error attaching network to fifo!\n");
+        return -1;
+    }
+    return 0;
+}
+
+void sdr_net_close(void) {
+    net_thread_exit = true;
+    fifo_halt();
+    pthread_join(net_thread, NULL);
+    if (sock >= 0) {
+        close(sock);
+        sock = -1;
+    }
+    // The primary sink owns the FIFO
+    if (consumer == 0) {
+        fifo_destroy();
+    }
+}
+
+int sdr_net_run(void) {
+    fifo_wait_full();
+    pthread_create(&net_thread, NULL, use_tcp ? tcp_thread_ep : udp_thread_ep, NULL);
+    return 0;
+}
+
+static bool check_header(const net_header_t *h, size_t len, simulator_t *simulator, bool *first) {
+    // Foreign or corrupt packets are dropped
+    if (h->magic != NET_MAGIC || h->len != len || h->format >= IQ_FORMAT_COUNT) {
+        return false;
+    }
+    if (h->format != (uint32_t) simulator->iq_format) {
+        if (*first) {
+            gui_status_wprintw(RED, "Network stream is %s, radio needs %s.\n",
+                    iq_format_desc((iq_format_t) h->format)->name, iq_format_desc(simulator->iq_format)->name);
+        }
+        simulator->gps_thread_exit = true;
+        return false;
+    }
+    if (*first && h->gps_week >= 0) {
+        simulator->start_gps.week = h->gps_week;
+        simulator->start_gps.sec = h->gps_sec;
+    }
+    *first = false;
+    return true;
+}
+
+static void receive_udp(reframer_t *rf, simulator_t *simulator) {
+    static unsigned char buf[NET_BATCH][sizeof (net_header_t) + NET_UDP_PAYLOAD];
+    static struct iovec iov[NET_BATCH];
+    static struct mmsghdr msg[NET_BATCH];
+    uint32_t expect = 0;
+    bool first = true;
+    struct timespec last, rx, last_rx = {0, 0};
+    uint64_t last_bytes = 0;
+
+    for (int i = 0; i < NET_BATCH; i++) {
+        iov[i].iov_base = buf[i];
+        iov[i].iov_len = sizeof (buf[i]);
+        memset(&msg[i], 0, sizeof (msg[i]));
+        msg[i].msg_hdr.msg_iov = &iov[i];
+        msg[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &last);
+    bool fifo_open = true;
+    while (!simulator->gps_thread_exit && fifo_open) {
+        int n = recvmmsg(rx_sock, msg, NET_BATCH, MSG_WAITFORONE, NULL);
+        clock_gettime(CLOCK_MONOTONIC, &rx);
+        for (int i = 0; i < n; i++) {
+            const net_header_t *h = (const net_header_t *) buf[i];
+            size_t len = msg[i].msg_len - sizeof (net_header_t);
+            if (msg[i].msg_len < sizeof (net_header_t) || !check_header(h, len, simulator, &first)) {
+                continue;
+            }
+            if (net_packets == 0) {
+                expect = h->seq;
+            }
+            int32_t gap = (int32_t) (h->seq - expect);
+            // A sequence far behind the expected one, or any step back
+            // after the sender was silent, comes from a restarted sender,
+            // follow it. A small step back is a reordered datagram.
+            if (gap < 0) {
+                double silent = (double) (rx.tv_sec - last_rx.tv_sec) + (double) (rx.tv_nsec - last_rx.tv_nsec) / 1e9;
+                if (-gap <= NET_RESYNC && silent < NET_RESYNC_GAP) {
+                    net_late++;
+                    continue;
+                }
+                net_restarts++;
+                gap = 0;
+            }
+            if (gap > 0) {
+                // Keep sample timing, fill lost datagrams with silence
+                net_lost += (uint64_t) gap;
+                fifo_open = reframer_write(rf, NULL, (size_t) gap * NET_UDP_PAYLOAD);
+            }
+            expect = h->seq + 1;
+            last_rx = rx;
+            net_packets++;
+            net_bytes += len;
+            fifo_open = reframer_write(rf, buf[i] + sizeof (net_header_t), len);
+        }
+        show_stats("rx", &last, &last_bytes);
+    }
+}
+
+// Receive exactly len bytes, false on end of stream or exit.
+static bool recv_all(int fd, void *buf, size_t len, const simulator_t *simulator) {
+    while (len > 0 && !simulator->gps_thread_exit) {
+        ssize_t n = recv(fd, buf, len, 0);
+        if (n == 0) {
+            return false;
+        }
+        if (n < 0) {
+            if (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK) {
+                continue;
+            }
+            return false;
+        }
+        buf = (char *) buf + n;
+        len -= (size_t) n;
+    }
+    return len == 0;
+}
+
+static void receive_tcp(reframer_t *rf, simulator_t *simulator) {
+    struct pollfd pfd = {rx_sock, POLLIN, 0};
+    net_header_t h;
+    bool first = true;
+    struct timespec last;
+    uint64_t last_bytes = 0;
+    unsigned char *buf = malloc(NET_TCP_CHUNK);
+    int fd = -1;
+
+    // Wait for the sender
+    while (!simulator->gps_thread_exit && fd < 0 && buf != NULL) {
+        if (poll(&pfd, 1, 100) > 0) {
+            fd = accept(rx_sock, NULL, NULL);
+        }
+    }
+    if (fd >= 0) {
+        struct timeval tv = {0, 100000};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof (tv));
+        gui_status_wprintw(GREEN, "Network sender connected.\n");
+    }
+
+    bool fifo_open = true;
+    clock_gettime(CLOCK_MONOTONIC, &last);
+    while (fd >= 0 && fifo_open && recv_all(fd, &h, sizeof (h), simulator)) {
+        if (!check_header(&h, h.len, simulator, &first) || h.len % sample_size != 0) {
+            gui_status_wprintw(RED, "Invalid network stream.\n");
+            break;
+        }
+        net_packets++;
+        for (size_t left = h.len; left > 0 && fifo_open;) {
+            size_t n = (left < NET_TCP_CHUNK) ? left : NET_TCP_CHUNK;
+            if (!recv_all(fd, buf, n, simulator)) {
+                left = 0;
+                break;
+            }
+            net_bytes += n;
+            fifo_open = reframer_write(rf, buf, n);
+            left -= n;
+        }
+        show_stats("rx", &last, &last_bytes);
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    free(buf);
+}
+
+void *net_source_thread_ep(void *arg) {
+    simulator_t *simulator = (simulator_t *) (arg);
+    reframer_t rf;
+    bool tcp;
+
+    thread_to_role(CORE_SYNTHESIS);
+    set_thread_name("net-thread");
+
+    sample_size = (int) iq_format_desc(simulator->iq_format)->unit_size;
+    reset_stats();
+    struct addrinfo *res = net_resolve(simulator->net_listen_url, NET_DEFAULT_PORT, &tcp, true);
+    if (res == NULL) {
+        gui_status_wprintw(RED, "Unable to resolve %s.\n", simulator->net_listen_url);
+        goto end_net_thread;
+    }
+    for (struct addrinfo *ai = res; ai != NULL; ai = ai->ai_next) {
+        rx_sock = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (rx_sock < 0) {
+            continue;
+        }
+        int on = 1;
+        int size = NET_SOCKET_BUFFER;
+        setsockopt(rx_sock, SOL_SOCKET, SO_REUSEADDR, &on, sizeof (on));
+        setsockopt(rx_sock, SOL_SOCKET, SO_RCVBUF, &size, sizeof (size));
+        if (bind(rx_sock, ai->ai_addr, ai->ai_addrlen) == 0 && (!tcp || listen(rx_sock, 1) == 0)) {
+            break;
+        }
+        close(rx_sock);
+        rx_sock = -1;
+    }
+    freeaddrinfo(res);
+    if (rx_sock < 0) {
+        gui_status_wprintw(RED, "Unable to listen on %s.\n", simulator->net_listen_url);
+        goto end_net_thread;
+    }
+    // Wake up regularly to check for exit
+    struct timeval tv = {0, 100000};
+    setsockopt(rx_sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof (tv));
+    gui_status_wprintw(GREEN, "Waiting for %s stream on %s.\n", tcp ? "TCP" : "UDP", simulator->net_listen_url);
+
+    simulator->gps_thread_running = true;
+    pthread_cond_signal(&(simulator->gps_init_done));
+
+    if (reframer_init(&rf, iq_format_desc(simulator->iq_format))) {
+        if (tcp) {
+            receive_tcp(&rf, simulator);
+        } else {
+            receive_udp(&rf, simulator);
+        }
+    }
+    if (!simulator->gps_thread_exit) {
+        gui_status_wprintw(GREEN, "Network stream ended\n");
+    }
+
+end_net_thread:
+    if (rx_sock >= 0) {
+        close(rx_sock);
+        rx_sock = -1;
+    }
+    gui_status_wprintw(RED, "Exit network thread\n");
+    simulator->gps_thread_exit = true;
+    pthread_cond_signal(&(simulator->gps_init_done));
+    pthread_exit(NULL);
+}
+
+void net_get_stats(net_stats_t *stats) {
+    stats->packets = net_packets;
+    stats->bytes = net_bytes;
+    stats->lost = net_lost;
+    stats->late = net_late;
+    stats->restarts = net_restarts;
+}
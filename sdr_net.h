@@ -0,0 +1,61 @@
+/**
+ * multi-sdr-gps-sim generates a IQ data stream on-the-fly to simulate a
+ * GPS L1 baseband signal using a SDR platform like HackRF or ADLAM-Pluto.
+ *
+ * This file is part of the Github project at
+ * https://github.com/mictronics/multi-sdr-gps-sim.git
+ *
+ * Copyright © 2021 Mictronics
+ * Distributed under the MIT License.
+ *
+ */
+
+#ifndef SDR_NET_H
+#define SDR_NET_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define NET_MAGIC 0x51495347 // "GSIQ" little endian
+#define NET_DEFAULT_PORT "4950"
+#define NET_UDP_PAYLOAD (1408) // IQ bytes per datagram, fits 1500 byte MTU
+#define NET_BATCH (64) // Datagrams per sendmmsg/recvmmsg call
+#define NET_UDP_LEAD (0.3) // Seconds UDP sender may run ahead of real time
+#define NET_RESYNC (1000) // Sequence step back taken as restart of the sender
+#define NET_RESYNC_GAP (1.0) // Seconds of silence after which any step back is a restart
+
+/* Header in front of each datagram or TCP record, little endian. */
+typedef struct {
+    uint32_t magic;
+    uint32_t seq; /* Packet sequence number */
+    int32_t gps_week; /* GPS time of first sample, week -1 if unknown */
+    uint32_t format; /* iq_format_t */
+    double gps_sec;
+    uint32_t len; /* Bytes of IQ data following */
+    uint32_t reserved;
+} net_header_t;
+
+/* Traffic counters of the network sink or source. */
+typedef struct {
+    uint64_t packets; /* Datagrams or records sent or accepted */
+    uint64_t bytes; /* Bytes of IQ data sent or accepted */
+    uint64_t lost; /* Datagrams failed to send or missing on receive */
+    uint64_t late; /* Datagrams received out of order and dropped */
+    uint64_t restarts; /* Sender restarts, the sequence started over */
+} net_stats_t;
+
+struct addrinfo;
+
+/* Resolve "udp://host:port" or "tcp://host:port", UDP if no scheme is given.
+ * Free the result with freeaddrinfo(). */
+struct addrinfo *net_resolve(const char *url, const char *default_port, bool *tcp, bool passive);
+int sdr_net_init(simulator_t *simulator);
+int sdr_net_init_tap(simulator_t *simulator);
+void sdr_net_close(void);
+int sdr_net_run(void);
+/* Receive a stream from a network sink and feed it to the local radio. */
+void *net_source_thread_ep(void *arg);
+/* Take a snapshot of the traffic counters, may be called from any thread. */
+void net_get_stats(net_stats_t *stats);
+
+#endif /* SDR_NET_H */
@@ -39,31 +39,59 @@ static struct iio_channel *tx0_i = NULL;
 static struct iio_channel *tx0_q = NULL;
 static struct iio_buffer *tx_buffer = NULL;
 static pthread_t pluto_tx_thread;
+static bool zero_copy = false; // Generator renders into the libiio buffer
+static unsigned buffer_samples = NUM_IQ_SAMPLES; // IQ samples per libiio buffer
+static unsigned kernel_buffers; // libiio kernel buffer count
+static atomic_uint pushed; // Buffers pushed, counts up to the kernel buffers
 static const int gui_y_offset = 4;
 static const int gui_x_offset = 2;
 
+// FIFO buffer memory is the libiio buffer to be pushed next. With a FIFO
+// depth of one the previous buffer has been pushed when this is called.
+static void *pluto_acquire(size_t bytes) {
+    if (bytes > (size_t) buffer_samples * 2 * sizeof (int16_t)) {
+        return NULL;
+    }
+    return iio_buffer_first(tx_buffer, tx0_i);
+}
+
+// Scatter into the libiio buffer when I and Q are not interleaved 16 bit pairs.
+static void copy_to_buffer(const struct iq_buf *iq) {
+    char *p_i = (char *) iio_buffer_first(tx_buffer, tx0_i);
+    char *p_q = (char *) iio_buffer_first(tx_buffer, tx0_q);
+    ptrdiff_t step = iio_buffer_step(tx_buffer);
+
+    for (unsigned n = 0; n < iq->validLength / 2; n++) {
+        *(int16_t *) (p_i + n * step) = iq->data16[2 * n];
+        *(int16_t *) (p_q + n * step) = iq->data16[2 * n + 1];
+    }
+}
+
 static void *pluto_tx_thread_ep(void *arg) {
     (void) arg; // Not used
 
-    // Try sticking this thread to core 2
-    thread_to_core(2);
+    // Try sticking this thread to the sink core
+    thread_to_role(CORE_SINK);
     set_thread_name("plutosdr-thread");
 
     int32_t ntx = 0;
-    char *ptx_buffer = (char *) iio_buffer_start(tx_buffer);
 
     while (!pluto_tx_thread_exit) {
         // Get a fifo block
         struct iq_buf *iq = fifo_dequeue();
         if (iq != NULL && iq->data16 != NULL) {
-            // Fifo has transfer block size
-            memcpy(ptx_buffer, iq->data16, iq->validLength * sizeof (signed short));
+            if (!zero_copy) {
+                copy_to_buffer(iq);
+            }
             // Schedule TX buffer, iio_buffer_push will block if there is no room to push to.
             ntx = iio_buffer_push(tx_buffer);
             if (ntx < 0) {
                 gui_status_wprintw(RED, "Error pushing TX buffer: %d\n", (int) ntx);
                 break;
             }
+            if (atomic_load(&pushed) < kernel_buffers) {
+                atomic_fetch_add(&pushed, 1);
+            }
             // Release and free up used block
             fifo_release(iq);
         } else {
@@ -104,10 +132,12 @@ int sdr_pluto_init(simulator_t *simulator) {
     unsigned long xo_correction = 0;
 
     // ADLAM-Pluto wants 16 bit signed samples
-    if (simulator->sample_size == SC08) {
-        gui_status_wprintw(YELLOW, "8 bit sample size requested. Reset to 16 bit with ADLAM-Pluto.\n");
+    if (simulator->iq_format != IQ_FORMAT_CS16) {
+        gui_status_wprintw(YELLOW, "%s sample format requested. Reset to 16 bit with ADLAM-Pluto.\n", iq_format_desc(simulator->iq_format)->name);
     }
     simulator->sample_size = SC16;
+    simulator->iq_format = IQ_FORMAT_CS16;
+    pluto_tx_thread_exit = false;
 
     scan_ctx = iio_create_scan_context(NULL, 0);
     if (!scan_ctx) {
@@ -167,8 +197,11 @@ int sdr_pluto_init(simulator_t *simulator) {
         return -1;
     }
 
-    // Additional IQ kernel buffers, default is 4
-    iio_device_set_kernel_buffers_count(tx, 8);
+    // Kernel buffers queue the IQ data, default is 4
+    iio_device_set_kernel_buffers_count(tx, simulator->pluto_kernel_buffers);
+    kernel_buffers = simulator->pluto_kernel_buffers;
+    atomic_store(&pushed, 0);
+    buffer_samples = simulator->pluto_buffer_size;
 
     // Limit user gain to Pluto constrains
     if (simulator->tx_gain > PLUTO_TX_GAIN_MAX) simulator->tx_gain = PLUTO_TX_GAIN_MAX;
@@ -238,17 +271,34 @@ int sdr_pluto_init(simulator_t *simulator) {
         gui_mvwprintw(TRACK, y++, gui_x_offset, "   TF: %4.6f", irates[4] / 1e6);
     }
 
-    tx_buffer = iio_device_create_buffer(tx, NUM_IQ_SAMPLES, false);
+    tx_buffer = iio_device_create_buffer(tx, buffer_samples, false);
     if (!tx_buffer) {
         gui_status_wprintw(RED, "Could not create TX buffer.\n");
         return -1;
     }
     iio_buffer_set_blocking_mode(tx_buffer, true);
 
-    if (!fifo_create(NUM_FIFO_BUFFERS, IQ_BUFFER_SIZE, SC16)) {
+    // Render straight into the buffer if it holds interleaved 16 bit I/Q.
+    // The kernel buffers take over queueing, one FIFO buffer is enough.
+    char *first_i = (char *) iio_buffer_first(tx_buffer, tx0_i);
+    zero_copy = (iio_buffer_step(tx_buffer) == 2 * sizeof (int16_t)
+            && (char *) iio_buffer_first(tx_buffer, tx0_q) == first_i + sizeof (int16_t));
+    if (zero_copy && simulator->fifo_slack_ms > 0) {
+        gui_status_wprintw(YELLOW, "FIFO slack is set by the Pluto kernel buffers.\n");
+        fifo_set_target_slack(0);
+    }
+
+    if (!fifo_create(zero_copy ? 1 : NUM_FIFO_BUFFERS, buffer_samples * 2, SC16)) {
         gui_status_wprintw(RED, "Error creating IQ file fifo!\n");
         return -1;
     }
+    // Each push sends the entire buffer
+    fifo_set_block_align(buffer_samples * 2);
+    if (zero_copy) {
+        fifo_set_acquire_hook(pluto_acquire);
+    }
+    gui_mvwprintw(TRACK, y++, gui_x_offset, "TX buffers: %u x %u samples%s",
+            simulator->pluto_kernel_buffers, buffer_samples, zero_copy ? ", zero-copy" : "");
 
     return 0;
 }
@@ -256,8 +306,10 @@ int sdr_pluto_init(simulator_t *simulator) {
 void sdr_pluto_close(void) {
     pluto_tx_thread_exit = true;
     fifo_halt();
-    fifo_destroy();
+    // The TX thread may still release its last buffer
     pthread_join(pluto_tx_thread, NULL);
+    fifo_set_acquire_hook(NULL);
+    fifo_destroy();
 }
 
 int sdr_pluto_run(void) {
@@ -288,4 +340,10 @@ int sdr_pluto_set_gain(const int gain) {
     }
 
     return (int) (g);
-}
\ No newline at end of file
+}
+
+// Pushes wait for a free kernel buffer, once all are filled each push
+// waits for the oldest to go out
+unsigned sdr_pluto_delay_ms(void) {
+    return (unsigned) (atomic_load(&pushed) * (double) buffer_samples * 1000.0 / TX_SAMPLERATE);
+}
@@ -0,0 +1,197 @@
+/**
+ * multi-sdr-gps-sim generates a IQ data stream on-the-fly to simulate a
+ * GPS L1 baseband signal using a SDR platform like HackRF or ADLAM-Pluto.
+ *
+ * This file is part of the Github project at
+ * https://github.com/mictronics/multi-sdr-gps-sim.git
+ *
+ * Copyright © 2021 Mictronics
+ * Distributed under the MIT License.
+ *
+ */
+
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include "gui.h"
+#include "sdr.h"
+#include "fifo.h"
+#include "sdr_stdout.h"
+
+static atomic_bool stdout_thread_exit = false;
+static pthread_t stdout_thread;
+static int sample_size = SC08;
+static int consumer = 0; // FIFO consumer id, non-zero when streaming as tap
+static bool use_splice = false; // stdout is a pipe, hand over pages with vmsplice
+static simulator_t *scenario;
+
+// Spliced buffers stay referenced by the pipe until the reader has them.
+// One is kept back at most, the producer always has a free buffer left.
+static struct {
+    struct iq_buf *iq;
+    uint64_t end; // Output offset after the buffer
+} pending[2];
+static unsigned pending_count = 0;
+static uint64_t written = 0; // Bytes handed to stdout
+
+static bool write_all(const char *p, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(STDOUT_FILENO, p, len);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        p += n;
+        len -= (size_t) n;
+    }
+    return true;
+}
+
+static bool splice_all(const char *p, size_t len) {
+    while (len > 0) {
+        struct iovec iov = {(void *) p, len};
+        ssize_t n = vmsplice(STDOUT_FILENO, &iov, 1, 0);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        p += n;
+        len -= (size_t) n;
+    }
+    return true;
+}
+
+// Release spliced buffers the reader has consumed, wait while more than keep are left.
+static void release_consumed(unsigned keep) {
+    while (pending_count > 0) {
+        int unread = 0;
+        if (ioctl(STDOUT_FILENO, FIONREAD, &unread) != 0) {
+            unread = 0;
+        }
+        if (pending[0].end > written - (uint64_t) unread) {
+            if (pending_count <= keep || stdout_thread_exit) {
+                return;
+            }
+            usleep(1000);
+            continue;
+        }
+        fifo_release(pending[0].iq);
+        pending[0] = pending[1];
+        pending_count--;
+    }
+}
+
+static void *stdout_thread_ep(void *arg) {
+    (void) arg; // Not used
+    bool broken = false;
+
+    thread_to_role(CORE_SINK);
+    set_thread_name("stdout-thread");
+
+    while (!stdout_thread_exit) {
+        struct iq_buf *iq = fifo_dequeue_consumer(consumer);
+        if (iq == NULL) {
+            continue;
+        }
+        const char *data = fifo_buffer_data(iq);
+        size_t len = (size_t) iq->validLength * sample_size;
+        if (broken) {
+            // Keep draining so other sinks are not stalled
+            fifo_release(iq);
+            continue;
+        }
+        if (use_splice) {
+            broken = !splice_all(data, len);
+            written += len;
+            pending[pending_count].iq = iq;
+            pending[pending_count++].end = written;
+            release_consumed(1);
+        } else {
+            broken = !write_all(data, len);
+            written += len;
+            fifo_release(iq);
+        }
+        if (broken) {
+            gui_status_wprintw(RED, "Output pipe closed.\n");
+            scenario->main_exit = true;
+        }
+    }
+    // Producer has stopped, pages still in the pipe keep their content
+    while (pending_count > 0) {
+        fifo_release(pending[--pending_count].iq);
+    }
+    pthread_exit(NULL);
+}
+
+static bool set_output(simulator_t *simulator) {
+    struct stat st;
+
+    scenario = simulator;
+    sample_size = simulator->sample_size;
+    if (isatty(STDOUT_FILENO)) {
+        gui_status_wprintw(RED, "stdout is a terminal, pipe the IQ stream into another program.\n");
+        return false;
+    }
+    // Reader going away must not kill us
+    signal(SIGPIPE, SIG_IGN);
+    use_splice = (fstat(STDOUT_FILENO, &st) == 0 && S_ISFIFO(st.st_mode));
+    if (use_splice) {
+        fcntl(STDOUT_FILENO, F_SETPIPE_SZ, STDOUT_PIPE_SIZE);
+    }
+    gui_status_wprintw(GREEN, "Streaming %s to stdout%s.\n",
+            iq_format_desc(simulator->iq_format)->name, use_splice ? " with vmsplice" : "");
+    return true;
+}
+
+int sdr_stdout_init(simulator_t *simulator) {
+    if (!set_output(simulator)) {
+        return -1;
+    }
+    if (!fifo_create(NUM_FIFO_BUFFERS, iq_format_units(iq_format_desc(simulator->iq_format), IQ_BUFFER_SIZE), sample_size)) {
+        gui_status_wprintw(RED, "Error creating stdout fifo!\n");
+        return -1;
+    }
+    return 0;
+}
+
+// Stream the IQ data of another sink, e.g. what the radio transmits.
+int sdr_stdout_init_tap(simulator_t *simulator) {
+    if (simulator->sdr_type == SDR_STDOUT) {
+        gui_status_wprintw(RED, "stdout is already the primary sink.\n");
+        return -1;
+    }
+    if (!set_output(simulator)) {
+        return -1;
+    }
+    consumer = fifo_add_consumer();
+    if (consumer < 0) {
+        gui_status_wprintw(RED, "Error attaching stdout to fifo!\n");
+        return -1;
+    }
+    return 0;
+}
+
+void sdr_stdout_close(void) {
+    stdout_thread_exit = true;
+    fifo_halt();
+    pthread_join(stdout_thread, NULL);
+    // The primary sink owns the FIFO
+    if (consumer == 0) {
+        fifo_destroy();
+    }
+}
+
+int sdr_stdout_run(void) {
+    fifo_wait_full();
+    pthread_create(&stdout_thread, NULL, stdout_thread_ep, NULL);
+    return 0;
+}
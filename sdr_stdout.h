@@ -0,0 +1,23 @@
+/**
+ * multi-sdr-gps-sim generates a IQ data stream on-the-fly to simulate a
+ * GPS L1 baseband signal using a SDR platform like HackRF or ADLAM-Pluto.
+ *
+ * This file is part of the Github project at
+ * https://github.com/mictronics/multi-sdr-gps-sim.git
+ *
+ * Copyright © 2021 Mictronics
+ * Distributed under the MIT License.
+ *
+ */
+
+#ifndef SDR_STDOUT_H
+#define SDR_STDOUT_H
+
+#define STDOUT_PIPE_SIZE (1024 * 1024) // Requested pipe capacity
+
+int sdr_stdout_init(simulator_t *simulator);
+int sdr_stdout_init_tap(simulator_t *simulator);
+void sdr_stdout_close(void);
+int sdr_stdout_run(void);
+
+#endif /* SDR_STDOUT_H */
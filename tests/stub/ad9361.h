@@ -0,0 +1,22 @@
+/**
+ * multi-sdr-gps-sim generates a IQ data stream on-the-fly to simulate a
+ * GPS L1 baseband signal using a SDR platform like HackRF or ADLAM-Pluto.
+ *
+ * This file is part of the Github project at
+ * https://github.com/mictronics/multi-sdr-gps-sim.git
+ *
+ * Copyright © 2021 Mictronics
+ * Distributed under the MIT License.
+ *
+ */
+
+/* Stand-in for libad9361, implemented by the libiio shim. */
+
+#ifndef AD9361_STUB_H
+#define AD9361_STUB_H
+
+#include "iio.h"
+
+int ad9361_set_bb_rate(struct iio_device *dev, unsigned long rate);
+
+#endif /* AD9361_STUB_H */
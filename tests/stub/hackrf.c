@@ -0,0 +1,212 @@
+/**
+ * multi-sdr-gps-sim generates a IQ data stream on-the-fly to simulate a
+ * GPS L1 baseband signal using a SDR platform like HackRF or ADLAM-Pluto.
+ *
+ * This file is part of the Github project at
+ * https://github.com/mictronics/multi-sdr-gps-sim.git
+ *
+ * Copyright © 2021 Mictronics
+ * Distributed under the MIT License.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "../../sdr.h"
+#include "../../timeutil.h"
+#include "hackrf.h"
+
+struct hackrf_device {
+    hackrf_sample_block_cb_fn callback;
+    void *tx_ctx;
+    double sample_rate;
+    pthread_t thread;
+    bool started;
+    atomic_bool stop;
+};
+
+static struct hackrf_device board;
+static char *serials[1] = {"0000000000000000stub"};
+static hackrf_device_list_t list = {serials, NULL, NULL, 1, NULL, 1};
+static atomic_bool streaming;
+static hackrf_stub_observer_t observer;
+
+int hackrf_init(void) {
+    return HACKRF_SUCCESS;
+}
+
+int hackrf_exit(void) {
+    return HACKRF_SUCCESS;
+}
+
+const char *hackrf_error_name(enum hackrf_error errcode) {
+    return (errcode == HACKRF_SUCCESS) ? "HACKRF_SUCCESS" : "HACKRF_ERROR";
+}
+
+const char *hackrf_board_id_name(enum hackrf_board_id board_id) {
+    return (board_id == BOARD_ID_HACKRF_ONE) ? "HackRF One" : "Unknown";
+}
+
+hackrf_device_list_t *hackrf_device_list(void) {
+    return &list;
+}
+
+void hackrf_device_list_free(hackrf_device_list_t *l) {
+    (void) l;
+}
+
+int hackrf_device_list_open(hackrf_device_list_t *l, int idx, hackrf_device **device) {
+    if (l != &list || idx != 0) {
+        return HACKRF_ERROR_NOT_FOUND;
+    }
+    memset(&board, 0, sizeof (board));
+    board.sample_rate = TX_SAMPLERATE;
+    *device = &board;
+    return HACKRF_SUCCESS;
+}
+
+int hackrf_close(hackrf_device *device) {
+    return hackrf_stop_tx(device);
+}
+
+int hackrf_board_id_read(hackrf_device *device, uint8_t *value) {
+    (void) device;
+    *value = BOARD_ID_HACKRF_ONE;
+    return HACKRF_SUCCESS;
+}
+
+int hackrf_version_string_read(hackrf_device *device, char *version, uint8_t length) {
+    (void) device;
+    snprintf(version, length, "stub");
+    return HACKRF_SUCCESS;
+}
+
+int hackrf_usb_api_version_read(hackrf_device *device, uint16_t *version) {
+    (void) device;
+    *version = 0x0107;
+    return HACKRF_SUCCESS;
+}
+
+int hackrf_board_partid_serialno_read(hackrf_device *device, read_partid_serialno_t *read_partid_serialno) {
+    (void) device;
+    memset(read_partid_serialno, 0, sizeof (*read_partid_serialno));
+    return HACKRF_SUCCESS;
+}
+
+int hackrf_get_operacake_boards(hackrf_device *device, uint8_t *boards) {
+    (void) device;
+    memset(boards, 0, 8);
+    return HACKRF_SUCCESS;
+}
+
+uint32_t hackrf_compute_baseband_filter_bw(const uint32_t bandwidth_hz) {
+    return bandwidth_hz;
+}
+
+int hackrf_set_antenna_enable(hackrf_device *device, const uint8_t value) {
+    (void) device;
+    (void) value;
+    return HACKRF_SUCCESS;
+}
+
+int hackrf_set_sample_rate(hackrf_device *device, const double freq_hz) {
+    if (freq_hz <= 0.0) {
+        return HACKRF_ERROR_INVALID_PARAM;
+    }
+    device->sample_rate = freq_hz;
+    return HACKRF_SUCCESS;
+}
+
+int hackrf_set_baseband_filter_bandwidth(hackrf_device *device, const uint32_t bandwidth_hz) {
+    (void) device;
+    (void) bandwidth_hz;
+    return HACKRF_SUCCESS;
+}
+
+int hackrf_set_freq(hackrf_device *device, const uint64_t freq_hz) {
+    (void) device;
+    (void) freq_hz;
+    return HACKRF_SUCCESS;
+}
+
+int hackrf_set_amp_enable(hackrf_device *device, const uint8_t value) {
+    (void) device;
+    (void) value;
+    return HACKRF_SUCCESS;
+}
+
+int hackrf_set_txvga_gain(hackrf_device *device, uint32_t value) {
+    (void) device;
+    return (value <= 47) ? HACKRF_SUCCESS : HACKRF_ERROR_INVALID_PARAM;
+}
+
+int hackrf_set_hw_sync_mode(hackrf_device *device, const uint8_t value) {
+    (void) device;
+    (void) value;
+    return HACKRF_SUCCESS;
+}
+
+// Calls the TX callback once per transfer at the sample rate, until it asks
+// to stop or TX is stopped. Buffers are poisoned, the callback must fill them.
+static void *tx_thread_ep(void *arg) {
+    hackrf_device *device = (hackrf_device *) arg;
+    uint8_t *buffer = malloc(HACKRF_TRANSFER_BUFFER_SIZE);
+    hackrf_transfer transfer = {device, buffer, HACKRF_TRANSFER_BUFFER_SIZE, HACKRF_TRANSFER_BUFFER_SIZE, NULL, device->tx_ctx};
+    double period = HACKRF_TRANSFER_BUFFER_SIZE / 2 / device->sample_rate;
+    struct timespec t0;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (unsigned n = 1; buffer != NULL && !atomic_load(&device->stop); n++) {
+        memset(buffer, 0xa5, HACKRF_TRANSFER_BUFFER_SIZE);
+        transfer.valid_length = HACKRF_TRANSFER_BUFFER_SIZE;
+        if (device->callback(&transfer) != 0) {
+            break;
+        }
+        if (observer != NULL) {
+            observer(buffer, transfer.valid_length);
+        }
+        sleep_until(&t0, n * period);
+    }
+    atomic_store(&streaming, false);
+    free(buffer);
+    return NULL;
+}
+
+int hackrf_start_tx(hackrf_device *device, hackrf_sample_block_cb_fn callback, void *tx_ctx) {
+    if (device->started) {
+        return HACKRF_ERROR_BUSY;
+    }
+    device->callback = callback;
+    device->tx_ctx = tx_ctx;
+    atomic_store(&device->stop, false);
+    atomic_store(&streaming, true);
+    if (pthread_create(&device->thread, NULL, tx_thread_ep, device) != 0) {
+        atomic_store(&streaming, false);
+        return HACKRF_ERROR_OTHER;
+    }
+    device->started = true;
+    return HACKRF_SUCCESS;
+}
+
+int hackrf_stop_tx(hackrf_device *device) {
+    if (device->started) {
+        atomic_store(&device->stop, true);
+        pthread_join(device->thread, NULL);
+        device->started = false;
+    }
+    return HACKRF_SUCCESS;
+}
+
+void hackrf_stub_set_observer(hackrf_stub_observer_t fn) {
+    observer = fn;
+}
+
+bool hackrf_stub_streaming(void) {
+    return atomic_load(&streaming);
+}
+
+double hackrf_stub_sample_rate(void) {
+    return board.sample_rate;
+}
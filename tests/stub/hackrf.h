@@ -0,0 +1,100 @@
+/**
+ * multi-sdr-gps-sim generates a IQ data stream on-the-fly to simulate a
+ * GPS L1 baseband signal using a SDR platform like HackRF or ADLAM-Pluto.
+ *
+ * This file is part of the Github project at
+ * https://github.com/mictronics/multi-sdr-gps-sim.git
+ *
+ * Copyright © 2021 Mictronics
+ * Distributed under the MIT License.
+ *
+ */
+
+/* Stand-in for the part of libhackrf the HackRF backend uses. One fake
+ * board streams TX transfers at the real transfer size and the pace of
+ * TX_SAMPLERATE from its own thread, like the libusb event thread. */
+
+#ifndef HACKRF_STUB_H
+#define HACKRF_STUB_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+enum hackrf_error {
+    HACKRF_SUCCESS = 0,
+    HACKRF_ERROR_INVALID_PARAM = -2,
+    HACKRF_ERROR_NOT_FOUND = -5,
+    HACKRF_ERROR_BUSY = -6,
+    HACKRF_ERROR_USB_API_VERSION = -1005,
+    HACKRF_ERROR_OTHER = -9999
+};
+
+enum hackrf_board_id {
+    BOARD_ID_JELLYBEAN = 0,
+    BOARD_ID_JAWBREAKER = 1,
+    BOARD_ID_HACKRF_ONE = 2,
+    BOARD_ID_RAD1O = 3,
+    BOARD_ID_INVALID = 0xFF
+};
+
+typedef struct hackrf_device hackrf_device;
+
+typedef struct {
+    hackrf_device *device;
+    uint8_t *buffer;
+    int buffer_length;
+    int valid_length;
+    void *rx_ctx;
+    void *tx_ctx;
+} hackrf_transfer;
+
+typedef struct {
+    uint32_t part_id[2];
+    uint32_t serial_no[4];
+} read_partid_serialno_t;
+
+typedef struct {
+    char **serial_numbers;
+    int *usb_board_ids;
+    int *usb_device_index;
+    int devicecount;
+    void **usb_devices;
+    int usb_devicecount;
+} hackrf_device_list_t;
+
+typedef int (*hackrf_sample_block_cb_fn)(hackrf_transfer *transfer);
+
+int hackrf_init(void);
+int hackrf_exit(void);
+const char *hackrf_error_name(enum hackrf_error errcode);
+const char *hackrf_board_id_name(enum hackrf_board_id board_id);
+hackrf_device_list_t *hackrf_device_list(void);
+void hackrf_device_list_free(hackrf_device_list_t *list);
+int hackrf_device_list_open(hackrf_device_list_t *list, int idx, hackrf_device **device);
+int hackrf_close(hackrf_device *device);
+int hackrf_board_id_read(hackrf_device *device, uint8_t *value);
+int hackrf_version_string_read(hackrf_device *device, char *version, uint8_t length);
+int hackrf_usb_api_version_read(hackrf_device *device, uint16_t *version);
+int hackrf_board_partid_serialno_read(hackrf_device *device, read_partid_serialno_t *read_partid_serialno);
+int hackrf_get_operacake_boards(hackrf_device *device, uint8_t *boards);
+uint32_t hackrf_compute_baseband_filter_bw(const uint32_t bandwidth_hz);
+int hackrf_set_antenna_enable(hackrf_device *device, const uint8_t value);
+int hackrf_set_sample_rate(hackrf_device *device, const double freq_hz);
+int hackrf_set_baseband_filter_bandwidth(hackrf_device *device, const uint32_t bandwidth_hz);
+int hackrf_set_freq(hackrf_device *device, const uint64_t freq_hz);
+int hackrf_set_amp_enable(hackrf_device *device, const uint8_t value);
+int hackrf_set_txvga_gain(hackrf_device *device, uint32_t value);
+int hackrf_set_hw_sync_mode(hackrf_device *device, const uint8_t value);
+int hackrf_start_tx(hackrf_device *device, hackrf_sample_block_cb_fn callback, void *tx_ctx);
+int hackrf_stop_tx(hackrf_device *device);
+
+/* Test side of the stub. The observer sees every transfer right after the
+ * callback filled it, on the streaming thread. */
+typedef void (*hackrf_stub_observer_t)(const uint8_t *buffer, int length);
+void hackrf_stub_set_observer(hackrf_stub_observer_t observer);
+/* True while the fake board calls the TX callback. */
+bool hackrf_stub_streaming(void);
+/* Sample rate set by the backend, TX pace of the fake board. */
+double hackrf_stub_sample_rate(void);
+
+#endif /* HACKRF_STUB_H */
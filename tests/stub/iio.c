@@ -0,0 +1,323 @@
+/**
+ * multi-sdr-gps-sim generates a IQ data stream on-the-fly to simulate a
+ * GPS L1 baseband signal using a SDR platform like HackRF or ADLAM-Pluto.
+ *
+ * This file is part of the Github project at
+ * https://github.com/mictronics/multi-sdr-gps-sim.git
+ *
+ * Copyright © 2021 Mictronics
+ * Distributed under the MIT License.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../../sdr.h"
+#include "iio.h"
+#include "ad9361.h"
+
+#define POISON 0x5a // Fresh blocks are filled with it, shows samples not written
+
+struct iio_channel {
+    const char *name;
+    long long frequency;
+    double gain;
+    bool enabled;
+    bool powerdown;
+};
+
+struct iio_device {
+    const char *name;
+    struct iio_channel *chn;
+    int nchn;
+    unsigned kernel_buffers;
+};
+
+struct iio_context {
+    struct iio_device dev[2];
+};
+
+struct iio_buffer {
+    char *mem;
+    size_t samples;
+    size_t block_bytes;
+    unsigned blocks; // One per kernel buffer
+    unsigned cur; // Block filled next
+    int16_t *i; // Samples handed to the observer
+    int16_t *q;
+};
+
+struct iio_scan_context {
+    int unused;
+};
+
+struct iio_context_info {
+    const char *description;
+    const char *uri;
+};
+
+static struct iio_channel phy_chn[3];
+static struct iio_channel tx_chn[2];
+static struct iio_context pluto;
+static struct iio_scan_context scan;
+static struct iio_buffer *tx_buffer;
+static ptrdiff_t layout_step = 2 * sizeof (int16_t);
+static ptrdiff_t layout_q = sizeof (int16_t);
+static iio_shim_observer_t observer;
+static unsigned long pushed;
+
+struct iio_scan_context *iio_create_scan_context(const char *backend, unsigned int flags) {
+    (void) backend;
+    (void) flags;
+    return &scan;
+}
+
+void iio_scan_context_destroy(struct iio_scan_context *ctx) {
+    (void) ctx;
+}
+
+ssize_t iio_scan_context_get_info_list(struct iio_scan_context *ctx, struct iio_context_info ***info) {
+    (void) ctx;
+    *info = calloc(2, sizeof (**info));
+    (*info)[0] = malloc(sizeof (struct iio_context_info));
+    (*info)[0]->description = "Fake ADLAM-Pluto";
+    (*info)[0]->uri = "usb:0.0.0";
+    return 1;
+}
+
+void iio_context_info_list_free(struct iio_context_info **info) {
+    for (int i = 0; info != NULL && info[i] != NULL; i++) {
+        free(info[i]);
+    }
+    free(info);
+}
+
+const char *iio_context_info_get_description(const struct iio_context_info *info) {
+    return info->description;
+}
+
+const char *iio_context_info_get_uri(const struct iio_context_info *info) {
+    return info->uri;
+}
+
+void iio_strerror(int err, char *dst, size_t len) {
+    snprintf(dst, len, "%s", strerror(err));
+}
+
+struct iio_context *iio_create_default_context(void) {
+    memset(phy_chn, 0, sizeof (phy_chn));
+    memset(tx_chn, 0, sizeof (tx_chn));
+    phy_chn[0].name = "voltage0";
+    phy_chn[1].name = "altvoltage0";
+    phy_chn[2].name = "altvoltage1";
+    tx_chn[0].name = "voltage0";
+    tx_chn[1].name = "voltage1";
+    pluto.dev[0] = (struct iio_device){"ad9361-phy", phy_chn, 3, 0};
+    pluto.dev[1] = (struct iio_device){"cf-ad9361-dds-core-lpc", tx_chn, 2, 4};
+    return &pluto;
+}
+
+struct iio_context *iio_create_network_context(const char *host) {
+    (void) host;
+    return iio_create_default_context();
+}
+
+struct iio_context *iio_create_context_from_uri(const char *uri) {
+    (void) uri;
+    return iio_create_default_context();
+}
+
+void iio_context_destroy(struct iio_context *ctx) {
+    (void) ctx;
+}
+
+unsigned int iio_context_get_devices_count(const struct iio_context *ctx) {
+    (void) ctx;
+    return 2;
+}
+
+struct iio_device *iio_context_find_device(const struct iio_context *ctx, const char *name) {
+    for (int i = 0; i < 2; i++) {
+        if (strcmp(ctx->dev[i].name, name) == 0) {
+            return (struct iio_device *) &ctx->dev[i];
+        }
+    }
+    return NULL;
+}
+
+int iio_device_set_kernel_buffers_count(const struct iio_device *dev, unsigned int nb_buffers) {
+    if (nb_buffers == 0) {
+        return -22;
+    }
+    ((struct iio_device *) dev)->kernel_buffers = nb_buffers;
+    return 0;
+}
+
+struct iio_channel *iio_device_find_channel(const struct iio_device *dev, const char *name, bool output) {
+    for (int i = 0; dev != NULL && output && i < dev->nchn; i++) {
+        if (strcmp(dev->chn[i].name, name) == 0) {
+            return &dev->chn[i];
+        }
+    }
+    return NULL;
+}
+
+ssize_t iio_device_attr_read(const struct iio_device *dev, const char *attr, char *dst, size_t len) {
+    (void) dev;
+    if (strcmp(attr, "tx_path_rates") == 0) {
+        return snprintf(dst, len, "BBPLL:768000000 DAC:96000000 T2:48000000 T1:24000000 TF:12000000 TXSAMP:%d", TX_SAMPLERATE);
+    }
+    if (strcmp(attr, "xo_correction") == 0) {
+        return snprintf(dst, len, "40000000");
+    }
+    return -2;
+}
+
+void iio_channel_enable(struct iio_channel *chn) {
+    chn->enabled = true;
+}
+
+void iio_channel_disable(struct iio_channel *chn) {
+    chn->enabled = false;
+}
+
+ssize_t iio_channel_attr_read(const struct iio_channel *chn, const char *attr, char *dst, size_t len) {
+    if (chn != NULL && strcmp(attr, "hardwaregain") == 0) {
+        return snprintf(dst, len, "%.6f dB", chn->gain);
+    }
+    return -2;
+}
+
+int iio_channel_attr_read_longlong(const struct iio_channel *chn, const char *attr, long long *val) {
+    if (chn != NULL && strcmp(attr, "frequency") == 0) {
+        *val = chn->frequency;
+        return 0;
+    }
+    return -2;
+}
+
+ssize_t iio_channel_attr_write(const struct iio_channel *chn, const char *attr, const char *src) {
+    (void) attr;
+    return (chn != NULL) ? (ssize_t) strlen(src) + 1 : -2;
+}
+
+int iio_channel_attr_write_longlong(const struct iio_channel *chn, const char *attr, long long val) {
+    if (chn != NULL && strcmp(attr, "frequency") == 0) {
+        ((struct iio_channel *) chn)->frequency = val;
+    }
+    return (chn != NULL) ? 0 : -2;
+}
+
+int iio_channel_attr_write_double(const struct iio_channel *chn, const char *attr, double val) {
+    if (chn != NULL && strcmp(attr, "hardwaregain") == 0) {
+        ((struct iio_channel *) chn)->gain = val;
+    }
+    return (chn != NULL) ? 0 : -2;
+}
+
+int iio_channel_attr_write_bool(const struct iio_channel *chn, const char *attr, bool val) {
+    if (chn != NULL && strcmp(attr, "powerdown") == 0) {
+        ((struct iio_channel *) chn)->powerdown = val;
+    }
+    return (chn != NULL) ? 0 : -2;
+}
+
+int ad9361_set_bb_rate(struct iio_device *dev, unsigned long rate) {
+    (void) dev;
+    return (rate == TX_SAMPLERATE) ? 0 : -22;
+}
+
+struct iio_buffer *iio_device_create_buffer(const struct iio_device *dev, size_t samples_count, bool cyclic) {
+    if (cyclic || samples_count == 0 || tx_buffer != NULL || !tx_chn[0].enabled || !tx_chn[1].enabled) {
+        return NULL;
+    }
+    struct iio_buffer *buf = calloc(1, sizeof (*buf));
+    buf->samples = samples_count;
+    buf->block_bytes = samples_count * (size_t) layout_step;
+    buf->blocks = dev->kernel_buffers;
+    buf->mem = aligned_alloc(64, buf->blocks * buf->block_bytes);
+    buf->i = malloc(samples_count * sizeof (int16_t));
+    buf->q = malloc(samples_count * sizeof (int16_t));
+    memset(buf->mem, POISON, buf->blocks * buf->block_bytes);
+    pushed = 0;
+    tx_buffer = buf;
+    return buf;
+}
+
+void iio_buffer_destroy(struct iio_buffer *buf) {
+    free(buf->mem);
+    free(buf->i);
+    free(buf->q);
+    free(buf);
+    tx_buffer = NULL;
+}
+
+int iio_buffer_set_blocking_mode(struct iio_buffer *buf, bool blocking) {
+    (void) buf;
+    (void) blocking;
+    return 0;
+}
+
+void *iio_buffer_first(const struct iio_buffer *buf, const struct iio_channel *chn) {
+    char *block = buf->mem + buf->cur * buf->block_bytes;
+    if (chn == &tx_chn[0]) {
+        return block;
+    }
+    if (chn == &tx_chn[1]) {
+        return block + layout_q;
+    }
+    return NULL;
+}
+
+ptrdiff_t iio_buffer_step(const struct iio_buffer *buf) {
+    (void) buf;
+    return layout_step;
+}
+
+// Hands the block to the "DMA", which takes as long as sending it. The next
+// block is a different kernel buffer.
+ssize_t iio_buffer_push(struct iio_buffer *buf) {
+    char *block = buf->mem + buf->cur * buf->block_bytes;
+    for (size_t n = 0; n < buf->samples; n++) {
+        memcpy(&buf->i[n], block + n * layout_step, sizeof (int16_t));
+        memcpy(&buf->q[n], block + n * layout_step + layout_q, sizeof (int16_t));
+    }
+    if (observer != NULL) {
+        observer(buf->i, buf->q, buf->samples);
+    }
+    pushed++;
+    buf->cur = (buf->cur + 1) % buf->blocks;
+    memset(buf->mem + buf->cur * buf->block_bytes, POISON, buf->block_bytes);
+
+    double t = (double) buf->samples / TX_SAMPLERATE;
+    struct timespec ts = {(time_t) t, (long) ((t - (double) (time_t) t) * 1e9)};
+    nanosleep(&ts, NULL);
+    return (ssize_t) buf->block_bytes;
+}
+
+void iio_shim_set_layout(ptrdiff_t step, ptrdiff_t q_offset) {
+    layout_step = step;
+    layout_q = q_offset;
+}
+
+void iio_shim_set_observer(iio_shim_observer_t fn) {
+    observer = fn;
+}
+
+void *iio_shim_block(void) {
+    return (tx_buffer != NULL) ? tx_buffer->mem + tx_buffer->cur * tx_buffer->block_bytes : NULL;
+}
+
+unsigned iio_shim_kernel_buffers(void) {
+    return pluto.dev[1].kernel_buffers;
+}
+
+unsigned long iio_shim_pushed(void) {
+    return pushed;
+}
+
+bool iio_shim_buffer_alive(void) {
+    return tx_buffer != NULL;
+}
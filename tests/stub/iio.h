@@ -0,0 +1,83 @@
+/**
+ * multi-sdr-gps-sim generates a IQ data stream on-the-fly to simulate a
+ * GPS L1 baseband signal using a SDR platform like HackRF or ADLAM-Pluto.
+ *
+ * This file is part of the Github project at
+ * https://github.com/mictronics/multi-sdr-gps-sim.git
+ *
+ * Copyright © 2021 Mictronics
+ * Distributed under the MIT License.
+ *
+ */
+
+/* Stand-in for the part of libiio the ADLAM-Pluto backend uses. One fake
+ * Pluto whose TX buffer layout is set by the test: I/Q interleaved as on
+ * the real device, or spread out so the backend has to scatter. Pushed
+ * blocks rotate through the kernel buffers like the mmap interface. */
+
+#ifndef IIO_STUB_H
+#define IIO_STUB_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+struct iio_context;
+struct iio_device;
+struct iio_channel;
+struct iio_buffer;
+struct iio_scan_context;
+struct iio_context_info;
+
+struct iio_scan_context *iio_create_scan_context(const char *backend, unsigned int flags);
+void iio_scan_context_destroy(struct iio_scan_context *ctx);
+ssize_t iio_scan_context_get_info_list(struct iio_scan_context *ctx, struct iio_context_info ***info);
+void iio_context_info_list_free(struct iio_context_info **info);
+const char *iio_context_info_get_description(const struct iio_context_info *info);
+const char *iio_context_info_get_uri(const struct iio_context_info *info);
+void iio_strerror(int err, char *dst, size_t len);
+
+struct iio_context *iio_create_default_context(void);
+struct iio_context *iio_create_network_context(const char *host);
+struct iio_context *iio_create_context_from_uri(const char *uri);
+void iio_context_destroy(struct iio_context *ctx);
+unsigned int iio_context_get_devices_count(const struct iio_context *ctx);
+struct iio_device *iio_context_find_device(const struct iio_context *ctx, const char *name);
+
+int iio_device_set_kernel_buffers_count(const struct iio_device *dev, unsigned int nb_buffers);
+struct iio_channel *iio_device_find_channel(const struct iio_device *dev, const char *name, bool output);
+ssize_t iio_device_attr_read(const struct iio_device *dev, const char *attr, char *dst, size_t len);
+
+void iio_channel_enable(struct iio_channel *chn);
+void iio_channel_disable(struct iio_channel *chn);
+ssize_t iio_channel_attr_read(const struct iio_channel *chn, const char *attr, char *dst, size_t len);
+int iio_channel_attr_read_longlong(const struct iio_channel *chn, const char *attr, long long *val);
+ssize_t iio_channel_attr_write(const struct iio_channel *chn, const char *attr, const char *src);
+int iio_channel_attr_write_longlong(const struct iio_channel *chn, const char *attr, long long val);
+int iio_channel_attr_write_double(const struct iio_channel *chn, const char *attr, double val);
+int iio_channel_attr_write_bool(const struct iio_channel *chn, const char *attr, bool val);
+
+struct iio_buffer *iio_device_create_buffer(const struct iio_device *dev, size_t samples_count, bool cyclic);
+void iio_buffer_destroy(struct iio_buffer *buf);
+int iio_buffer_set_blocking_mode(struct iio_buffer *buf, bool blocking);
+void *iio_buffer_first(const struct iio_buffer *buf, const struct iio_channel *chn);
+ptrdiff_t iio_buffer_step(const struct iio_buffer *buf);
+ssize_t iio_buffer_push(struct iio_buffer *buf);
+
+/* Test side of the shim. Layout of the TX buffer in bytes, the step from
+ * one sample to the next and the offset of Q from I. Set before the
+ * backend creates its buffer. */
+void iio_shim_set_layout(ptrdiff_t step, ptrdiff_t q_offset);
+/* Called for each pushed block with the I and Q samples taken out of it. */
+typedef void (*iio_shim_observer_t)(const int16_t *i, const int16_t *q, size_t samples);
+void iio_shim_set_observer(iio_shim_observer_t observer);
+/* Start of the block to be pushed next, what iio_buffer_first() returns. */
+void *iio_shim_block(void);
+/* Kernel buffers set by the backend and blocks pushed so far. */
+unsigned iio_shim_kernel_buffers(void);
+unsigned long iio_shim_pushed(void);
+/* True while a TX buffer exists. */
+bool iio_shim_buffer_alive(void);
+
+#endif /* IIO_STUB_H */
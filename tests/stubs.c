@@ -0,0 +1,164 @@
+/**
+ * multi-sdr-gps-sim generates a IQ data stream on-the-fly to simulate a
+ * GPS L1 baseband signal using a SDR platform like HackRF or ADLAM-Pluto.
+ *
+ * This file is part of the Github project at
+ * https://github.com/mictronics/multi-sdr-gps-sim.git
+ *
+ * Copyright © 2021 Mictronics
+ * Distributed under the MIT License.
+ *
+ */
+
+/* GUI and thread helpers of the simulator main, so tests link the modules
+ * without curses. Status lines go to stderr with TEST_VERBOSE set. */
+
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+#include <ftw.h>
+#include "../gui.h"
+#include "../gps-sim.h"
+#include "test.h"
+
+int test_failures = 0;
+static char tmp_dir[64];
+
+void gui_init(void) {
+}
+
+bool gui_is_headless(void) {
+    return true;
+}
+
+int gui_getch(void) {
+    return -1;
+}
+
+void gui_destroy(void) {
+}
+
+void gui_mvwprintw(window_panel_t w, int y, int x, const char * fmt, ...) {
+    NOTUSED(w);
+    NOTUSED(y);
+    NOTUSED(x);
+    NOTUSED(fmt);
+}
+
+void gui_status_wprintw(status_color_t clr, const char * fmt, ...) {
+    NOTUSED(clr);
+    if (getenv("TEST_VERBOSE") != NULL) {
+        va_list args;
+        va_start(args, fmt);
+        vfprintf(stderr, fmt, args);
+        va_end(args);
+    }
+}
+
+void gui_colorpair(window_panel_t w, unsigned clr, attr_status_t onoff) {
+    NOTUSED(w);
+    NOTUSED(clr);
+    NOTUSED(onoff);
+}
+
+void gui_top_panel(window_panel_t p) {
+    NOTUSED(p);
+}
+
+void gui_toggle_current_panel(void) {
+}
+
+void gui_show_panel(window_panel_t p, attr_status_t onoff) {
+    NOTUSED(p);
+    NOTUSED(onoff);
+}
+
+void gui_show_speed(float speed) {
+    NOTUSED(speed);
+}
+
+void gui_show_heading(float hdg) {
+    NOTUSED(hdg);
+}
+
+void gui_show_vertical_speed(float vs) {
+    NOTUSED(vs);
+}
+
+void gui_show_location(void *l) {
+    NOTUSED(l);
+}
+
+void gui_show_target(void *t) {
+    NOTUSED(t);
+}
+
+void set_thread_name(const char *name) {
+    pthread_setname_np(pthread_self(), name);
+}
+
+int thread_to_core(int core_id) {
+    NOTUSED(core_id);
+    return 0;
+}
+
+int thread_to_role(core_role_t role) {
+    NOTUSED(role);
+    return 0;
+}
+
+bool set_core_roles(const char *list) {
+    NOTUSED(list);
+    return true;
+}
+
+double test_now(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double) now.tv_sec + (double) now.tv_nsec / 1e9;
+}
+
+const char *test_chdir_tmp(void) {
+    strcpy(tmp_dir, "/tmp/gps-sim-test.XXXXXX");
+    if (mkdtemp(tmp_dir) == NULL || chdir(tmp_dir) != 0) {
+        perror("test_chdir_tmp");
+        exit(EXIT_FAILURE);
+    }
+    return tmp_dir;
+}
+
+static int remove_entry(const char *path, const struct stat *st, int flag, struct FTW *ftw) {
+    NOTUSED(st);
+    NOTUSED(flag);
+    NOTUSED(ftw);
+    return remove(path);
+}
+
+void test_cleanup_tmp(void) {
+    if (tmp_dir[0] != 0 && chdir("/") == 0) {
+        nftw(tmp_dir, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+        tmp_dir[0] = 0;
+    }
+}
+
+bool test_copy_file(const char *from, const char *to) {
+    char buf[8192];
+    size_t n;
+    bool ok = true;
+    FILE *in = fopen(from, "rb");
+    FILE *out = fopen(to, "wb");
+
+    if (in == NULL || out == NULL) {
+        ok = false;
+    }
+    while (ok && (n = fread(buf, 1, sizeof (buf), in)) > 0) {
+        ok = (fwrite(buf, 1, n, out) == n);
+    }
+    if (in != NULL) {
+        fclose(in);
+    }
+    if (out != NULL && fclose(out) != 0) {
+        ok = false;
+    }
+    return ok;
+}
@@ -0,0 +1,47 @@
+/**
+ * multi-sdr-gps-sim generates a IQ data stream on-the-fly to simulate a
+ * GPS L1 baseband signal using a SDR platform like HackRF or ADLAM-Pluto.
+ *
+ * This file is part of the Github project at
+ * https://github.com/mictronics/multi-sdr-gps-sim.git
+ *
+ * Copyright © 2021 Mictronics
+ * Distributed under the MIT License.
+ *
+ */
+
+#ifndef TEST_H
+#define TEST_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <time.h>
+
+// Fixtures, set by the Makefile
+#ifndef TEST_DATA
+#define TEST_DATA "tests/data"
+#endif
+
+extern int test_failures;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        test_failures++; \
+    } \
+} while (0)
+
+// Exit status of a test program
+#define TEST_RESULT() (test_failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE)
+
+/* Monotonic seconds since an arbitrary start. */
+double test_now(void);
+/* Run the test in a fresh temporary directory, returns its path. */
+const char *test_chdir_tmp(void);
+/* Remove the temporary directory and everything in it. */
+void test_cleanup_tmp(void);
+/* Copy a file, false on error. */
+bool test_copy_file(const char *from, const char *to);
+
+#endif /* TEST_H */
@@ -0,0 +1,198 @@
+/**
+ * multi-sdr-gps-sim generates a IQ data stream on-the-fly to simulate a
+ * GPS L1 baseband signal using a SDR platform like HackRF or ADLAM-Pluto.
+ *
+ * This file is part of the Github project at
+ * https://github.com/mictronics/multi-sdr-gps-sim.git
+ *
+ * Copyright © 2021 Mictronics
+ * Distributed under the MIT License.
+ *
+ */
+
+/* HackRF backend against the libhackrf stub in tests/stub. Every FIFO block
+ * holds one value, the stub records the value of each transfer. The
+ * producer stalls once for longer than the ring holds. */
+
+#include <string.h>
+#include <unistd.h>
+#include <hackrf.h>
+#include "../sdr.h"
+#include "../fifo.h"
+#include "../sdr_hackrf.h"
+#include "../sdr_iqfile.h"
+#include "test.h"
+
+#define BLOCKS 24 // Blocks produced
+#define STALL_AFTER 12 // Producer stalls after this block
+#define STALL_SECONDS 1.0
+#define MAX_TRANSFERS 256
+#define MIXED (-1) // Transfer not filled with one value
+
+static simulator_t sim;
+static int transfers[MAX_TRANSFERS];
+static atomic_int transfer_count;
+static atomic_int reported; // Underruns reported by the backend
+
+// Linked with --wrap, counts the backend reports apart from the FIFO ones
+void __real_fifo_report_underrun(void);
+
+void __wrap_fifo_report_underrun(void) {
+    atomic_fetch_add(&reported, 1);
+    __real_fifo_report_underrun();
+}
+
+static void observe(const uint8_t *buffer, int length) {
+    int value = buffer[0];
+    for (int i = 1; i < length; i++) {
+        if (buffer[i] != buffer[0]) {
+            value = MIXED;
+            break;
+        }
+    }
+    int n = atomic_load(&transfer_count);
+    if (n < MAX_TRANSFERS) {
+        transfers[n] = value;
+        atomic_store(&transfer_count, n + 1);
+    }
+}
+
+static void *producer_thread_ep(void *arg) {
+    NOTUSED(arg);
+    for (int b = 1; b <= BLOCKS; b++) {
+        struct iq_buf *iq = fifo_acquire();
+        if (iq == NULL) {
+            break;
+        }
+        // Rendered into the ring, not the FIFO pool
+        CHECK(fifo_buffer_data(iq) != iq->pool_data);
+        memset(iq->data8, b, HACKRF_TRANSFER_BUFFER_SIZE);
+        iq->validLength = HACKRF_TRANSFER_BUFFER_SIZE;
+        fifo_enqueue(iq);
+        if (b == STALL_AFTER) {
+            usleep((useconds_t) (STALL_SECONDS * 1e6));
+        }
+    }
+    return NULL;
+}
+
+// Every block of the tap file holds the value of its block number
+static bool tap_in_order(const char *name) {
+    FILE *fp = fopen(name, "rb");
+    long n = 0;
+    int c;
+
+    if (fp == NULL) {
+        return false;
+    }
+    while ((c = fgetc(fp)) != EOF && c == (int) (n / HACKRF_TRANSFER_BUFFER_SIZE) + 1) {
+        n++;
+    }
+    fclose(fp);
+    return n == (long) BLOCKS * HACKRF_TRANSFER_BUFFER_SIZE;
+}
+
+static void stream(bool repeat, bool tap) {
+    pthread_t producer;
+    struct fifo_stats fs;
+
+    memset(&sim, 0, sizeof (sim));
+    sim.iq_format = IQ_FORMAT_CS16; // Backend resets it to cs8
+    sim.underrun_repeat = repeat;
+    atomic_store(&transfer_count, 0);
+    atomic_store(&reported, 0);
+    hackrf_stub_set_observer(observe);
+
+    CHECK(sdr_hackrf_init(&sim) == 0);
+    CHECK(sim.iq_format == IQ_FORMAT_CS8 && sim.sample_size == SC08);
+    CHECK(fifo_block_align() == HACKRF_TRANSFER_BUFFER_SIZE);
+    if (tap) {
+        sim.sdr_type = SDR_HACKRF;
+        sim.iq_archive_level = -1;
+        sim.iq_file_name = "tap.iq";
+        CHECK(sdr_iqfile_init_tap(&sim) == 0);
+    }
+    pthread_create(&producer, NULL, producer_thread_ep, NULL);
+    if (tap) {
+        CHECK(sdr_iqfile_run() == 0);
+    }
+    CHECK(sdr_hackrf_run() == 0);
+    CHECK(hackrf_stub_sample_rate() == TX_SAMPLERATE);
+    // Started with a full ring, the USB transfers come on top
+    unsigned delay_ms = sdr_hackrf_delay_ms();
+    CHECK(delay_ms >= (unsigned) (HACKRF_USB_TRANSFERS * HACKRF_TRANSFER_BUFFER_SIZE / 2 * 1000.0 / TX_SAMPLERATE));
+    CHECK(delay_ms <= (unsigned) ((HACKRF_RING_SIZE - 1 + HACKRF_USB_TRANSFERS) * HACKRF_TRANSFER_BUFFER_SIZE / 2 * 1000.0 / TX_SAMPLERATE));
+    double t0 = test_now();
+    pthread_join(producer, NULL);
+    // Generator done, the rest of the ring goes out on close
+    sim.gps_thread_exit = true;
+    if (tap) {
+        fifo_wait_next();
+        sdr_iqfile_close();
+        CHECK(tap_in_order("tap.iq"));
+    }
+    sdr_hackrf_close();
+    double elapsed = test_now() - t0;
+    CHECK(!hackrf_stub_streaming());
+    fifo_get_stats(&fs);
+
+    // Transfers at the stub pace, STALL_SECONDS more than the data
+    double period = HACKRF_TRANSFER_BUFFER_SIZE / 2.0 / TX_SAMPLERATE;
+    int n = atomic_load(&transfer_count);
+    CHECK(n < MAX_TRANSFERS);
+    CHECK(elapsed > STALL_SECONDS);
+    CHECK(n <= (int) (elapsed / period) + 1);
+
+    // Blocks arrive once each and in order, fills in between. Fills after
+    // the last block come from stopping and are not underruns.
+    int next = 1;
+    int fills = 0;
+    int last = 0;
+    for (int i = 0; i < n && next <= BLOCKS; i++) {
+        int v = transfers[i];
+        CHECK(v != MIXED && v != 0xa5);
+        if (v == next) {
+            next++;
+        } else {
+            CHECK(v == (repeat ? last : 0));
+            fills++;
+        }
+        last = v;
+    }
+    CHECK(next == BLOCKS + 1);
+    for (int i = 0; i < n; i++) {
+        CHECK(transfers[i] != MIXED);
+    }
+    // Stall minus what the ring held
+    CHECK(fills > 0);
+    CHECK(fills >= (int) ((STALL_SECONDS - (HACKRF_RING_SIZE - 1) * period) / period) - 1);
+    // Every fill is reported as underrun, the FIFO adds the times the
+    // feeder found it empty
+    CHECK(atomic_load(&reported) == fills);
+    CHECK(fs.underruns >= (unsigned long) fills);
+    hackrf_stub_set_observer(NULL);
+}
+
+// Underruns are filled with silence
+static void test_silence(void) {
+    stream(false, false);
+}
+
+// Underruns repeat the block sent last
+static void test_repeat(void) {
+    stream(true, false);
+}
+
+// An IQ file tap records the blocks from the ring memory
+static void test_tap(void) {
+    stream(false, true);
+}
+
+int main(void) {
+    test_chdir_tmp();
+    test_silence();
+    test_repeat();
+    test_tap();
+    test_cleanup_tmp();
+    return TEST_RESULT();
+}
@@ -0,0 +1,77 @@
+/**
+ * multi-sdr-gps-sim generates a IQ data stream on-the-fly to simulate a
+ * GPS L1 baseband signal using a SDR platform like HackRF or ADLAM-Pluto.
+ *
+ * This file is part of the Github project at
+ * https://github.com/mictronics/multi-sdr-gps-sim.git
+ *
+ * Copyright © 2021 Mictronics
+ * Distributed under the MIT License.
+ *
+ */
+
+/* Staged file writer. Writes of unaligned size end up complete on disk,
+ * failing writes are reported on every later call and on close while the
+ * writes still in flight are waited for. */
+
+#include <string.h>
+#include <sys/stat.h>
+#include "../iowriter.h"
+#include "test.h"
+
+#define CHUNKS 10 // Written per test, more than the staging buffers
+#define PIECE (IOWRITER_CHUNK - 7) // Not aligned to the staging buffers
+
+static unsigned char data[PIECE];
+
+static bool file_in_order(const char *name) {
+    FILE *fp = fopen(name, "rb");
+    long n = 0;
+    int c;
+
+    if (fp == NULL) {
+        return false;
+    }
+    while ((c = fgetc(fp)) != EOF && c == data[n % PIECE]) {
+        n++;
+    }
+    fclose(fp);
+    return n == (long) CHUNKS * PIECE;
+}
+
+// Unaligned pieces and tail, the file is truncated to what was written
+static void test_write(void) {
+    struct iowriter *w = iowriter_open("out.bin", 2 * (uint64_t) CHUNKS * IOWRITER_CHUNK);
+    CHECK(w != NULL);
+    for (int i = 0; i < CHUNKS; i++) {
+        CHECK(iowriter_write(w, data, PIECE));
+    }
+    CHECK(iowriter_size(w) == (uint64_t) CHUNKS * PIECE);
+    CHECK(iowriter_close(w));
+    CHECK(file_in_order("out.bin"));
+}
+
+// Device without space, the writer keeps going until closed
+static void test_error(void) {
+    struct iowriter *w = iowriter_open("/dev/full", 0);
+    int failed = 0;
+    CHECK(w != NULL);
+    for (int i = 0; i < CHUNKS; i++) {
+        failed += !iowriter_write(w, data, PIECE);
+    }
+    // Reported once a write completed, from then on every call fails
+    CHECK(failed >= CHUNKS - IOWRITER_DEPTH);
+    CHECK(!iowriter_write(w, data, 1));
+    CHECK(!iowriter_close(w));
+}
+
+int main(void) {
+    for (unsigned i = 0; i < PIECE; i++) {
+        data[i] = (unsigned char) (i % 251);
+    }
+    test_chdir_tmp();
+    test_write();
+    test_error();
+    test_cleanup_tmp();
+    return TEST_RESULT();
+}
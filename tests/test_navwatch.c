@@ -0,0 +1,154 @@
+/**
+ * multi-sdr-gps-sim generates a IQ data stream on-the-fly to simulate a
+ * GPS L1 baseband signal using a SDR platform like HackRF or ADLAM-Pluto.
+ *
+ * This file is part of the Github project at
+ * https://github.com/mictronics/multi-sdr-gps-sim.git
+ *
+ * Copyright © 2021 Mictronics
+ * Distributed under the MIT License.
+ *
+ */
+
+/* Nav reload while the GPS thread generates into a sink paced to real
+ * time. The nav file is replaced right after the start, the reload is
+ * taken at the first 30s frame a few seconds into the run. The sink must
+ * not find the FIFO empty around the swap. */
+
+#include <string.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <errno.h>
+#include <limits.h>
+#include <sys/time.h>
+#include "../sdr.h"
+#include "../fifo.h"
+#include "../gps.h"
+#include "../prefetch.h"
+#include "../navwatch.h"
+#include "../timeutil.h"
+#include "test.h"
+
+#define RUN_SECONDS 8
+#define SWAP_BLOCK 50 // Start is 5s before a 30s frame
+#define MARGIN_BLOCKS 10 // Blocks checked on both sides of the swap
+#define BLOCKS (RUN_SECONDS * 10 - MARGIN_BLOCKS) // Taken by the sink
+
+static simulator_t sim;
+static char nav_path[PATH_MAX];
+static unsigned long underruns[BLOCKS]; // FIFO underruns when a block was taken
+static atomic_int taken; // Reloads the GPS thread swapped in
+static atomic_int sink_blocks; // Blocks the sink took
+static atomic_bool sink_exit;
+
+// Linked with --wrap, counts the reloads the GPS thread took
+ephstore_t *__real_navwatch_take(void);
+
+ephstore_t *__wrap_navwatch_take(void) {
+    ephstore_t *fresh = __real_navwatch_take();
+    if (fresh != NULL) {
+        atomic_fetch_add(&taken, 1);
+    }
+    return fresh;
+}
+
+// Stub sink, takes one 100ms block per 100ms like a radio would until
+// the FIFO is halted
+static void *sink_thread_ep(void *arg) {
+    NOTUSED(arg);
+    struct timespec t0;
+    struct fifo_stats fs;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (int k = 0; !atomic_load(&sink_exit); k++) {
+        sleep_until(&t0, k * 0.1);
+        struct iq_buf *iq = fifo_dequeue();
+        if (iq == NULL) {
+            break;
+        }
+        if (k < BLOCKS) {
+            fifo_get_stats(&fs);
+            underruns[k] = fs.underruns;
+        }
+        fifo_release(iq);
+        atomic_store(&sink_blocks, k + 1);
+    }
+    return NULL;
+}
+
+// Replace the nav file the way downloads do, written aside and renamed
+static bool replace_nav(void) {
+    char tmp[PATH_MAX + 8];
+    snprintf(tmp, sizeof (tmp), "%s.part", nav_path);
+    return test_copy_file(TEST_DATA "/brdc0010.22n", tmp) && rename(tmp, nav_path) == 0;
+}
+
+static void test_reload_under_load(void) {
+    pthread_t sink;
+    struct timespec timeout;
+    struct timeval now;
+    char *nav_files[1] = {nav_path};
+
+    snprintf(nav_path, sizeof (nav_path), "%s/brdc0010.22n", test_chdir_tmp());
+    CHECK(test_copy_file(TEST_DATA "/brdc0010.22n", nav_path));
+
+    memset(&sim, 0, sizeof (sim));
+    sim.ionosphere_enable = true;
+    sim.nav_watch = true;
+    sim.nav_files = nav_files;
+    sim.nav_file_count = 1;
+    sim.iq_format = IQ_FORMAT_CS8;
+    sim.sample_size = SC08;
+    sim.iq_archive_level = -1;
+    sim.duration = 2 * RUN_SECONDS * 10; // Still running when stopped
+    sim.location.lat = 35.681298;
+    sim.location.lon = 139.766247;
+    sim.location.height = 10.0;
+    sim.start = (datetime_t){2022, 1, 1, 0, 0, 25.0};
+    sim.start_gps.week = -1;
+    pthread_mutex_init(&sim.gps_lock, NULL);
+    pthread_cond_init(&sim.gps_init_done, NULL);
+    atomic_store(&taken, 0);
+    atomic_store(&sink_blocks, 0);
+    atomic_store(&sink_exit, false);
+
+    CHECK(fifo_create(NUM_FIFO_BUFFERS, IQ_BUFFER_SIZE, SC08));
+    prefetch_start(&sim);
+    gettimeofday(&now, NULL);
+    timeout.tv_sec = now.tv_sec + 30;
+    timeout.tv_nsec = 0;
+    pthread_mutex_lock(&sim.gps_lock);
+    pthread_create(&sim.gps_thread, NULL, gps_thread_ep, &sim);
+    int ret = 0;
+    while (!sim.gps_thread_running && !sim.gps_thread_exit && ret != ETIMEDOUT) {
+        ret = pthread_cond_timedwait(&sim.gps_init_done, &sim.gps_lock, &timeout);
+    }
+    pthread_mutex_unlock(&sim.gps_lock);
+    CHECK(sim.gps_thread_running);
+
+    // Watching has started, the reload settles while the FIFO fills
+    CHECK(replace_nav());
+    fifo_wait_full();
+    pthread_create(&sink, NULL, sink_thread_ep, NULL);
+    while (atomic_load(&sink_blocks) < BLOCKS) {
+        usleep(10000);
+    }
+    // Shut down like the simulator main, the generator stops while the
+    // sink still runs and the FIFO is halted after
+    sim.gps_thread_exit = true;
+    pthread_join(sim.gps_thread, NULL);
+    atomic_store(&sink_exit, true);
+    fifo_halt();
+    pthread_join(sink, NULL);
+    fifo_destroy();
+
+    CHECK(atomic_load(&taken) == 1);
+    // No underrun from before the swap to well after it
+    CHECK(underruns[BLOCKS - 1] == underruns[SWAP_BLOCK - MARGIN_BLOCKS]);
+    test_cleanup_tmp();
+}
+
+int main(void) {
+    test_reload_under_load();
+    return TEST_RESULT();
+}
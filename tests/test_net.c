@@ -0,0 +1,298 @@
+/**
+ * multi-sdr-gps-sim generates a IQ data stream on-the-fly to simulate a
+ * GPS L1 baseband signal using a SDR platform like HackRF or ADLAM-Pluto.
+ *
+ * This file is part of the Github project at
+ * https://github.com/mictronics/multi-sdr-gps-sim.git
+ *
+ * Copyright © 2021 Mictronics
+ * Distributed under the MIT License.
+ *
+ */
+
+/* Network sink and source over loopback. A child process streams with the
+ * network sink, this process receives it with the network source and
+ * forwards it to the IQ file sink. Counters are per process. */
+
+#include <string.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include "../sdr.h"
+#include "../fifo.h"
+#include "../sdr_net.h"
+#include "../sdr_iqfile.h"
+#include "test.h"
+
+#define BLOCKS 20 // FIFO blocks of 0.1s sent
+#define BLOCK_BYTES (IQ_BUFFER_SIZE) // cs8
+#define STREAM_BYTES ((uint64_t) BLOCKS * BLOCK_BYTES)
+#define UDP_DATAGRAMS ((STREAM_BYTES + NET_UDP_PAYLOAD - 1) / NET_UDP_PAYLOAD)
+#define RECEIVE_TIMEOUT 10.0
+
+static simulator_t sim;
+static char url[64];
+
+static unsigned char pattern(uint64_t offset) {
+    return (unsigned char) ((offset / 2) % 251);
+}
+
+static void setup(void) {
+    memset(&sim, 0, sizeof (sim));
+    sim.iq_format = IQ_FORMAT_CS8;
+    sim.sample_size = SC08;
+    sim.iq_archive_level = -1;
+    sim.start_gps.week = -1;
+    pthread_mutex_init(&sim.gps_lock, NULL);
+    pthread_cond_init(&sim.gps_init_done, NULL);
+}
+
+static void *producer_thread_ep(void *arg) {
+    NOTUSED(arg);
+    for (unsigned b = 0; b < BLOCKS; b++) {
+        struct iq_buf *iq = fifo_acquire();
+        if (iq == NULL) {
+            break;
+        }
+        for (unsigned i = 0; i < BLOCK_BYTES; i++) {
+            iq->data8[i] = (signed char) pattern((uint64_t) b * BLOCK_BYTES + i);
+        }
+        iq->validLength = BLOCK_BYTES;
+        fifo_enqueue(iq);
+    }
+    return NULL;
+}
+
+// Child process, streams the pattern with the network sink once go is readable
+static void sender(int go, uint64_t packets) {
+    pthread_t producer;
+    struct fifo_stats fs;
+    net_stats_t ns;
+    char c;
+
+    CHECK(read(go, &c, 1) == 1);
+    setup();
+    sim.sdr_type = SDR_NET;
+    sim.net_url = url;
+    if (sdr_net_init(&sim) != 0) {
+        _exit(EXIT_FAILURE);
+    }
+    pthread_create(&producer, NULL, producer_thread_ep, NULL);
+    sdr_net_run();
+    pthread_join(producer, NULL);
+    do {
+        usleep(10000);
+        fifo_get_stats(&fs);
+    } while (fs.occupancy > 0);
+    sdr_net_close();
+
+    net_get_stats(&ns);
+    CHECK(ns.packets == packets);
+    CHECK(ns.bytes == STREAM_BYTES);
+    CHECK(ns.lost == 0);
+    _exit(TEST_RESULT());
+}
+
+static bool wait_bytes(uint64_t bytes, net_stats_t *ns) {
+    double deadline = test_now() + RECEIVE_TIMEOUT;
+    do {
+        usleep(10000);
+        net_get_stats(ns);
+    } while (ns->bytes < bytes && test_now() < deadline);
+    return ns->bytes >= bytes;
+}
+
+static bool received_pattern(const char *name) {
+    FILE *fp = fopen(name, "rb");
+    uint64_t offset = 0;
+    int c;
+
+    if (fp == NULL) {
+        return false;
+    }
+    while ((c = fgetc(fp)) != EOF && c == pattern(offset)) {
+        offset++;
+    }
+    fclose(fp);
+    return offset == STREAM_BYTES;
+}
+
+// Sink in a child process to the source in this one, forwarded to a file
+static void stream(const char *scheme, uint64_t packets) {
+    pthread_t source;
+    struct fifo_stats fs;
+    net_stats_t ns;
+    int go[2];
+    int status;
+
+    snprintf(url, sizeof (url), "%s://127.0.0.1:%d", scheme, 20000 + getpid() % 20000);
+    CHECK(pipe(go) == 0);
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(go[1]);
+        sender(go[0], packets);
+    }
+    close(go[0]);
+
+    setup();
+    sim.sdr_type = SDR_IQFILE;
+    sim.net_listen_url = url;
+    sim.iq_file_name = "received.iq";
+    sim.duration = BLOCKS / 10;
+    CHECK(sdr_iqfile_init(&sim) == 0);
+    pthread_create(&source, NULL, net_source_thread_ep, &sim);
+    while (!sim.gps_thread_running && !sim.gps_thread_exit) {
+        usleep(1000);
+    }
+    CHECK(write(go[1], "g", 1) == 1);
+    close(go[1]);
+    sdr_iqfile_run();
+
+    CHECK(wait_bytes(STREAM_BYTES, &ns));
+    sim.gps_thread_exit = true;
+    pthread_join(source, NULL);
+    do {
+        usleep(10000);
+        fifo_get_stats(&fs);
+    } while (fs.occupancy > 0);
+    sdr_iqfile_close();
+    CHECK(waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+    CHECK(ns.packets == packets);
+    CHECK(ns.bytes == STREAM_BYTES);
+    CHECK(ns.lost == 0);
+    CHECK(ns.late == 0);
+    CHECK(received_pattern("received.iq"));
+    pthread_cond_destroy(&sim.gps_init_done);
+    pthread_mutex_destroy(&sim.gps_lock);
+}
+
+// sendmmsg batches in fixed size datagrams, paced to real time
+static void test_udp(void) {
+    stream("udp", UDP_DATAGRAMS);
+}
+
+// One record per FIFO block
+static void test_tcp(void) {
+    stream("tcp", BLOCKS);
+}
+
+static int udp_fd = -1;
+static pthread_t udp_source;
+
+// Source thread listening on a fresh port and a socket sending to it
+static void udp_open(int port) {
+    bool tcp;
+
+    snprintf(url, sizeof (url), "udp://127.0.0.1:%d", port);
+    setup();
+    sim.net_listen_url = url;
+    CHECK(fifo_create(NUM_FIFO_BUFFERS, BLOCK_BYTES, SC08));
+    pthread_create(&udp_source, NULL, net_source_thread_ep, &sim);
+    while (!sim.gps_thread_running && !sim.gps_thread_exit) {
+        usleep(1000);
+    }
+
+    struct addrinfo *res = net_resolve(url, NET_DEFAULT_PORT, &tcp, false);
+    CHECK(res != NULL);
+    udp_fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    CHECK(connect(udp_fd, res->ai_addr, res->ai_addrlen) == 0);
+    freeaddrinfo(res);
+}
+
+// Send datagrams with the given sequence numbers in one batch
+static void udp_send(const uint32_t *seqs, int count, uint32_t format) {
+    static unsigned char dgram[NET_BATCH][sizeof (net_header_t) + NET_UDP_PAYLOAD];
+    struct mmsghdr msg[NET_BATCH];
+    struct iovec iov[NET_BATCH];
+
+    CHECK(count <= NET_BATCH);
+    memset(msg, 0, sizeof (msg));
+    for (int i = 0; i < count; i++) {
+        net_header_t *h = (net_header_t *) dgram[i];
+        memset(dgram[i], 0x11, sizeof (dgram[i]));
+        memset(h, 0, sizeof (*h));
+        h->magic = NET_MAGIC;
+        h->seq = seqs[i];
+        h->gps_week = -1;
+        h->format = format;
+        h->len = NET_UDP_PAYLOAD;
+        iov[i].iov_base = dgram[i];
+        iov[i].iov_len = sizeof (dgram[i]);
+        msg[i].msg_hdr.msg_iov = &iov[i];
+        msg[i].msg_hdr.msg_iovlen = 1;
+    }
+    CHECK(sendmmsg(udp_fd, msg, (unsigned) count, 0) == count);
+}
+
+// Wait for the accepted datagrams to arrive and stop the source
+static void udp_close(uint64_t packets, net_stats_t *ns) {
+    close(udp_fd);
+    udp_fd = -1;
+    wait_bytes(packets * NET_UDP_PAYLOAD, ns);
+    usleep(100000); // Nothing more must arrive
+    net_get_stats(ns);
+    sim.gps_thread_exit = true;
+    fifo_halt();
+    pthread_join(udp_source, NULL);
+    fifo_destroy();
+    pthread_cond_destroy(&sim.gps_init_done);
+    pthread_mutex_destroy(&sim.gps_lock);
+}
+
+// Datagrams with a gap and one arriving after its successors
+static void test_udp_counters(void) {
+    static const uint32_t seqs[] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 12, 13, 11, 14};
+    const int count = sizeof (seqs) / sizeof (seqs[0]);
+    static const uint32_t foreign[] = {15};
+    net_stats_t ns;
+
+    udp_open(20001 + getpid() % 20000);
+    udp_send(seqs, count, IQ_FORMAT_CS8);
+    // Unknown format is dropped, not taken for a format mismatch
+    udp_send(foreign, 1, 0x7fffffff);
+    usleep(100000);
+    CHECK(!sim.gps_thread_exit);
+    udp_close((uint64_t) count - 1, &ns);
+
+    CHECK(ns.packets == (uint64_t) count - 1);
+    CHECK(ns.bytes == (uint64_t) (count - 1) * NET_UDP_PAYLOAD);
+    CHECK(ns.lost == 2);
+    CHECK(ns.late == 1);
+}
+
+// Sender restarts, the sequence starts over far behind, or a little
+// behind after a silence
+static void test_udp_restart(void) {
+    uint32_t seqs[10];
+    net_stats_t ns;
+
+    udp_open(20002 + getpid() % 20000);
+    for (int i = 0; i < 10; i++) {
+        seqs[i] = 5000 + (uint32_t) i;
+    }
+    udp_send(seqs, 10, IQ_FORMAT_CS8);
+    for (int i = 0; i < 10; i++) {
+        seqs[i] = (uint32_t) i;
+    }
+    udp_send(seqs, 10, IQ_FORMAT_CS8);
+    usleep((useconds_t) ((NET_RESYNC_GAP + 0.2) * 1e6));
+    udp_send(seqs + 5, 5, IQ_FORMAT_CS8);
+    udp_close(25, &ns);
+
+    CHECK(ns.packets == 25);
+    CHECK(ns.restarts == 2);
+    CHECK(ns.lost == 0);
+    CHECK(ns.late == 0);
+}
+
+int main(void) {
+    test_chdir_tmp();
+    test_udp_counters();
+    test_udp_restart();
+    test_udp();
+    test_tcp();
+    test_cleanup_tmp();
+    return TEST_RESULT();
+}
@@ -0,0 +1,77 @@
+/**
+ * multi-sdr-gps-sim generates a IQ data stream on-the-fly to simulate a
+ * GPS L1 baseband signal using a SDR platform like HackRF or ADLAM-Pluto.
+ *
+ * This file is part of the Github project at
+ * https://github.com/mictronics/multi-sdr-gps-sim.git
+ *
+ * Copyright © 2021 Mictronics
+ * Distributed under the MIT License.
+ *
+ */
+
+/* Epoch queue between observation and synthesis stage, closed while the
+ * synthesis stage holds an epoch as on shutdown. */
+
+#include "../pipeline.h"
+#include "test.h"
+
+static void fill(int epochs) {
+    for (int k = 0; k < epochs; k++) {
+        epoch_t *ep = epochq_write_acquire();
+        CHECK(ep != NULL);
+        if (ep != NULL) {
+            ep->grx.sec = k;
+            epochq_write_commit();
+        }
+    }
+}
+
+// Dropping keeps the epoch being read, nothing is returned after its release
+static void test_drop_while_reading(void) {
+    pipeline_stats_t ps;
+
+    epochq_init();
+    fill(3);
+    epoch_t *ep = epochq_read_acquire();
+    CHECK(ep != NULL && ep->grx.sec == 0);
+    epochq_close(true);
+    epochq_read_release();
+    CHECK(epochq_read_acquire() == NULL);
+    CHECK(epochq_write_acquire() == NULL);
+    pipeline_get_stats(&ps);
+    CHECK(ps.queued == 0);
+}
+
+// Dropping between epochs discards all of them
+static void test_drop_idle(void) {
+    epochq_init();
+    fill(3);
+    epoch_t *ep = epochq_read_acquire();
+    CHECK(ep != NULL);
+    epochq_read_release();
+    epochq_close(true);
+    CHECK(epochq_read_acquire() == NULL);
+}
+
+// Closing without drop hands out the rest in order
+static void test_drain(void) {
+    epochq_init();
+    fill(3);
+    epochq_close(false);
+    for (int k = 0; k < 3; k++) {
+        epoch_t *ep = epochq_read_acquire();
+        CHECK(ep != NULL && ep->grx.sec == k);
+        if (ep != NULL) {
+            epochq_read_release();
+        }
+    }
+    CHECK(epochq_read_acquire() == NULL);
+}
+
+int main(void) {
+    test_drop_while_reading();
+    test_drop_idle();
+    test_drain();
+    return TEST_RESULT();
+}
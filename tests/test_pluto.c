@@ -0,0 +1,148 @@
+/**
+ * multi-sdr-gps-sim generates a IQ data stream on-the-fly to simulate a
+ * GPS L1 baseband signal using a SDR platform like HackRF or ADLAM-Pluto.
+ *
+ * This file is part of the Github project at
+ * https://github.com/mictronics/multi-sdr-gps-sim.git
+ *
+ * Copyright © 2021 Mictronics
+ * Distributed under the MIT License.
+ *
+ */
+
+/* ADLAM-Pluto backend against the libiio shim in tests/stub. Each sample
+ * carries its block number and index, the shim hands every pushed block
+ * back with I and Q taken out of the buffer layout under test. */
+
+#include <string.h>
+#include <unistd.h>
+#include <iio.h>
+#include "../sdr.h"
+#include "../fifo.h"
+#include "../sdr_pluto.h"
+#include "test.h"
+
+#define BLOCKS 32 // Blocks produced
+#define SAMPLES 4096 // IQ samples per libiio buffer
+#define KERNEL_BUFFERS 4
+#define SLACK_MS 50
+#define MIXED (-1) // Pushed block not from one produced block
+
+static simulator_t sim;
+static int pushed[BLOCKS + 1];
+static atomic_int push_count;
+static atomic_int in_place; // Producer got the libiio block as FIFO buffer
+
+static int16_t sample_i(int block, unsigned n) {
+    return (int16_t) ((block << 8) | (n & 0xff));
+}
+
+static int16_t sample_q(int block, unsigned n) {
+    return (int16_t) ~sample_i(block, n);
+}
+
+static void observe(const int16_t *i, const int16_t *q, size_t samples) {
+    int block = (uint16_t) i[0] >> 8;
+    for (size_t n = 0; n < samples; n++) {
+        if (i[n] != sample_i(block, n) || q[n] != sample_q(block, n)) {
+            block = MIXED;
+            break;
+        }
+    }
+    int k = atomic_load(&push_count);
+    if (k <= BLOCKS) {
+        pushed[k] = block;
+        atomic_store(&push_count, k + 1);
+    }
+}
+
+static void *producer_thread_ep(void *arg) {
+    NOTUSED(arg);
+    for (int b = 1; b <= BLOCKS; b++) {
+        struct iq_buf *iq = fifo_acquire();
+        if (iq == NULL) {
+            break;
+        }
+        if (fifo_buffer_data(iq) == iio_shim_block()) {
+            atomic_fetch_add(&in_place, 1);
+        }
+        for (unsigned n = 0; n < SAMPLES; n++) {
+            iq->data16[2 * n] = sample_i(b, n);
+            iq->data16[2 * n + 1] = sample_q(b, n);
+        }
+        iq->validLength = SAMPLES * 2;
+        fifo_enqueue(iq);
+    }
+    return NULL;
+}
+
+static void stream(ptrdiff_t step, ptrdiff_t q_offset, bool zero_copy) {
+    pthread_t producer;
+    struct fifo_stats fs;
+
+    memset(&sim, 0, sizeof (sim));
+    sim.tx_gain = -10;
+    sim.fifo_slack_ms = SLACK_MS;
+    sim.pluto_kernel_buffers = KERNEL_BUFFERS;
+    sim.pluto_buffer_size = SAMPLES;
+    fifo_set_target_slack(sim.fifo_slack_ms);
+    atomic_store(&push_count, 0);
+    atomic_store(&in_place, 0);
+    iio_shim_set_layout(step, q_offset);
+    iio_shim_set_observer(observe);
+
+    CHECK(sdr_pluto_init(&sim) == 0);
+    CHECK(sim.sample_size == SC16);
+    CHECK(iio_shim_kernel_buffers() == KERNEL_BUFFERS);
+    CHECK(fifo_block_align() == SAMPLES * 2);
+    // Zero-copy leaves queueing to the kernel buffers
+    CHECK(fifo_get_depth() == (zero_copy ? 1 : NUM_FIFO_BUFFERS));
+    pthread_create(&producer, NULL, producer_thread_ep, NULL);
+    CHECK(sdr_pluto_run() == 0);
+    pthread_join(producer, NULL);
+    do {
+        usleep(10000);
+        fifo_get_stats(&fs);
+    } while (fs.occupancy > 0);
+    // Last block is pushed before its FIFO buffer is released
+    while (iio_shim_pushed() < BLOCKS && atomic_load(&push_count) <= BLOCKS) {
+        usleep(1000);
+    }
+    // All kernel buffers are filled, each holds one block to go out
+    CHECK(sdr_pluto_delay_ms() == (unsigned) (KERNEL_BUFFERS * SAMPLES * 1000.0 / TX_SAMPLERATE));
+    // Adaptive depth was switched off, not grown towards the slack
+    if (zero_copy) {
+        CHECK(fifo_get_depth() == 1);
+    }
+    sdr_pluto_close();
+    CHECK(!iio_shim_buffer_alive());
+
+    // Every block pushed once, in order and complete
+    int n = atomic_load(&push_count);
+    CHECK(n == BLOCKS);
+    for (int k = 0; k < n && k < BLOCKS; k++) {
+        CHECK(pushed[k] == k + 1);
+    }
+    // Rendered in the libiio buffer, or copied into it
+    CHECK(atomic_load(&in_place) == (zero_copy ? BLOCKS : 0));
+
+    iio_shim_set_observer(NULL);
+    fifo_set_target_slack(0);
+}
+
+// I and Q apart in wider samples, scattered by copy_to_buffer()
+static void test_scatter(void) {
+    stream(4 * sizeof (int16_t), 2 * sizeof (int16_t), false);
+}
+
+// Interleaved 16 bit I/Q as on the device, rendered in place
+static void test_zero_copy(void) {
+    stream(2 * sizeof (int16_t), sizeof (int16_t), true);
+}
+
+int main(void) {
+    test_scatter();
+    test_zero_copy();
+    test_scatter();
+    return TEST_RESULT();
+}
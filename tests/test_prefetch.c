@@ -0,0 +1,216 @@
+/**
+ * multi-sdr-gps-sim generates a IQ data stream on-the-fly to simulate a
+ * GPS L1 baseband signal using a SDR platform like HackRF or ADLAM-Pluto.
+ *
+ * This file is part of the Github project at
+ * https://github.com/mictronics/multi-sdr-gps-sim.git
+ *
+ * Copyright © 2021 Mictronics
+ * Distributed under the MIT License.
+ *
+ */
+
+/* Offline --mirror file:// fetch of ephemeris and almanac. The mirror is
+ * built from tests/data in a temporary directory, the RINEX file at the
+ * dated path of the previous hour like on the IGS server. */
+
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "../prefetch.h"
+#include "test.h"
+
+#define STATION "abmf"
+#define FIXTURE_EPH 62 // Records in brdc0010.22n
+#define OPEN_TIMEOUT 5.0
+
+static simulator_t sim;
+static char mirror[PATH_MAX];
+static char rinex_path[PATH_MAX + NAME_MAX]; // Below mirror
+static char almanac_path[PATH_MAX + NAME_MAX];
+
+static void setup(const char *mirror_url) {
+    memset(&sim, 0, sizeof (sim));
+    sim.use_ftp = true;
+    sim.almanac_enable = true;
+    sim.station_id = STATION;
+    sim.mirror_url = (char *) mirror_url;
+    sim.start.y = 2022;
+    sim.start.m = 1;
+    sim.start.d = 1;
+}
+
+// Lay out the mirror like the online sources, see download_rinex()
+static void make_mirror(void) {
+    char dir[PATH_MAX + 32];
+    char path[NAME_MAX];
+
+    // Don't cross the hour the download path is taken from
+    time_t t = time(NULL);
+    if (t % 3600 > 3595) {
+        sleep(6);
+        t = time(NULL);
+    }
+    struct tm *tm = gmtime(&t);
+    tm->tm_hour -= 1;
+    if (tm->tm_hour < 0) {
+        tm->tm_hour = 23;
+    }
+    snprintf(path, sizeof (path), RINEX_FTP_FILE, RINEX2_SUBFOLDER,
+            tm->tm_yday + 1, tm->tm_hour, STATION, tm->tm_yday + 1, 'a' + tm->tm_hour, tm->tm_year - 100);
+
+    snprintf(mirror, sizeof (mirror), "%s/mirror", getcwd(dir, sizeof (dir)));
+    snprintf(dir, sizeof (dir), "%s/%s", mirror, RINEX2_SUBFOLDER);
+    mkdir(mirror, 0755);
+    mkdir(dir, 0755);
+    snprintf(dir, sizeof (dir), "%s/%s/%03i", mirror, RINEX2_SUBFOLDER, tm->tm_yday + 1);
+    mkdir(dir, 0755);
+    snprintf(dir, sizeof (dir), "%s/%s/%03i/%02i", mirror, RINEX2_SUBFOLDER, tm->tm_yday + 1, tm->tm_hour);
+    CHECK(mkdir(dir, 0755) == 0);
+    snprintf(rinex_path, sizeof (rinex_path), "%s/%s", mirror, path);
+    snprintf(almanac_path, sizeof (almanac_path), "%s/%s", mirror, ALMANAC_SEM_FILE);
+}
+
+// Writer end of a named pipe, only opens while a reader has it open
+static int open_writer(const char *path, double deadline) {
+    int fd;
+    while ((fd = open(path, O_WRONLY | O_NONBLOCK)) < 0 && errno == ENXIO && test_now() < deadline) {
+        usleep(1000);
+    }
+    return fd;
+}
+
+static bool feed(int fd, const char *fixture) {
+    char buf[4096];
+    ssize_t n;
+    bool ok = true;
+    FILE *fp = fopen(fixture, "rb");
+
+    if (fp == NULL) {
+        return false;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+    while (ok && (n = (ssize_t) fread(buf, 1, sizeof (buf), fp)) > 0) {
+        ok = (write(fd, buf, (size_t) n) == n);
+    }
+    fclose(fp);
+    close(fd);
+    return ok;
+}
+
+// Serve both files from pipes. Each writer only opens while the download
+// waits for the file, both at a time if they run in parallel.
+static void *server_thread_ep(void *arg) {
+    bool *parallel = (bool *) arg;
+    double deadline = test_now() + OPEN_TIMEOUT;
+    int eph_fd = open_writer(rinex_path, deadline);
+    int alm_fd = open_writer(almanac_path, deadline);
+
+    *parallel = (eph_fd >= 0 && alm_fd >= 0);
+    // Almanac first, the opposite order of a sequential fetch. A file not
+    // fetched yet is served as regular file so the test does not hang.
+    if (alm_fd >= 0) {
+        CHECK(feed(alm_fd, TEST_DATA "/mirror/" ALMANAC_SEM_FILE));
+    } else {
+        unlink(almanac_path);
+        test_copy_file(TEST_DATA "/mirror/" ALMANAC_SEM_FILE, almanac_path);
+    }
+    if (eph_fd >= 0) {
+        CHECK(feed(eph_fd, TEST_DATA "/brdc0010.22n"));
+    } else {
+        unlink(rinex_path);
+        test_copy_file(TEST_DATA "/brdc0010.22n", rinex_path);
+    }
+    return NULL;
+}
+
+static void test_concurrent_fetch(void) {
+    char url[PATH_MAX + 8];
+    pthread_t server;
+    bool parallel = false;
+    prefetch_t pf;
+
+    make_mirror();
+    CHECK(mkfifo(rinex_path, 0644) == 0);
+    CHECK(mkfifo(almanac_path, 0644) == 0);
+    snprintf(url, sizeof (url), "file://%s", mirror);
+    setup(url);
+
+    pthread_create(&server, NULL, server_thread_ep, &parallel);
+    prefetch_start(&sim);
+    prefetch_join(&sim, &pf);
+    pthread_join(server, NULL);
+    CHECK(parallel);
+    CHECK(pf.eph_code == CURLE_OK);
+    CHECK(pf.neph == FIXTURE_EPH);
+    gpstime_t toe = {2190, 518400.0};
+    CHECK(ephstore_find_toe(&pf.store, 1, toe) != NULL);
+    CHECK(pf.ionoutc.vflg);
+    CHECK(pf.alm_code == CURLE_OK);
+    CHECK(pf.alm->valid && pf.alm->sv[30].valid && !pf.alm->sv[31].valid);
+    ephstore_free(&pf.store);
+    prefetch_close();
+
+    unlink(rinex_path);
+    unlink(almanac_path);
+}
+
+// Plain files in the committed mirror fixture
+static void test_fixture_mirror(void) {
+    prefetch_t pf;
+
+    setup("file://" TEST_DATA "/mirror/");
+    prefetch_join(&sim, &pf);
+    CHECK(pf.alm_code == CURLE_OK);
+    CHECK(pf.alm->valid);
+    CHECK(pf.alm->sv[0].toa.week == 2190 && pf.alm->sv[0].toa.sec == 518400.0);
+    ephstore_free(&pf.store);
+    prefetch_close();
+}
+
+// Nothing to download and no earlier download to fall back to
+static void test_missing_mirror(void) {
+    prefetch_t pf;
+
+    unlink(RINEX2_FILE_NAME);
+    unlink("almanac.sem");
+    setup("file:///nonexistent/gps-sim-mirror");
+    double t0 = test_now();
+    prefetch_join(&sim, &pf);
+    CHECK(test_now() - t0 < OPEN_TIMEOUT);
+    CHECK(pf.eph_code != CURLE_OK);
+    CHECK(pf.neph == 0);
+    CHECK(pf.alm_code != CURLE_OK);
+    CHECK(!pf.alm->valid);
+    ephstore_free(&pf.store);
+    prefetch_close();
+}
+
+// Mirror gone, the files of the last download are used instead
+static void test_fallback(void) {
+    prefetch_t pf;
+
+    CHECK(test_copy_file(TEST_DATA "/brdc0010.22n", RINEX2_FILE_NAME));
+    CHECK(test_copy_file(TEST_DATA "/mirror/" ALMANAC_SEM_FILE, "almanac.sem"));
+    setup("file:///nonexistent/gps-sim-mirror");
+    prefetch_join(&sim, &pf);
+    CHECK(pf.eph_code != CURLE_OK);
+    CHECK(pf.neph == FIXTURE_EPH);
+    CHECK(pf.alm_code == CURLE_OK);
+    CHECK(pf.alm->valid);
+    ephstore_free(&pf.store);
+    prefetch_close();
+}
+
+int main(void) {
+    test_chdir_tmp();
+    test_concurrent_fetch();
+    test_fixture_mirror();
+    test_missing_mirror();
+    test_fallback();
+    test_cleanup_tmp();
+    return TEST_RESULT();
+}
@@ -0,0 +1,140 @@
+/**
+ * multi-sdr-gps-sim generates a IQ data stream on-the-fly to simulate a
+ * GPS L1 baseband signal using a SDR platform like HackRF or ADLAM-Pluto.
+ *
+ * This file is part of the Github project at
+ * https://github.com/mictronics/multi-sdr-gps-sim.git
+ *
+ * Copyright © 2021 Mictronics
+ * Distributed under the MIT License.
+ *
+ */
+
+/* Real-time replay into the IQ file sink. The file sink takes data as fast
+ * as it comes, so the achieved rate is the pacing of the replay thread. */
+
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "../sdr.h"
+#include "../fifo.h"
+#include "../replay.h"
+#include "../sdr_iqfile.h"
+#include "test.h"
+
+#define REPLAY_SECONDS 2
+#define REPLAY_BYTES (REPLAY_SECONDS * TX_SAMPLERATE * 2) // cs8
+#define RATE_TOLERANCE 0.02
+
+static simulator_t sim;
+
+static bool write_input(const char *name) {
+    FILE *fp = fopen(name, "wb");
+    if (fp == NULL) {
+        return false;
+    }
+    // Sample values follow the byte offset, shows lost or reordered blocks
+    for (unsigned i = 0; i < REPLAY_BYTES; i++) {
+        fputc((int) ((i / 2) % 251), fp);
+    }
+    return fclose(fp) == 0;
+}
+
+static bool same_content(const char *a, const char *b) {
+    FILE *fa = fopen(a, "rb");
+    FILE *fb = fopen(b, "rb");
+    bool same = (fa != NULL && fb != NULL);
+    int ca, cb;
+
+    while (same) {
+        ca = fgetc(fa);
+        cb = fgetc(fb);
+        same = (ca == cb);
+        if (ca == EOF) {
+            break;
+        }
+    }
+    if (fa != NULL) {
+        fclose(fa);
+    }
+    if (fb != NULL) {
+        fclose(fb);
+    }
+    return same;
+}
+
+// Replay input.iq into output.iq, the sink starts sink_delay seconds after
+// the FIFO filled up.
+static void replay(double sink_delay, replay_stats_t *stats) {
+    pthread_t source;
+
+    memset(&sim, 0, sizeof (sim));
+    sim.sdr_type = SDR_IQFILE;
+    sim.iq_format = IQ_FORMAT_CS8;
+    sim.sample_size = SC08;
+    sim.iq_archive_level = -1;
+    sim.duration = REPLAY_SECONDS;
+    sim.replay_file_name = "input.iq";
+    sim.iq_file_name = "output.iq";
+    sim.start_gps.week = -1;
+    pthread_mutex_init(&sim.gps_lock, NULL);
+    pthread_cond_init(&sim.gps_init_done, NULL);
+    unlink(sim.iq_file_name);
+
+    CHECK(sdr_iqfile_init(&sim) == 0);
+    pthread_create(&source, NULL, replay_thread_ep, &sim);
+    while (!sim.gps_thread_running && !sim.gps_thread_exit) {
+        usleep(1000);
+    }
+    CHECK(sim.gps_thread_running);
+    fifo_wait_full();
+    usleep((useconds_t) (sink_delay * 1e6));
+    CHECK(sdr_iqfile_run() == 0);
+
+    pthread_join(source, NULL);
+    struct fifo_stats fs;
+    do {
+        usleep(10000);
+        fifo_get_stats(&fs);
+    } while (fs.occupancy > 0);
+    sdr_iqfile_close();
+    replay_get_stats(stats);
+    pthread_cond_destroy(&sim.gps_init_done);
+    pthread_mutex_destroy(&sim.gps_lock);
+}
+
+// Paced to real time, no block late
+static void test_rate(void) {
+    replay_stats_t st;
+    struct stat out;
+
+    replay(0.0, &st);
+    CHECK(st.played > REPLAY_SECONDS - 0.001 && st.played < REPLAY_SECONDS + 0.001);
+    CHECK(st.elapsed > 0.0);
+    CHECK(st.played / st.elapsed > 1.0 - RATE_TOLERANCE);
+    CHECK(st.played / st.elapsed < 1.0 + RATE_TOLERANCE);
+    CHECK(st.late == 0);
+    CHECK(st.loops == 0);
+    CHECK(stat("output.iq", &out) == 0 && out.st_size == REPLAY_BYTES);
+    CHECK(same_content("input.iq", "output.iq"));
+}
+
+// A stalled sink blocks the replay on a full FIFO, it catches up afterwards
+static void test_late(void) {
+    replay_stats_t st;
+
+    replay(0.5, &st);
+    CHECK(st.late > 0);
+    CHECK(st.played / st.elapsed > 1.0 - RATE_TOLERANCE);
+    CHECK(st.played / st.elapsed < 1.0 + RATE_TOLERANCE);
+    CHECK(same_content("input.iq", "output.iq"));
+}
+
+int main(void) {
+    test_chdir_tmp();
+    CHECK(write_input("input.iq"));
+    test_rate();
+    test_late();
+    test_cleanup_tmp();
+    return TEST_RESULT();
+}
@@ -0,0 +1,32 @@
+/**
+ * multi-sdr-gps-sim generates a IQ data stream on-the-fly to simulate a
+ * GPS L1 baseband signal using a SDR platform like HackRF or ADLAM-Pluto.
+ *
+ * This file is part of the Github project at
+ * https://github.com/mictronics/multi-sdr-gps-sim.git
+ *
+ * Copyright © 2021 Mictronics
+ * Distributed under the MIT License.
+ *
+ */
+
+#ifndef TIMEUTIL_H
+#define TIMEUTIL_H
+
+#include <time.h>
+
+/* Sleep until sec seconds after t0, both on CLOCK_MONOTONIC. Used to pace
+ * sources and senders to real time. */
+static inline void sleep_until(const struct timespec *t0, double sec) {
+    struct timespec deadline;
+
+    deadline.tv_sec = t0->tv_sec + (time_t) sec;
+    deadline.tv_nsec = t0->tv_nsec + (long) ((sec - (double) (time_t) sec) * 1e9);
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL);
+}
+
+#endif /* TIMEUTIL_H */